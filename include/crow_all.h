@@ -7255,6 +7255,10 @@ namespace crow
         bool skip_body = false;            ///< Whether this is a response to a HEAD request.
         bool manual_length_header = false; ///< Whether Crow should automatically add a "Content-Length" header.
 
+        /// Streaming patch, see crow_streaming.h: produces the body in parts once the handler has ended the response.
+        /// Fills its argument with the next part and returns true, or returns false once the body is complete.
+        std::function<bool(std::string&)> body_source;
+
         /// Set the value of an existing header in the response.
         void set_header(std::string key, std::string value)
         {
@@ -7377,6 +7381,7 @@ namespace crow
             code = r.code;
             headers = std::move(r.headers);
             completed_ = r.completed_;
+            body_source = std::move(r.body_source); // Streaming patch, see crow_streaming.h.
             file_info = std::move(r.file_info);
             return *this;
         }
@@ -7393,6 +7398,7 @@ namespace crow
             code = 200;
             headers.clear();
             completed_ = false;
+            body_source = nullptr; // Streaming patch, see crow_streaming.h.
             file_info = static_file_info{};
         }
 
@@ -8997,12 +9003,20 @@ namespace crow
 #ifdef CROW_ENABLE_DEBUG
     static std::atomic<int> connectionCount;
 #endif
+} // namespace crow
+
+#include "crow_streaming.h" // Streaming patch.
+#include "crow_peer.h"      // Peer probe patch.
 
+namespace crow
+{
     /// An HTTP connection.
     template<typename Adaptor, typename Handler, typename... Middlewares>
-    class Connection: public std::enable_shared_from_this<Connection<Adaptor, Handler, Middlewares...>>
+    class Connection: public std::enable_shared_from_this<Connection<Adaptor, Handler, Middlewares...>>,
+                      public streaming::body_writer<Connection<Adaptor, Handler, Middlewares...>> // Streaming patch.
     {
         friend struct crow::response;
+        friend class streaming::body_writer<Connection>; // Streaming patch.
 
     public:
         Connection(
@@ -9131,7 +9145,7 @@ namespace crow
                 res.complete_request_handler_ = nullptr;
                 auto self = this->shared_from_this();
                 res.is_alive_helper_ = [self]() -> bool {
-                    return self->adaptor_.is_open();
+                    return self->adaptor_.is_open() && peer::connected(self->adaptor_.raw_socket()); // Peer probe patch, see crow_peer.h.
                 };
 
                 ctx_ = detail::context<Middlewares...>();
@@ -9181,6 +9195,11 @@ namespace crow
                   decltype(ctx_),
                   decltype(*middlewares_)>({}, *middlewares_, ctx_, req_, res);
             }
+
+            if (this->start_body_stream()) // Streaming patch.
+            {
+                return;
+            }
 #ifdef CROW_ENABLE_COMPRESSION
             if (handler_->compression_used())
             {
@@ -9469,7 +9488,7 @@ namespace crow
                       self->parser_.done();
                       // adaptor will close after write
                   }
-                  else if (!self->need_to_call_after_handlers_)
+                  else if (!self->need_to_call_after_handlers_ && !self->is_body_streaming()) // Streaming patch.
                   {
                       self->start_deadline();
                       self->do_read();
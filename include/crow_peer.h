@@ -0,0 +1,35 @@
+#pragma once
+// Client liveness for Crow.
+//
+// A local patch to the vendored crow_all.h, which includes this file just before crow::Connection. Crow's
+// response::is_alive() only turns false once Crow itself has closed the connection, which it can't notice while a
+// handler is running. crow_all.h is patched at the line marked "Peer probe patch", so the response's is_alive helper
+// also asks the socket here. Re-apply it when updating crow_all.h.
+
+#if !defined(_WIN32)
+#include <poll.h>
+#endif
+
+namespace crow
+{
+    namespace peer
+    {
+        /// Whether the client at the other end of a socket is still connected. Checks the socket without reading
+        /// from it, so it is safe to call from another thread while the connection is in use.
+        ///
+        /// Only a hangup or an error counts as gone. Reaching the end of the input does not: a client may half-close
+        /// its side once it has sent the request and still be reading the response.
+        template<typename Socket>
+        bool connected(Socket& socket)
+        {
+#if !defined(_WIN32)
+            pollfd probe{};
+            probe.fd = socket.native_handle();
+            return ::poll(&probe, 1, 0) <= 0 || (probe.revents & (POLLHUP | POLLERR | POLLNVAL)) == 0;
+#else
+            (void)socket;
+            return true;
+#endif
+        }
+    } // namespace peer
+} // namespace crow
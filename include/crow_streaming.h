@@ -0,0 +1,216 @@
+#pragma once
+// Streamed response bodies for Crow.
+//
+// A local patch to the vendored crow_all.h, which includes this file just before crow::Connection. Crow can only send
+// a body once the handler has produced all of it, so crow_all.h is patched at the lines marked "Streaming patch":
+//
+// - crow::response::body_source, cleared and moved along with the rest of the response.
+// - crow::Connection derives from crow::streaming::body_writer and befriends it.
+// - Connection::complete_request() hands the response to start_body_stream() once the after-handle middleware has run.
+// - The read loop in Connection::do_read() waits for a streamed body to finish before reading the next request.
+//
+// Re-apply these when updating crow_all.h. Everything else lives here.
+
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace crow
+{
+    namespace streaming
+    {
+        /// Writes a response body produced by response::body_source.
+        ///
+        /// The status and headers go out first, so headers set by the after-handle middleware are included, followed by
+        /// anything the handler wrote to the body. The source is then called for each part, and each part is written
+        /// asynchronously as one chunk of a `Transfer-Encoding: chunked` body. The source is only called again once its
+        /// previous part has been written, so memory stays at one part, and a slow client holds up neither the io
+        /// thread nor the other connections on it. A part that the socket doesn't take within the server timeout drops
+        /// the client. HTTP/1.0 clients get the parts unframed and the body ends when the connection closes.
+        ///
+        /// If the source throws or a write fails, the connection is closed without the final chunk, so the client sees
+        /// the body as truncated. Otherwise a keep-alive connection goes back to reading its next request.
+        template<typename Connection>
+        class body_writer
+        {
+        protected:
+            /// Start streaming the response's body_source. Returns false if the response has none.
+            bool start_body_stream()
+            {
+                Connection& conn = connection();
+                if (!conn.res.body_source)
+                {
+                    return false;
+                }
+
+                source_ = std::move(conn.res.body_source);
+                conn.res.body_source = nullptr;
+                streaming_ = true;
+                chunked_ = conn.req_.check_version(1, 1);
+
+                conn.res.headers.erase("Content-Length");
+                if (chunked_)
+                {
+                    conn.res.set_header("Transfer-Encoding", "chunked");
+                }
+                else
+                {
+                    conn.close_connection_ = true;
+                    conn.add_keep_alive_ = false;
+                }
+
+                // Keep Crow from adding a Content-Length. The flag survives response::clear(), so put it back.
+                const bool manual_length_header = conn.res.manual_length_header;
+                conn.res.manual_length_header = true;
+                conn.prepare_buffers();
+                conn.res.manual_length_header = manual_length_header;
+                if (!conn.adaptor_.is_open())
+                {
+                    finish(true);
+                    return true;
+                }
+
+                part_.swap(conn.res.body);
+                append_part(conn.buffers_);
+                write(conn.buffers_, false);
+                return true;
+            }
+
+            /// Whether a streamed body is being written.
+            bool is_body_streaming() const noexcept
+            {
+                return streaming_;
+            }
+
+        private:
+            Connection& connection()
+            {
+                return static_cast<Connection&>(*this);
+            }
+
+            /// Add the current part to a write, framed as a chunk if the body is chunked.
+            void append_part(std::vector<asio::const_buffer>& buffers)
+            {
+                // An empty chunk would end the body.
+                if (part_.empty())
+                {
+                    return;
+                }
+
+                if (chunked_)
+                {
+                    const int length = std::snprintf(size_line_, sizeof(size_line_), "%zx\r\n", part_.size());
+                    buffers.emplace_back(size_line_, static_cast<std::size_t>(length));
+                    buffers.emplace_back(part_.data(), part_.size());
+                    buffers.emplace_back(crlf.data(), crlf.size());
+                }
+                else
+                {
+                    buffers.emplace_back(part_.data(), part_.size());
+                }
+            }
+
+            /// Get the next part from the source and write it, or write the final chunk once the source is done.
+            void write_next_part()
+            {
+                bool more = true;
+                part_.clear();
+                try
+                {
+                    // Sources may produce empty parts, such as a batch without rows.
+                    while (more && part_.empty())
+                    {
+                        more = source_(part_);
+                    }
+                }
+                catch (const std::exception& e)
+                {
+                    CROW_LOG_ERROR << "Streamed response failed: " << e.what();
+                    finish(true);
+                    return;
+                }
+
+                static const std::string last_chunk = "0\r\n\r\n";
+                parts_.clear();
+                if (more)
+                {
+                    append_part(parts_);
+                }
+                else if (chunked_)
+                {
+                    parts_.emplace_back(last_chunk.data(), last_chunk.size());
+                }
+                write(parts_, !more);
+            }
+
+            void write(const std::vector<asio::const_buffer>& buffers, bool last)
+            {
+                Connection& conn = connection();
+                auto self = conn.shared_from_this();
+
+                conn.start_deadline();
+                asio::async_write(
+                  conn.adaptor_.socket(), buffers,
+                  [self, this, last](const asio::error_code& ec, std::size_t /*bytes_transferred*/) {
+                      self->cancel_deadline_timer();
+                      if (ec)
+                      {
+                          CROW_LOG_DEBUG << self << " stream write failed: " << ec.message();
+                          finish(true);
+                      }
+                      else if (last)
+                      {
+                          finish(false);
+                      }
+                      else
+                      {
+                          write_next_part();
+                      }
+                  });
+            }
+
+            /// End the stream, closing the connection if it failed, and go back to reading on keep-alive.
+            void finish(bool failed)
+            {
+                Connection& conn = connection();
+
+                // Drop the source first, it may hold resources such as a database connection.
+                streaming_ = false;
+                source_ = nullptr;
+                part_.clear();
+                part_.shrink_to_fit();
+                parts_.clear();
+
+                const bool keep_alive = !failed && !conn.close_connection_ && conn.adaptor_.is_open();
+                if (!keep_alive)
+                {
+                    conn.adaptor_.shutdown_readwrite();
+                    conn.adaptor_.close();
+                    CROW_LOG_DEBUG << &conn << " from write (stream)";
+                }
+
+                conn.res.clear();
+                conn.buffers_.clear();
+                conn.parser_.clear();
+
+                if (conn.need_to_start_read_after_complete_)
+                {
+                    conn.need_to_start_read_after_complete_ = false;
+                    if (keep_alive)
+                    {
+                        conn.start_deadline();
+                        conn.do_read();
+                    }
+                }
+            }
+
+            std::function<bool(std::string&)> source_;
+            std::string part_;
+            std::vector<asio::const_buffer> parts_;
+            char size_line_[20];
+            bool streaming_{};
+            bool chunked_{};
+        };
+    } // namespace streaming
+} // namespace crow
@@ -0,0 +1,94 @@
+#include "adaptive_limiter.hpp"
+#include <algorithm>
+#include <cmath>
+
+#ifndef ADAPTIVE_LIMITER_CPP
+#define ADAPTIVE_LIMITER_CPP
+
+AdaptiveLimiter::AdaptiveLimiter(Options options_)
+    : options(options_),
+      current_limit(options_.initial_limit),
+      estimated_limit(options_.initial_limit),
+      limit_gauge(Metrics::instance().gauge("zcash_api_concurrency_limit", "Requests the adaptive limiter currently admits at once.")),
+      in_flight_gauge(Metrics::instance().gauge("zcash_api_in_flight_requests", "Requests currently admitted by the adaptive limiter.")),
+      baseline_gauge(Metrics::instance().gauge("zcash_api_db_latency_baseline_microseconds", "Long term DB latency baseline used by the adaptive limiter."))
+{
+    limit_gauge.set(options.initial_limit);
+}
+
+bool AdaptiveLimiter::tryAcquire() noexcept
+{
+    uint32_t current = in_flight.load(std::memory_order_relaxed);
+    do
+    {
+        if (current >= current_limit.load(std::memory_order_relaxed))
+        {
+            return false;
+        }
+    } while (!in_flight.compare_exchange_weak(current, current + 1, std::memory_order_relaxed));
+
+    in_flight_gauge.set(current + 1);
+    return true;
+}
+
+void AdaptiveLimiter::release(const std::optional<LimiterSample> &sample)
+{
+    const uint32_t current = in_flight.fetch_sub(1, std::memory_order_relaxed);
+    in_flight_gauge.set(current - 1);
+
+    if (!sample.has_value())
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(window_mutex);
+    window_latency_sum += static_cast<double>(sample->db_latency.count());
+    window_wait_sum += static_cast<double>(sample->pool_wait.count());
+    window_peak_in_flight = std::max(window_peak_in_flight, current);
+
+    if (++window_count >= options.window_samples)
+    {
+        updateLimit();
+    }
+}
+
+void AdaptiveLimiter::updateLimit()
+{
+    const double latency = window_latency_sum / window_count;
+    const double wait = window_wait_sum / window_count;
+    const double limit = estimated_limit;
+
+    // The baseline follows decreases immediately and increases slowly, so a sustained slowdown
+    // keeps shrinking the limit for a while before it is accepted as the new normal.
+    baseline_latency = baseline_latency == 0.0 || latency < baseline_latency
+                           ? latency
+                           : baseline_latency * 0.98 + latency * 0.02;
+
+    double gradient = latency > 0.0 ? std::clamp(options.tolerance * baseline_latency / latency, 0.5, 1.0) : 1.0;
+    if (wait > static_cast<double>(options.pool_wait_threshold.count()))
+    {
+        gradient = std::min(gradient, 0.8);
+    }
+
+    double next = limit * gradient;
+    // Only probe upwards when the window actually used most of the limit.
+    if (gradient >= 1.0 && window_peak_in_flight * 2 >= limit)
+    {
+        next += std::sqrt(limit);
+    }
+
+    estimated_limit = std::clamp(limit * (1.0 - options.smoothing) + next * options.smoothing,
+                                 static_cast<double>(options.min_limit),
+                                 static_cast<double>(options.max_limit));
+
+    current_limit.store(static_cast<uint32_t>(estimated_limit), std::memory_order_relaxed);
+    limit_gauge.set(static_cast<uint32_t>(estimated_limit));
+    baseline_gauge.set(baseline_latency);
+
+    window_count = 0;
+    window_peak_in_flight = 0;
+    window_latency_sum = 0.0;
+    window_wait_sum = 0.0;
+}
+
+#endif // ADAPTIVE_LIMITER_CPP
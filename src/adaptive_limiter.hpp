@@ -0,0 +1,94 @@
+#ifndef ADAPTIVE_LIMITER_HPP
+#define ADAPTIVE_LIMITER_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include "metrics.hpp"
+
+/**
+ * @brief Database timings observed for a single request.
+ */
+struct LimiterSample
+{
+    std::chrono::microseconds db_latency;  ///< Time spent holding pooled connections.
+    std::chrono::microseconds pool_wait;   ///< Time spent waiting for a pooled connection.
+};
+
+/**
+ * @brief Gradient style concurrency limiter.
+ *
+ * Compares the short term average DB latency of each sample window against a long term
+ * baseline. While latency stays near the baseline the limit grows by a queue allowance of
+ * sqrt(limit); as latency or pool wait climbs the limit shrinks proportionally, so a slow
+ * database sheds load instead of building unbounded queues.
+ */
+class AdaptiveLimiter
+{
+public:
+    struct Options
+    {
+        uint32_t initial_limit;
+        uint32_t min_limit;
+        uint32_t max_limit;
+        double tolerance;                               ///< Latency growth over the baseline tolerated before shrinking.
+        std::chrono::microseconds pool_wait_threshold;  ///< Average pool wait treated as saturation.
+        uint32_t window_samples;                        ///< Samples per limit update.
+        double smoothing;                               ///< Weight of each new limit estimate, in (0, 1].
+    };
+
+    /**
+     * @brief Constructor for the AdaptiveLimiter class.
+     * @param options Limiter tuning.
+     */
+    explicit AdaptiveLimiter(Options options);
+
+    /**
+     * @brief Destructor for the AdaptiveLimiter class.
+     */
+    ~AdaptiveLimiter() noexcept = default;
+
+    /**
+     * @brief Try to admit a request under the current limit.
+     * @return True if the request was admitted and must later call release().
+     */
+    bool tryAcquire() noexcept;
+
+    /**
+     * @brief Release an admitted request.
+     * @param sample DB timings of the request, or std::nullopt if it never reached the database.
+     */
+    void release(const std::optional<LimiterSample> &sample);
+
+    /**
+     * @brief Get the current concurrency limit.
+     * @return Number of requests admitted at once.
+     */
+    uint32_t limit() const noexcept { return current_limit.load(std::memory_order_relaxed); }
+
+private:
+    Options options;
+    std::atomic<uint32_t> in_flight{0};
+    std::atomic<uint32_t> current_limit;
+
+    std::mutex window_mutex;
+    uint32_t window_count{0};
+    uint32_t window_peak_in_flight{0};
+    double window_latency_sum{0.0};
+    double window_wait_sum{0.0};
+    double estimated_limit;
+    double baseline_latency{0.0};
+
+    Gauge &limit_gauge;
+    Gauge &in_flight_gauge;
+    Gauge &baseline_gauge;
+
+    /**
+     * @brief Recompute the limit from the completed window. Called with window_mutex held.
+     */
+    void updateLimit();
+};
+
+#endif // ADAPTIVE_LIMITER_HPP
@@ -0,0 +1,81 @@
+#include "admission.hpp"
+
+#ifndef ADMISSION_CPP
+#define ADMISSION_CPP
+
+AdmissionController::Ticket::~Ticket()
+{
+    if (lane == nullptr)
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(lane->mutex);
+        --lane->in_flight;
+    }
+    lane->slot_available.notify_one();
+}
+
+AdmissionController::AdmissionController(RouteBudget defaultBudget, uint32_t maxQueued, std::chrono::seconds retryAfter)
+    : default_budget(defaultBudget), max_queued(maxQueued), retry_after(retryAfter)
+{
+}
+
+void AdmissionController::registerRoute(const std::string &route, RouteBudget budget)
+{
+    std::lock_guard<std::mutex> lock(lanes_mutex);
+    lanes[route] = std::make_unique<Lane>(budget);
+}
+
+std::optional<AdmissionController::Ticket> AdmissionController::admit(const std::string &route)
+{
+    Lane &lane = laneFor(route);
+    std::unique_lock<std::mutex> lock(lane.mutex);
+
+    if (lane.in_flight < lane.budget.max_concurrent)
+    {
+        ++lane.in_flight;
+        return Ticket(&lane);
+    }
+
+    // Fail fast once the queue is full rather than letting waiters pile up behind a saturated route.
+    if (lane.queued >= lane.budget.max_queued)
+    {
+        return std::nullopt;
+    }
+
+    // Each waiter parks a worker thread, so waiters from every lane together must leave some workers free.
+    if (total_queued.fetch_add(1, std::memory_order_relaxed) >= max_queued)
+    {
+        total_queued.fetch_sub(1, std::memory_order_relaxed);
+        return std::nullopt;
+    }
+
+    ++lane.queued;
+    const bool admitted = lane.slot_available.wait_for(lock, lane.budget.queue_timeout, [&lane]
+                                                       { return lane.in_flight < lane.budget.max_concurrent; });
+    --lane.queued;
+    total_queued.fetch_sub(1, std::memory_order_relaxed);
+
+    if (!admitted)
+    {
+        return std::nullopt;
+    }
+
+    ++lane.in_flight;
+    return Ticket(&lane);
+}
+
+AdmissionController::Lane &AdmissionController::laneFor(const std::string &route)
+{
+    std::lock_guard<std::mutex> lock(lanes_mutex);
+    auto &lane = lanes[route];
+    if (!lane)
+    {
+        lane = std::make_unique<Lane>(default_budget);
+    }
+    return *lane;
+}
+
+#endif // ADMISSION_CPP
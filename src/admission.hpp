@@ -0,0 +1,113 @@
+#ifndef ADMISSION_HPP
+#define ADMISSION_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+/**
+ * @brief Concurrency and queueing limits for a single route.
+ */
+struct RouteBudget
+{
+    uint32_t max_concurrent;                  ///< Requests allowed to execute at once.
+    uint32_t max_queued;                      ///< Requests allowed to wait for a slot before new arrivals are shed.
+    std::chrono::milliseconds queue_timeout;  ///< Longest a queued request waits before it is shed.
+};
+
+/**
+ * @brief Per route admission control. Each registered route owns a lane with its own budget,
+ * so heavy bulk routes queue behind each other instead of starving point lookups.
+ *
+ * Queued requests block the worker thread that received them, so the total queued across all lanes
+ * is capped below the number of workers, keeping some free for requests that can run straight away.
+ */
+class AdmissionController
+{
+    struct Lane;
+
+public:
+    /**
+     * @brief RAII handle for an admitted request. Releases the route's slot on destruction.
+     */
+    class Ticket
+    {
+    public:
+        explicit Ticket(Lane *lane) : lane(lane) {}
+        Ticket(Ticket &&other) noexcept : lane(other.lane) { other.lane = nullptr; }
+        Ticket(const Ticket &) = delete;
+        Ticket &operator=(const Ticket &) = delete;
+        Ticket &operator=(Ticket &&) = delete;
+        ~Ticket();
+
+    private:
+        Lane *lane;
+    };
+
+    /**
+     * @brief Constructor for the AdmissionController class.
+     * @param defaultBudget Budget applied to routes that were not registered explicitly.
+     * @param maxQueued Most requests allowed to wait across all lanes, beyond which requests are shed instead of queued.
+     * @param retryAfter Value of the Retry-After header sent with shed requests.
+     */
+    AdmissionController(RouteBudget defaultBudget, uint32_t maxQueued, std::chrono::seconds retryAfter);
+
+    /**
+     * @brief Destructor for the AdmissionController class.
+     */
+    ~AdmissionController() noexcept = default;
+
+    /**
+     * @brief Give a route its own budget. Must be called before requests are served.
+     * @param route Route name.
+     * @param budget Budget for the route.
+     */
+    void registerRoute(const std::string &route, RouteBudget budget);
+
+    /**
+     * @brief Admit a request for a route, waiting in the route's queue if it is at capacity.
+     * @param route Route name.
+     * @return A ticket holding the slot, or std::nullopt if the request should be shed.
+     */
+    std::optional<Ticket> admit(const std::string &route);
+
+    /**
+     * @brief Get the Retry-After delay sent with shed requests.
+     * @return Delay in seconds.
+     */
+    std::chrono::seconds retryAfter() const noexcept { return retry_after; }
+
+private:
+    struct Lane
+    {
+        explicit Lane(RouteBudget budget_) : budget(budget_) {}
+
+        RouteBudget budget;
+        uint32_t in_flight{0};
+        uint32_t queued{0};
+        std::mutex mutex;
+        std::condition_variable slot_available;
+    };
+
+    RouteBudget default_budget;
+    uint32_t max_queued;
+    std::atomic<uint32_t> total_queued{0};                         ///< Requests waiting in any lane.
+    std::chrono::seconds retry_after;
+    std::mutex lanes_mutex;                                        ///< Guards lanes for routes created on first use.
+    std::unordered_map<std::string, std::unique_ptr<Lane>> lanes;
+
+    /**
+     * @brief Find the lane for a route, creating one with the default budget if needed.
+     * @param route Route name.
+     * @return Lane for the route.
+     */
+    Lane &laneFor(const std::string &route);
+};
+
+#endif // ADMISSION_HPP
@@ -0,0 +1,280 @@
+#include "block_header_store.hpp"
+#include "chain_snapshot.hpp"
+#include "db.hpp"
+#include <algorithm>
+
+#ifndef BLOCK_HEADER_STORE_CPP
+#define BLOCK_HEADER_STORE_CPP
+
+BlockHeaderStore::BlockHeaderStore(Database &database, Options options_)
+    : db(database), options(options_),
+      height_gauge(Metrics::instance().gauge("zcash_api_header_store_blocks", "Blocks held by the in-memory header store."))
+{
+}
+
+BlockHeaderStore::~BlockHeaderStore() noexcept
+{
+    stop();
+}
+
+void BlockHeaderStore::attach(const ChainSnapshot &snapshot_)
+{
+    std::unique_lock<std::shared_mutex> lock(store_mutex);
+    snapshot = &snapshot_;
+    base_height = snapshot_.height();
+    covered.store(base_height, std::memory_order_release);
+    height_gauge.set(static_cast<double>(base_height));
+}
+
+void BlockHeaderStore::start()
+{
+    if (loader.joinable())
+    {
+        return;
+    }
+
+    loader = std::thread([this]
+                         {
+        std::unique_lock<std::mutex> lock(signal_mutex);
+        while (true)
+        {
+            signal.wait(lock, [this] { return stopping || wanted_tip.has_value(); });
+            if (stopping)
+            {
+                return;
+            }
+
+            const uint64_t tip = wanted_tip.value();
+            wanted_tip.reset();
+
+            lock.unlock();
+            load(tip);
+            lock.lock();
+        } });
+}
+
+void BlockHeaderStore::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(signal_mutex);
+        stopping = true;
+    }
+    signal.notify_all();
+
+    if (loader.joinable())
+    {
+        loader.join();
+    }
+}
+
+void BlockHeaderStore::extend(uint64_t tipHeight)
+{
+    {
+        std::lock_guard<std::mutex> lock(signal_mutex);
+        wanted_tip = std::max(wanted_tip.value_or(0), tipHeight);
+    }
+    caught_up.store(false, std::memory_order_release);
+    signal.notify_all();
+}
+
+bool BlockHeaderStore::stopRequested()
+{
+    std::lock_guard<std::mutex> lock(signal_mutex);
+    return stopping;
+}
+
+uint64_t BlockHeaderStore::size() const noexcept
+{
+    return covered.load(std::memory_order_acquire);
+}
+
+std::optional<BlockHeader> BlockHeaderStore::at(uint64_t height) const
+{
+    std::shared_lock<std::shared_mutex> lock(store_mutex);
+    if (height >= base_height + hashes.size())
+    {
+        return std::nullopt;
+    }
+
+    return headerLocked(height);
+}
+
+std::optional<std::vector<BlockHeader>> BlockHeaderStore::range(uint64_t fromHeight, uint64_t count) const
+{
+    std::shared_lock<std::shared_mutex> lock(store_mutex);
+    const uint64_t top = base_height + hashes.size();
+    if (fromHeight > top || count > top - fromHeight)
+    {
+        return std::nullopt;
+    }
+
+    std::vector<BlockHeader> headers;
+    headers.reserve(count);
+    for (uint64_t height = fromHeight; height < fromHeight + count; ++height)
+    {
+        headers.push_back(headerLocked(height));
+    }
+
+    return headers;
+}
+
+std::optional<uint64_t> BlockHeaderStore::heightAt(uint64_t timestamp) const
+{
+    std::shared_lock<std::shared_mutex> lock(store_mutex);
+
+    // The running maximum never decreases across the snapshot and the arrays, so the first height
+    // stamped after the time ends the search.
+    if (base_height > 0)
+    {
+        const uint32_t *latest = snapshot->latestTimestamps();
+        if (timestamp < latest[base_height - 1])
+        {
+            const uint32_t *later = std::upper_bound(latest, latest + base_height, timestamp);
+            return later == latest ? std::nullopt : std::optional<uint64_t>((later - latest) - 1);
+        }
+    }
+
+    const auto later = std::upper_bound(latest_timestamps.begin(), latest_timestamps.end(), timestamp);
+    const uint64_t height = base_height + static_cast<uint64_t>(later - latest_timestamps.begin());
+    if (height == 0)
+    {
+        return std::nullopt;
+    }
+
+    if (later == latest_timestamps.end() && !caught_up.load(std::memory_order_acquire))
+    {
+        return std::nullopt;
+    }
+
+    return height - 1;
+}
+
+void BlockHeaderStore::load(uint64_t tipHeight)
+{
+    try
+    {
+        {
+            // The chain was reorged onto a shorter branch, drop the heights above the new tip.
+            std::unique_lock<std::shared_mutex> lock(store_mutex);
+            if (tipHeight + 1 < base_height + hashes.size())
+            {
+                truncateLocked(std::max(tipHeight + 1, base_height));
+            }
+        }
+
+        const uint64_t top = size();
+        uint64_t from = std::max(top > options.reorg_depth ? top - options.reorg_depth : 0, base_height);
+
+        std::vector<BlockHeader> batch;
+        while (from <= tipHeight)
+        {
+            if (stopRequested())
+            {
+                return;
+            }
+
+            const uint64_t to = std::min(from + options.load_batch, tipHeight + 1);
+            db.fetchBlockHeaders(from, to, batch);
+
+            if (!apply(batch))
+            {
+                CROW_LOG_WARNING << "Header store stopped at height " << size() << ", the block is missing from the database.";
+                return;
+            }
+
+            from = to;
+        }
+
+        // A newer tip arrived during the load, the store isn't caught up until that one is loaded too.
+        std::lock_guard<std::mutex> lock(signal_mutex);
+        caught_up.store(!wanted_tip.has_value(), std::memory_order_release);
+    }
+    catch (const std::exception &e)
+    {
+        CROW_LOG_ERROR << "Header store load failed at height " << size() << ": " << e.what();
+    }
+}
+
+bool BlockHeaderStore::apply(const std::vector<BlockHeader> &headers)
+{
+    std::unique_lock<std::shared_mutex> lock(store_mutex);
+
+    const uint32_t snapshotLatest = base_height > 0 ? snapshot->latestTimestamps()[base_height - 1] : 0;
+    auto latestBelow = [&](size_t index)
+    { return index > 0 ? latest_timestamps[index - 1] : snapshotLatest; };
+
+    std::optional<size_t> lastIndex;
+    for (const BlockHeader &header : headers)
+    {
+        if (header.height < base_height)
+        {
+            continue;
+        }
+
+        const size_t index = static_cast<size_t>(header.height - base_height);
+        if (index > hashes.size())
+        {
+            return false;
+        }
+
+        if (index == hashes.size())
+        {
+            hashes.push_back(header.hash);
+            timestamps.push_back(header.timestamp);
+            sizes.push_back(header.size);
+            tx_counts.push_back(header.tx_count);
+            difficulties.push_back(header.difficulty);
+            latest_timestamps.push_back(0);
+        }
+        else
+        {
+            hashes[index] = header.hash;
+            timestamps[index] = header.timestamp;
+            sizes[index] = header.size;
+            tx_counts[index] = header.tx_count;
+            difficulties[index] = header.difficulty;
+        }
+
+        latest_timestamps[index] = std::max(latestBelow(index), header.timestamp);
+        lastIndex = index;
+    }
+
+    // A reorg can lower a rewritten block's time, so the running maximum above it is recomputed.
+    if (lastIndex.has_value())
+    {
+        for (size_t index = lastIndex.value() + 1; index < hashes.size(); ++index)
+        {
+            latest_timestamps[index] = std::max(latest_timestamps[index - 1], timestamps[index]);
+        }
+    }
+
+    covered.store(base_height + hashes.size(), std::memory_order_release);
+    height_gauge.set(static_cast<double>(base_height + hashes.size()));
+    return true;
+}
+
+void BlockHeaderStore::truncateLocked(uint64_t height)
+{
+    const size_t keep = static_cast<size_t>(height - base_height);
+    hashes.resize(keep);
+    timestamps.resize(keep);
+    sizes.resize(keep);
+    tx_counts.resize(keep);
+    difficulties.resize(keep);
+    latest_timestamps.resize(keep);
+    covered.store(height, std::memory_order_release);
+    height_gauge.set(static_cast<double>(height));
+}
+
+BlockHeader BlockHeaderStore::headerLocked(uint64_t height) const
+{
+    if (height < base_height)
+    {
+        return snapshot->header(height);
+    }
+
+    const size_t index = static_cast<size_t>(height - base_height);
+    return BlockHeader{height, hashes[index], timestamps[index], sizes[index], tx_counts[index], difficulties[index]};
+}
+
+#endif // BLOCK_HEADER_STORE_CPP
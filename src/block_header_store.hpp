@@ -0,0 +1,172 @@
+#ifndef BLOCK_HEADER_STORE_HPP
+#define BLOCK_HEADER_STORE_HPP
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <thread>
+#include <vector>
+#include "metrics.hpp"
+
+class Database;
+class ChainSnapshot;
+
+/**
+ * @brief Summary of one block, as kept by the BlockHeaderStore.
+ */
+struct BlockHeader
+{
+    uint64_t height;                  ///< Block height.
+    std::array<uint8_t, 32> hash;     ///< Block hash in the byte order of its hex encoding.
+    uint32_t timestamp;               ///< Block time, seconds since the Unix epoch.
+    uint32_t size;                    ///< Serialized size in bytes.
+    uint32_t tx_count;                ///< Number of transactions in the block.
+    double difficulty;                ///< Difficulty the block was mined at.
+};
+
+/**
+ * @brief In-memory headers of every block from genesis, stored as height indexed arrays so height lookups,
+ * height ranges and time to height lookups never touch the database.
+ *
+ * The store covers a contiguous run of heights starting at 0. It is loaded on a background thread at startup and
+ * extended whenever the tip advances, re-reading the last few heights on each extension to pick up reorgs.
+ * Heights below an attached chain snapshot are read from the snapshot and never loaded.
+ */
+class BlockHeaderStore
+{
+public:
+    struct Options
+    {
+        uint64_t load_batch;   ///< Heights fetched per query.
+        uint64_t reorg_depth;  ///< Heights below the store's top re-read on every extension.
+    };
+
+    /**
+     * @brief Constructor for the BlockHeaderStore class.
+     * @param database Database to load headers from.
+     * @param options Batch size and reorg depth.
+     */
+    BlockHeaderStore(Database &database, Options options);
+
+    /**
+     * @brief Destructor for the BlockHeaderStore class. Stops loading.
+     */
+    ~BlockHeaderStore() noexcept;
+
+    BlockHeaderStore(const BlockHeaderStore &) = delete;
+    BlockHeaderStore &operator=(const BlockHeaderStore &) = delete;
+
+    /**
+     * @brief Serve the heights a chain snapshot covers from it. Must be called before start().
+     * @param snapshot Snapshot outliving the store.
+     */
+    void attach(const ChainSnapshot &snapshot);
+
+    /**
+     * @brief Start loading the chain on a background thread.
+     */
+    void start();
+
+    /**
+     * @brief Stop loading and join the loader thread.
+     */
+    void stop();
+
+    /**
+     * @brief Ask the loader thread to catch up with a new tip. Doesn't wait for the load.
+     * @param tipHeight Height of the primary's tip.
+     */
+    void extend(uint64_t tipHeight);
+
+    /**
+     * @brief Get the number of heights the store covers.
+     * @return Heights covered, the store holds [0, size()).
+     */
+    uint64_t size() const noexcept;
+
+    /**
+     * @brief Get the header of a block.
+     * @param height Block height.
+     * @return Header, or std::nullopt if the store doesn't cover the height.
+     */
+    std::optional<BlockHeader> at(uint64_t height) const;
+
+    /**
+     * @brief Get the headers of a range of blocks.
+     * @param fromHeight First height.
+     * @param count Number of heights.
+     * @return Headers in ascending height order, or std::nullopt if the store doesn't cover the whole range.
+     */
+    std::optional<std::vector<BlockHeader>> range(uint64_t fromHeight, uint64_t count) const;
+
+    /**
+     * @brief Find the chain's height at a point in time.
+     * Block times aren't strictly increasing, so this is the last block before any block was stamped later than the time.
+     * @param timestamp Seconds since the Unix epoch.
+     * @return Height, or std::nullopt if the time is before genesis or after the store's last block while it is behind the tip.
+     */
+    std::optional<uint64_t> heightAt(uint64_t timestamp) const;
+
+private:
+    Database &db;
+    Options options;
+
+    const ChainSnapshot *snapshot{nullptr};
+    uint64_t base_height{0};                 ///< First height held in the arrays, heights below it are in the snapshot.
+
+    mutable std::shared_mutex store_mutex;
+    std::vector<std::array<uint8_t, 32>> hashes;
+    std::vector<uint32_t> timestamps;
+    std::vector<uint32_t> sizes;
+    std::vector<uint32_t> tx_counts;
+    std::vector<double> difficulties;
+    std::vector<uint32_t> latest_timestamps; ///< Highest block time at or below each height, for time to height lookups.
+    std::atomic<uint64_t> covered{0};
+    std::atomic<bool> caught_up{false};      ///< Whether the store reached the latest tip it was asked for.
+
+    std::mutex signal_mutex;
+    std::condition_variable signal;
+    bool stopping{false};
+    std::optional<uint64_t> wanted_tip; ///< Tip the loader should catch up with next.
+    std::thread loader;
+
+    Gauge &height_gauge;
+
+    /**
+     * @brief Fetch and apply headers up to a tip. Runs on the loader thread.
+     * @param tipHeight Height to load up to, inclusive.
+     */
+    void load(uint64_t tipHeight);
+
+    /**
+     * @brief Check whether stop() was called.
+     * @return True once stopping.
+     */
+    bool stopRequested();
+
+    /**
+     * @brief Write fetched headers into the arrays, overwriting reorged heights and appending new ones.
+     * @param headers Headers in ascending height order.
+     * @return False if a height is missing, leaving the store to stop short of it.
+     */
+    bool apply(const std::vector<BlockHeader> &headers);
+
+    /**
+     * @brief Truncate the arrays to end at a height. Called with store_mutex held.
+     * @param height Height after the last one kept, at least base_height.
+     */
+    void truncateLocked(uint64_t height);
+
+    /**
+     * @brief Assemble the header stored at a height. Called with store_mutex held.
+     * @param height Height below size().
+     * @return Header.
+     */
+    BlockHeader headerLocked(uint64_t height) const;
+};
+
+#endif // BLOCK_HEADER_STORE_HPP
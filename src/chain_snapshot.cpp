@@ -0,0 +1,259 @@
+#include "chain_snapshot.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifndef CHAIN_SNAPSHOT_CPP
+#define CHAIN_SNAPSHOT_CPP
+
+namespace {
+
+constexpr char snapshot_magic[8] = {'Z', 'C', 'S', 'N', 'A', 'P', 'S', 'H'};
+constexpr uint32_t snapshot_version = 1;
+
+/**
+ * Arrays following the file header, in file order.
+ */
+enum Section
+{
+    Hashes,
+    Timestamps,
+    Sizes,
+    TxCounts,
+    Difficulties,
+    LatestTimestamps,
+    Entries,
+    SectionCount
+};
+
+struct FileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    uint64_t block_count;
+    uint64_t entry_count;
+    uint64_t offsets[SectionCount]; ///< Byte offset of each section from the start of the file.
+    uint64_t file_size;
+    uint64_t checksum;              ///< FNV-1a of every byte after the header.
+};
+
+constexpr uint64_t fnv_offset_basis = 14695981039346656037ULL;
+constexpr uint64_t fnv_prime = 1099511628211ULL;
+
+uint64_t fnv1a(uint64_t hash, const uint8_t *data, size_t size)
+{
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash = (hash ^ data[i]) * fnv_prime;
+    }
+    return hash;
+}
+
+uint64_t sectionBytes(Section section, uint64_t blocks, uint64_t entries)
+{
+    switch (section)
+    {
+    case Hashes:
+        return blocks * 32;
+    case Difficulties:
+        return blocks * sizeof(double);
+    case Entries:
+        return entries * sizeof(HashIndexEntry);
+    default:
+        return blocks * sizeof(uint32_t);
+    }
+}
+
+uint64_t alignUp(uint64_t offset)
+{
+    return (offset + 7) & ~uint64_t(7);
+}
+
+/**
+ * Appends to the snapshot being written while checksumming everything after the header.
+ */
+class SectionWriter
+{
+public:
+    explicit SectionWriter(std::ofstream &out_) : out(out_) {}
+
+    void write(const void *data, size_t size)
+    {
+        out.write(static_cast<const char *>(data), static_cast<std::streamsize>(size));
+        checksum = fnv1a(checksum, static_cast<const uint8_t *>(data), size);
+        offset += size;
+    }
+
+    void pad()
+    {
+        static const uint8_t zeros[8] = {};
+        write(zeros, alignUp(offset) - offset);
+    }
+
+    std::ofstream &out;
+    uint64_t offset{sizeof(FileHeader)};
+    uint64_t checksum{fnv_offset_basis};
+};
+
+}
+
+ChainSnapshot::ChainSnapshot(const std::string &path, bool verify)
+{
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        throw std::runtime_error("Unable to open chain snapshot " + path + ".");
+    }
+
+    struct stat info;
+    if (::fstat(fd, &info) != 0 || static_cast<uint64_t>(info.st_size) < sizeof(FileHeader))
+    {
+        ::close(fd);
+        throw std::runtime_error("Chain snapshot " + path + " is truncated.");
+    }
+
+    mapping_size = static_cast<size_t>(info.st_size);
+    mapping = ::mmap(nullptr, mapping_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED)
+    {
+        mapping = nullptr;
+        throw std::runtime_error("Unable to map chain snapshot " + path + ".");
+    }
+
+    const uint8_t *base = static_cast<const uint8_t *>(mapping);
+    FileHeader header;
+    std::memcpy(&header, base, sizeof(header));
+
+    auto fail = [&](const std::string &reason)
+    {
+        ::munmap(mapping, mapping_size);
+        mapping = nullptr;
+        throw std::runtime_error("Chain snapshot " + path + " " + reason);
+    };
+
+    if (std::memcmp(header.magic, snapshot_magic, sizeof(header.magic)) != 0 || header.version != snapshot_version ||
+        header.header_size != sizeof(FileHeader))
+    {
+        fail("is not a version " + std::to_string(snapshot_version) + " chain snapshot.");
+    }
+
+    if (header.file_size != mapping_size || header.block_count > mapping_size || header.entry_count > mapping_size)
+    {
+        fail("is truncated.");
+    }
+
+    for (int section = 0; section < SectionCount; ++section)
+    {
+        const uint64_t offset = header.offsets[section];
+        const uint64_t bytes = sectionBytes(static_cast<Section>(section), header.block_count, header.entry_count);
+        if (offset % 8 != 0 || offset < sizeof(FileHeader) || offset > mapping_size || bytes > mapping_size - offset)
+        {
+            fail("has a malformed section table.");
+        }
+    }
+
+    if (verify && fnv1a(fnv_offset_basis, base + sizeof(FileHeader), mapping_size - sizeof(FileHeader)) != header.checksum)
+    {
+        fail("failed its checksum.");
+    }
+
+    // Lookups land on random pages, read ahead would only pull in pages nobody asked for.
+    ::madvise(mapping, mapping_size, MADV_RANDOM);
+
+    block_count = header.block_count;
+    entry_count = header.entry_count;
+    hashes = reinterpret_cast<const std::array<uint8_t, 32> *>(base + header.offsets[Hashes]);
+    timestamps = reinterpret_cast<const uint32_t *>(base + header.offsets[Timestamps]);
+    sizes = reinterpret_cast<const uint32_t *>(base + header.offsets[Sizes]);
+    tx_counts = reinterpret_cast<const uint32_t *>(base + header.offsets[TxCounts]);
+    difficulties = reinterpret_cast<const double *>(base + header.offsets[Difficulties]);
+    latest_timestamps = reinterpret_cast<const uint32_t *>(base + header.offsets[LatestTimestamps]);
+    index_entries = reinterpret_cast<const HashIndexEntry *>(base + header.offsets[Entries]);
+}
+
+ChainSnapshot::~ChainSnapshot() noexcept
+{
+    if (mapping != nullptr)
+    {
+        ::munmap(mapping, mapping_size);
+    }
+}
+
+BlockHeader ChainSnapshot::header(uint64_t height) const noexcept
+{
+    return BlockHeader{height, hashes[height], timestamps[height], sizes[height], tx_counts[height], difficulties[height]};
+}
+
+void ChainSnapshot::write(const std::string &path, const std::vector<BlockHeader> &headers, const std::vector<HashIndexEntry> &entries)
+{
+    for (size_t height = 0; height < headers.size(); ++height)
+    {
+        if (headers[height].height != height)
+        {
+            throw std::runtime_error("Snapshot headers are missing height " + std::to_string(height) + ".");
+        }
+    }
+
+    // Written beside the target and renamed over it, so a crash never leaves a truncated snapshot behind.
+    const std::string temporary = path + ".tmp";
+    std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+
+    FileHeader header{};
+    std::memcpy(header.magic, snapshot_magic, sizeof(header.magic));
+    header.version = snapshot_version;
+    header.header_size = sizeof(FileHeader);
+    header.block_count = headers.size();
+    header.entry_count = entries.size();
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+    SectionWriter writer(out);
+    auto column = [&](Section section, auto field)
+    {
+        writer.pad();
+        header.offsets[section] = writer.offset;
+        for (const BlockHeader &block : headers)
+        {
+            const auto value = field(block);
+            writer.write(&value, sizeof(value));
+        }
+    };
+
+    column(Hashes, [](const BlockHeader &block) { return block.hash; });
+    column(Timestamps, [](const BlockHeader &block) { return block.timestamp; });
+    column(Sizes, [](const BlockHeader &block) { return block.size; });
+    column(TxCounts, [](const BlockHeader &block) { return block.tx_count; });
+    column(Difficulties, [](const BlockHeader &block) { return block.difficulty; });
+
+    uint32_t latest = 0;
+    column(LatestTimestamps, [&latest](const BlockHeader &block) { return latest = std::max(latest, block.timestamp); });
+
+    writer.pad();
+    header.offsets[Entries] = writer.offset;
+    writer.write(entries.data(), entries.size() * sizeof(HashIndexEntry));
+
+    header.file_size = writer.offset;
+    header.checksum = writer.checksum;
+    out.seekp(0);
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+    if (!out.flush())
+    {
+        throw std::runtime_error("Unable to write chain snapshot " + temporary + ".");
+    }
+    out.close();
+
+    if (std::rename(temporary.c_str(), path.c_str()) != 0)
+    {
+        throw std::runtime_error("Unable to replace chain snapshot " + path + ".");
+    }
+}
+
+#endif // CHAIN_SNAPSHOT_CPP
@@ -0,0 +1,96 @@
+#ifndef CHAIN_SNAPSHOT_HPP
+#define CHAIN_SNAPSHOT_HPP
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "block_header_store.hpp"
+#include "hash_index.hpp"
+
+/**
+ * @brief Read only, memory mapped file holding the headers and hash index entries of every block below a height.
+ *
+ * Blocks this deep are immutable, so the API serves them from the file instead of loading them from the database.
+ * Mapping the file costs the same however long the chain is; pages are read in by the kernel as lookups touch them.
+ * Files are written by the zcash-api-snapshot tool.
+ *
+ * Layout, in host byte order: a fixed size header, then one array per header field indexed by height, then the
+ * hash index entries sorted by hash. Every array starts on an 8 byte boundary at an offset recorded in the header,
+ * and the header carries an FNV-1a checksum of everything after it.
+ */
+class ChainSnapshot
+{
+public:
+    /**
+     * @brief Map a snapshot file.
+     * @param path File to map.
+     * @param verify Check the payload checksum, which reads the whole file.
+     * @throws std::runtime_error if the file can't be mapped, isn't a supported snapshot or fails its checksum.
+     */
+    ChainSnapshot(const std::string &path, bool verify);
+
+    /**
+     * @brief Destructor for the ChainSnapshot class. Unmaps the file.
+     */
+    ~ChainSnapshot() noexcept;
+
+    ChainSnapshot(const ChainSnapshot &) = delete;
+    ChainSnapshot &operator=(const ChainSnapshot &) = delete;
+
+    /**
+     * @brief Write a snapshot file, replacing it atomically.
+     * @param path File to write.
+     * @param headers Headers of every height from 0, in ascending height order.
+     * @param entries Hash index entries for the same heights, sorted by hash.
+     * @throws std::runtime_error if the headers aren't contiguous from 0 or the file can't be written.
+     */
+    static void write(const std::string &path, const std::vector<BlockHeader> &headers, const std::vector<HashIndexEntry> &entries);
+
+    /**
+     * @brief Get the number of heights the snapshot covers.
+     * @return Heights covered, the snapshot holds [0, height()).
+     */
+    uint64_t height() const noexcept { return block_count; }
+
+    /**
+     * @brief Get the header of a block.
+     * @param height Height below height().
+     * @return Header.
+     */
+    BlockHeader header(uint64_t height) const noexcept;
+
+    /**
+     * @brief Get the highest block time at or below each height.
+     * @return Array of height() timestamps that never decreases.
+     */
+    const uint32_t *latestTimestamps() const noexcept { return latest_timestamps; }
+
+    /**
+     * @brief Get the hash index entries.
+     * @return Array of entryCount() entries sorted by hash.
+     */
+    const HashIndexEntry *entries() const noexcept { return index_entries; }
+
+    /**
+     * @brief Get the number of hash index entries.
+     * @return Entry count.
+     */
+    uint64_t entryCount() const noexcept { return entry_count; }
+
+private:
+    void *mapping{nullptr};
+    size_t mapping_size{0};
+
+    uint64_t block_count{0};
+    uint64_t entry_count{0};
+    const std::array<uint8_t, 32> *hashes{nullptr};
+    const uint32_t *timestamps{nullptr};
+    const uint32_t *sizes{nullptr};
+    const uint32_t *tx_counts{nullptr};
+    const double *difficulties{nullptr};
+    const uint32_t *latest_timestamps{nullptr};
+    const HashIndexEntry *index_entries{nullptr};
+};
+
+#endif // CHAIN_SNAPSHOT_HPP
@@ -1,8 +1,383 @@
 #include "chain_utils.hpp"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#define CHAIN_UTILS_X86 1
+#endif
+
+namespace {
+
+int hexDigitValue(char c) noexcept {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+bool decodeScalar(const char* hex, size_t pairs, uint8_t* out) noexcept {
+    for (size_t i = 0; i < pairs; ++i) {
+        const int high = hexDigitValue(hex[2 * i]);
+        const int low = hexDigitValue(hex[2 * i + 1]);
+        if (high < 0 || low < 0) {
+            return false;
+        }
+        if (out != nullptr) {
+            out[i] = static_cast<uint8_t>((high << 4) | low);
+        }
+    }
+
+    return true;
+}
+
+#ifdef CHAIN_UTILS_X86
+
+/*
+ * The SIMD decoders classify every character as a digit or, once OR-ing 0x20 has folded it to lowercase, a letter
+ * from a to f. Signed compares also reject bytes of 0x80 and up, which are negative. Digits become nibbles by
+ * subtracting '0', letters by subtracting 'a' - 10, and each 16 bit lane then holds a pair: the high nibble in its
+ * low byte and the low nibble in its high byte, which shifts and a saturating pack turn into bytes.
+ */
+
+bool nibblesSSE2(__m128i chars, __m128i& nibbles) noexcept {
+    const __m128i lower = _mm_or_si128(chars, _mm_set1_epi8(0x20));
+    const __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(chars, _mm_set1_epi8('0' - 1)), _mm_cmplt_epi8(chars, _mm_set1_epi8('9' + 1)));
+    const __m128i letter = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)), _mm_cmplt_epi8(lower, _mm_set1_epi8('f' + 1)));
+    if (_mm_movemask_epi8(_mm_or_si128(digit, letter)) != 0xFFFF) {
+        return false;
+    }
+
+    nibbles = _mm_or_si128(_mm_and_si128(digit, _mm_sub_epi8(chars, _mm_set1_epi8('0'))),
+                           _mm_andnot_si128(digit, _mm_sub_epi8(lower, _mm_set1_epi8('a' - 10))));
+    return true;
+}
+
+__m128i pairSSE2(__m128i nibbles) noexcept {
+    return _mm_or_si128(_mm_slli_epi16(_mm_and_si128(nibbles, _mm_set1_epi16(0x00FF)), 4), _mm_srli_epi16(nibbles, 8));
+}
+
+bool decodeSSE2(const char* hex, size_t pairs, uint8_t* out) noexcept {
+    size_t i = 0;
+    for (; i + 16 <= pairs; i += 16) {
+        __m128i first, second;
+        if (!nibblesSSE2(_mm_loadu_si128(reinterpret_cast<const __m128i*>(hex + 2 * i)), first) ||
+            !nibblesSSE2(_mm_loadu_si128(reinterpret_cast<const __m128i*>(hex + 2 * i + 16)), second)) {
+            return false;
+        }
+        if (out != nullptr) {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_packus_epi16(pairSSE2(first), pairSSE2(second)));
+        }
+    }
+
+    return decodeScalar(hex + 2 * i, pairs - i, out != nullptr ? out + i : nullptr);
+}
+
+__attribute__((target("avx2"))) bool nibblesAVX2(__m256i chars, __m256i& nibbles) noexcept {
+    const __m256i lower = _mm256_or_si256(chars, _mm256_set1_epi8(0x20));
+    const __m256i digit = _mm256_andnot_si256(_mm256_cmpgt_epi8(chars, _mm256_set1_epi8('9')), _mm256_cmpgt_epi8(chars, _mm256_set1_epi8('0' - 1)));
+    const __m256i letter = _mm256_andnot_si256(_mm256_cmpgt_epi8(lower, _mm256_set1_epi8('f')), _mm256_cmpgt_epi8(lower, _mm256_set1_epi8('a' - 1)));
+    if (_mm256_movemask_epi8(_mm256_or_si256(digit, letter)) != -1) {
+        return false;
+    }
+
+    nibbles = _mm256_blendv_epi8(_mm256_sub_epi8(lower, _mm256_set1_epi8('a' - 10)), _mm256_sub_epi8(chars, _mm256_set1_epi8('0')), digit);
+    return true;
+}
+
+__attribute__((target("avx2"))) __m256i pairAVX2(__m256i nibbles) noexcept {
+    return _mm256_or_si256(_mm256_slli_epi16(_mm256_and_si256(nibbles, _mm256_set1_epi16(0x00FF)), 4), _mm256_srli_epi16(nibbles, 8));
+}
+
+__attribute__((target("avx2"))) bool decodeAVX2(const char* hex, size_t pairs, uint8_t* out) noexcept {
+    size_t i = 0;
+    for (; i + 32 <= pairs; i += 32) {
+        __m256i first, second;
+        if (!nibblesAVX2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(hex + 2 * i)), first) ||
+            !nibblesAVX2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(hex + 2 * i + 32)), second)) {
+            return false;
+        }
+        if (out != nullptr) {
+            // The pack interleaves the two inputs per 128 bit lane, the permute puts the quarters back in order.
+            const __m256i packed = _mm256_packus_epi16(pairAVX2(first), pairAVX2(second));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_permute4x64_epi64(packed, 0xD8));
+        }
+    }
+
+    return decodeSSE2(hex + 2 * i, pairs - i, out != nullptr ? out + i : nullptr);
+}
+
+#endif
+
+constexpr uint32_t sha256_round_constants[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+uint32_t rotateRight(uint32_t value, int bits) noexcept {
+    return (value >> bits) | (value << (32 - bits));
+}
+
+/**
+ * SHA-256 of a short message, enough for address checksums.
+ */
+std::array<uint8_t, 32> sha256(const uint8_t* data, size_t size) noexcept {
+    uint32_t state[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+
+    // The message, a 0x80 byte and its length in bits, zero padded to whole 64 byte blocks.
+    std::vector<uint8_t> message(data, data + size);
+    message.push_back(0x80);
+    message.resize((message.size() + 8 + 63) / 64 * 64, 0);
+    for (int i = 0; i < 8; ++i) {
+        message[message.size() - 1 - i] = static_cast<uint8_t>((static_cast<uint64_t>(size) * 8) >> (8 * i));
+    }
+
+    for (size_t block = 0; block < message.size(); block += 64) {
+        uint32_t w[64];
+        for (int i = 0; i < 16; ++i) {
+            w[i] = static_cast<uint32_t>(message[block + 4 * i]) << 24 | static_cast<uint32_t>(message[block + 4 * i + 1]) << 16 |
+                   static_cast<uint32_t>(message[block + 4 * i + 2]) << 8 | message[block + 4 * i + 3];
+        }
+        for (int i = 16; i < 64; ++i) {
+            const uint32_t s0 = rotateRight(w[i - 15], 7) ^ rotateRight(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            const uint32_t s1 = rotateRight(w[i - 2], 17) ^ rotateRight(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4], f = state[5], g = state[6], h = state[7];
+        for (int i = 0; i < 64; ++i) {
+            const uint32_t t1 = h + (rotateRight(e, 6) ^ rotateRight(e, 11) ^ rotateRight(e, 25)) + ((e & f) ^ (~e & g)) + sha256_round_constants[i] + w[i];
+            const uint32_t t2 = (rotateRight(a, 2) ^ rotateRight(a, 13) ^ rotateRight(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+            h = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + t2;
+        }
+
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+        state[5] += f;
+        state[6] += g;
+        state[7] += h;
+    }
+
+    std::array<uint8_t, 32> digest;
+    for (int i = 0; i < 8; ++i) {
+        for (int j = 0; j < 4; ++j) {
+            digest[4 * i + j] = static_cast<uint8_t>(state[i] >> (24 - 8 * j));
+        }
+    }
+    return digest;
+}
+
+/**
+ * Decodes Base58 into big endian bytes, keeping a leading zero byte for each leading '1'.
+ */
+bool base58Decode(const std::string& text, std::vector<uint8_t>& out) {
+    static const char alphabet[] = "123456789ABCDEFGHJKLMNPQRSTUVWXYZabcdefghijkmnopqrstuvwxyz";
+
+    std::vector<uint8_t> number;
+    for (char c : text) {
+        const char* digit = c != '\0' ? std::strchr(alphabet, c) : nullptr;
+        if (digit == nullptr) {
+            return false;
+        }
+
+        // number = number * 58 + digit, as little endian base 256.
+        uint32_t carry = static_cast<uint32_t>(digit - alphabet);
+        for (uint8_t& byte : number) {
+            carry += static_cast<uint32_t>(byte) * 58;
+            byte = static_cast<uint8_t>(carry);
+            carry >>= 8;
+        }
+        for (; carry > 0; carry >>= 8) {
+            number.push_back(static_cast<uint8_t>(carry));
+        }
+    }
+
+    const size_t zeros = std::find_if(text.begin(), text.end(), [](char c) { return c != '1'; }) - text.begin();
+    out.assign(zeros, 0);
+    out.insert(out.end(), number.rbegin(), number.rend());
+    return true;
+}
+
+using DecodeFunction = bool (*)(const char*, size_t, uint8_t*) noexcept;
+
+DecodeFunction decoderFor(HexDecoder decoder) noexcept {
+    switch (decoder) {
+#ifdef CHAIN_UTILS_X86
+    case HexDecoder::AVX2:
+        return decodeAVX2;
+    case HexDecoder::SSE2:
+        return decodeSSE2;
+#endif
+    default:
+        return decodeScalar;
+    }
+}
+
+HexDecoder fastestDecoder() noexcept {
+    for (HexDecoder decoder : {HexDecoder::AVX2, HexDecoder::SSE2}) {
+        if (hexDecoderSupported(decoder)) {
+            return decoder;
+        }
+    }
+    return HexDecoder::Scalar;
+}
+
+bool decodeHex(const char* hex, size_t pairs, uint8_t* out) noexcept {
+    static const DecodeFunction decode = decoderFor(fastestDecoder());
+    return decode(hex, pairs, out);
+}
+
+}
+
+bool hexDecoderSupported(HexDecoder decoder) noexcept {
+    switch (decoder) {
+#ifdef CHAIN_UTILS_X86
+    case HexDecoder::AVX2:
+        return __builtin_cpu_supports("avx2");
+    case HexDecoder::SSE2:
+        return true;
+#endif
+    case HexDecoder::Scalar:
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool hexDecodeWith(HexDecoder decoder, const char* hex, size_t pairs, uint8_t* out) noexcept {
+    return decoderFor(decoder)(hex, pairs, out);
+}
 
 bool isValidSHA256Hash(const std::string& hash) noexcept {
-    size_t hashLength = hash.size();
-    return hashLength == ZCASH_SHA256_HASH_LENGTH;
+    return hash.size() == ZCASH_SHA256_HASH_LENGTH && decodeHex(hash.data(), ZCASH_SHA256_HASH_BYTES, nullptr);
+}
+
+bool decodeSHA256Hash(const std::string& hex, std::array<uint8_t, ZCASH_SHA256_HASH_BYTES>& out) noexcept {
+    return hex.size() == ZCASH_SHA256_HASH_LENGTH && decodeHex(hex.data(), ZCASH_SHA256_HASH_BYTES, out.data());
+}
+
+bool decodeSHA256HashPrefix(const std::string& hex, std::array<uint8_t, ZCASH_SHA256_HASH_BYTES>& out) noexcept {
+    if (hex.size() > ZCASH_SHA256_HASH_LENGTH) {
+        return false;
+    }
+
+    out.fill(0);
+    const size_t pairs = hex.size() / 2;
+    if (!decodeHex(hex.data(), pairs, out.data())) {
+        return false;
+    }
+    if (hex.size() % 2 == 0) {
+        return true;
+    }
+
+    const int high = hexDigitValue(hex.back());
+    if (high < 0) {
+        return false;
+    }
+    out[pairs] = static_cast<uint8_t>(high << 4);
+    return true;
+}
+
+bool normalizeSHA256Hash(std::string& hash) noexcept {
+    if (!isValidSHA256Hash(hash)) {
+        return false;
+    }
+
+    // Setting 0x20 lowercases A-F and leaves digits as they are.
+    for (char& c : hash) {
+        c = static_cast<char>(c | 0x20);
+    }
+
+    return true;
+}
+
+bool isHexString(const std::string& str) noexcept {
+    if (str.empty() || str.size() % 2 != 0) {
+        return false;
+    }
+
+    return decodeHex(str.data(), str.size() / 2, nullptr);
+}
+
+bool hexToBytes(const std::string& hex, std::vector<uint8_t>& out) {
+    if (hex.empty() || hex.size() % 2 != 0) {
+        return false;
+    }
+
+    std::vector<uint8_t> bytes(hex.size() / 2);
+    if (!decodeHex(hex.data(), bytes.size(), bytes.data())) {
+        return false;
+    }
+
+    out.swap(bytes);
+    return true;
+}
+
+bool isValidTransparentAddress(const std::string& address) noexcept {
+    // Two version bytes, a 20 byte key or script hash and a 4 byte checksum take 35 Base58 digits.
+    if (address.size() != 35 || address[0] != 't') {
+        return false;
+    }
+
+    try {
+        std::vector<uint8_t> decoded;
+        if (!base58Decode(address, decoded) || decoded.size() != 26) {
+            return false;
+        }
+
+        const uint16_t version = static_cast<uint16_t>(decoded[0] << 8 | decoded[1]);
+        if (version != 0x1cb8 && version != 0x1cbd && version != 0x1d25 && version != 0x1cba) {
+            return false;
+        }
+
+        const std::array<uint8_t, 32> first = sha256(decoded.data(), 22);
+        const std::array<uint8_t, 32> checksum = sha256(first.data(), first.size());
+        return std::equal(checksum.begin(), checksum.begin() + 4, decoded.begin() + 22);
+    } catch (const std::exception&) {
+        return false;
+    }
+}
+
+SearchTerm classifySearchTerm(const std::string& term) noexcept {
+    if (isValidSHA256Hash(term)) {
+        return SearchTerm::Hash;
+    }
+
+    if (!term.empty() && term.size() <= 10 && std::all_of(term.begin(), term.end(), [](char c) { return c >= '0' && c <= '9'; })) {
+        return SearchTerm::Height;
+    }
+
+    if (isValidTransparentAddress(term)) {
+        return SearchTerm::TransparentAddress;
+    }
+
+    return SearchTerm::Unknown;
+}
+
+std::string bytesToHex(const uint8_t* bytes, size_t size) {
+    static const char digits[] = "0123456789abcdef";
+
+    std::string hex(size * 2, '0');
+    for (size_t i = 0; i < size; ++i) {
+        hex[2 * i] = digits[bytes[i] >> 4];
+        hex[2 * i + 1] = digits[bytes[i] & 0x0f];
+    }
 
-    return false;
-}
\ No newline at end of file
+    return hex;
+}
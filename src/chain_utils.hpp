@@ -1,9 +1,116 @@
 #ifndef CHAIN_UTILS
 #define CHAIN_UTILS
 
+#include <array>
 #include <string>
+#include <cstdint>
+#include <vector>
 
 const uint64_t ZCASH_SHA256_HASH_LENGTH = 64;
-bool isValidSHA256Hash(const std::string&) noexcept;
+const uint64_t ZCASH_SHA256_HASH_BYTES = 32;
 
-#endif // CHAIN_UTILS
\ No newline at end of file
+/**
+ * @brief Check whether a string is a hash: exactly 64 hexadecimal digits, in either case.
+ * @param hash String to check.
+ * @return True if the string is a hash.
+ */
+bool isValidSHA256Hash(const std::string& hash) noexcept;
+
+/**
+ * @brief Decode a hash.
+ * @param hex 64 hexadecimal digits, in either case.
+ * @param out Destination for the 32 bytes, left unspecified if the input is not a hash.
+ * @return True on success, false if the input is not a hash.
+ */
+bool decodeSHA256Hash(const std::string& hex, std::array<uint8_t, ZCASH_SHA256_HASH_BYTES>& out) noexcept;
+
+/**
+ * @brief Decode the leading digits of a hash, such as a partially typed search term.
+ * @param hex Up to 64 hexadecimal digits, in either case. An odd last digit fills the high half of its byte.
+ * @param out Destination for the bytes, zero past the prefix, left unspecified if the input is not a prefix.
+ * @return True on success, false if the input is too long or not hexadecimal.
+ */
+bool decodeSHA256HashPrefix(const std::string& hex, std::array<uint8_t, ZCASH_SHA256_HASH_BYTES>& out) noexcept;
+
+/**
+ * @brief Lowercase a hash in place, the case hashes are stored in.
+ * @param hash String to normalize.
+ * @return True on success, false, leaving the string untouched, if it is not a hash.
+ */
+bool normalizeSHA256Hash(std::string& hash) noexcept;
+
+/**
+ * @brief Check whether a string consists solely of hexadecimal digits.
+ * @param str String to check.
+ * @return True if the string is non-empty, of even length and only contains [0-9a-fA-F].
+ */
+bool isHexString(const std::string& str) noexcept;
+
+/**
+ * @brief Decode a hexadecimal string into raw bytes.
+ * @param hex Hexadecimal string to decode.
+ * @param out Destination vector, replaced with the decoded bytes.
+ * @return True on success, false if the input is not valid hex.
+ */
+bool hexToBytes(const std::string& hex, std::vector<uint8_t>& out);
+
+/**
+ * @brief Encode raw bytes as a lowercase hexadecimal string.
+ * @param bytes Bytes to encode.
+ * @param size Number of bytes.
+ * @return Hexadecimal string twice as long as the input.
+ */
+std::string bytesToHex(const uint8_t* bytes, size_t size);
+
+/**
+ * @brief Check whether a string is a transparent address: Base58Check with a P2PKH (t1, tm) or P2SH (t3, t2) prefix
+ * and a valid checksum.
+ * @param address String to check.
+ * @return True if the string is a transparent address.
+ */
+bool isValidTransparentAddress(const std::string& address) noexcept;
+
+/**
+ * @brief What a search term looks like, classified without any lookup.
+ */
+enum class SearchTerm {
+    Height,             ///< Up to 10 decimal digits.
+    Hash,               ///< 64 hex digits, a block hash or a txid.
+    TransparentAddress, ///< A transparent address with a valid checksum.
+    Unknown
+};
+
+/**
+ * @brief Classify a search term.
+ * @param term Term as typed, without surrounding whitespace.
+ * @return The kind of term.
+ */
+SearchTerm classifySearchTerm(const std::string& term) noexcept;
+
+/**
+ * @brief Hex decoders. The fastest one the CPU supports is picked at startup; the others are exposed for benchmarking.
+ */
+enum class HexDecoder {
+    Scalar,
+    SSE2,
+    AVX2
+};
+
+/**
+ * @brief Check whether a hex decoder can run on this CPU.
+ * @param decoder Decoder to check.
+ * @return True if the decoder is supported.
+ */
+bool hexDecoderSupported(HexDecoder decoder) noexcept;
+
+/**
+ * @brief Validate and decode hex digit pairs with a given decoder.
+ * @param decoder A supported decoder.
+ * @param hex Digits to decode, in either case.
+ * @param pairs Number of digit pairs, the bytes decoded.
+ * @param out Destination for the bytes, or nullptr to only validate.
+ * @return True on success, false if any digit is not hexadecimal.
+ */
+bool hexDecodeWith(HexDecoder decoder, const char* hex, size_t pairs, uint8_t* out) noexcept;
+
+#endif // CHAIN_UTILS
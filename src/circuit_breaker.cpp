@@ -0,0 +1,120 @@
+#include "circuit_breaker.hpp"
+#include "../include/crow_all.h"
+#include <algorithm>
+
+#ifndef CIRCUIT_BREAKER_CPP
+#define CIRCUIT_BREAKER_CPP
+
+CircuitBreaker::CircuitBreaker(const std::string &name_, Options options_)
+    : name(name_), options(options_),
+      state_gauge(Metrics::instance().gauge("zcash_api_circuit_state", "Circuit breaker state: 0 closed, 1 open, 2 half open.", "circuit=\"" + name_ + "\"")),
+      opened(Metrics::instance().counter("zcash_api_circuit_opened_total", "Times a circuit breaker opened.", "circuit=\"" + name_ + "\"")),
+      rejected(Metrics::instance().counter("zcash_api_circuit_rejected_total", "Calls failed fast by an open circuit breaker.", "circuit=\"" + name_ + "\""))
+{
+}
+
+bool CircuitBreaker::allow()
+{
+    std::lock_guard<std::mutex> lock(breaker_mutex);
+
+    if (current == CircuitState::Open && clock::now() - opened_at >= options.open_duration)
+    {
+        transitionLocked(CircuitState::HalfOpen);
+    }
+
+    switch (current)
+    {
+    case CircuitState::Closed:
+        return true;
+    case CircuitState::HalfOpen:
+        if (probes_in_flight < options.half_open_probes)
+        {
+            ++probes_in_flight;
+            return true;
+        }
+        break;
+    case CircuitState::Open:
+        break;
+    }
+
+    rejected.increment();
+    return false;
+}
+
+void CircuitBreaker::succeeded()
+{
+    std::lock_guard<std::mutex> lock(breaker_mutex);
+
+    consecutive_failures = 0;
+    if (current == CircuitState::HalfOpen)
+    {
+        transitionLocked(CircuitState::Closed);
+    }
+}
+
+void CircuitBreaker::failed()
+{
+    std::lock_guard<std::mutex> lock(breaker_mutex);
+
+    switch (current)
+    {
+    case CircuitState::Closed:
+        if (++consecutive_failures >= options.failure_threshold)
+        {
+            transitionLocked(CircuitState::Open);
+        }
+        break;
+    case CircuitState::HalfOpen:
+        transitionLocked(CircuitState::Open);
+        break;
+    case CircuitState::Open:
+        // A call let through before the circuit opened, it tells us nothing new.
+        break;
+    }
+}
+
+CircuitState CircuitBreaker::state() const
+{
+    std::lock_guard<std::mutex> lock(breaker_mutex);
+    return current;
+}
+
+std::chrono::milliseconds CircuitBreaker::retryAfter() const
+{
+    std::lock_guard<std::mutex> lock(breaker_mutex);
+
+    if (current != CircuitState::Open)
+    {
+        return std::chrono::milliseconds(0);
+    }
+
+    const auto left = options.open_duration - std::chrono::duration_cast<std::chrono::milliseconds>(clock::now() - opened_at);
+    return std::max(left, std::chrono::milliseconds(0));
+}
+
+void CircuitBreaker::transitionLocked(CircuitState next)
+{
+    current = next;
+    consecutive_failures = 0;
+    probes_in_flight = 0;
+
+    switch (next)
+    {
+    case CircuitState::Closed:
+        state_gauge.set(0);
+        CROW_LOG_INFO << "Circuit " << name << " closed after a successful probe.";
+        break;
+    case CircuitState::Open:
+        opened_at = clock::now();
+        opened.increment();
+        state_gauge.set(1);
+        CROW_LOG_WARNING << "Circuit " << name << " opened, failing calls fast for " << options.open_duration.count() << " ms.";
+        break;
+    case CircuitState::HalfOpen:
+        state_gauge.set(2);
+        CROW_LOG_INFO << "Circuit " << name << " half open, probing.";
+        break;
+    }
+}
+
+#endif // CIRCUIT_BREAKER_CPP
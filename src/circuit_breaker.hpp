@@ -0,0 +1,99 @@
+#ifndef CIRCUIT_BREAKER_HPP
+#define CIRCUIT_BREAKER_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include "metrics.hpp"
+
+/**
+ * @brief State of a CircuitBreaker.
+ */
+enum class CircuitState
+{
+    Closed,   ///< Calls go through, consecutive failures are counted.
+    Open,     ///< Calls are refused until the open period ends.
+    HalfOpen  ///< A few probe calls go through to detect recovery.
+};
+
+/**
+ * @brief Fails calls to a dependency fast once it keeps failing, instead of letting every caller wait for it to time out.
+ *
+ * Opens after a run of consecutive failures and refuses calls for a fixed period, then lets a few probes through.
+ * A successful probe closes the circuit, a failed one opens it again.
+ */
+class CircuitBreaker
+{
+public:
+    struct Options
+    {
+        uint32_t failure_threshold;              ///< Consecutive failures that open the circuit.
+        std::chrono::milliseconds open_duration; ///< How long the circuit stays open before probing.
+        uint32_t half_open_probes;               ///< Calls let through at once while half open.
+    };
+
+    /**
+     * @brief Constructor for the CircuitBreaker class.
+     * @param name Name of the protected dependency, used in logs and metrics.
+     * @param options Thresholds and timings.
+     */
+    CircuitBreaker(const std::string &name, Options options);
+
+    /**
+     * @brief Destructor for the CircuitBreaker class.
+     */
+    ~CircuitBreaker() noexcept = default;
+
+    /**
+     * @brief Ask to make a call. Every allowed call must be paired with succeeded() or failed().
+     * @return False if the call must fail fast.
+     */
+    bool allow();
+
+    /**
+     * @brief Record that an allowed call succeeded.
+     */
+    void succeeded();
+
+    /**
+     * @brief Record that an allowed call failed because the dependency is unavailable.
+     */
+    void failed();
+
+    /**
+     * @brief Get the circuit's current state.
+     * @return State.
+     */
+    CircuitState state() const;
+
+    /**
+     * @brief Get how long until the circuit next lets a probe through.
+     * @return Time left in the open period, zero unless the circuit is open.
+     */
+    std::chrono::milliseconds retryAfter() const;
+
+private:
+    using clock = std::chrono::steady_clock;
+
+    std::string name;
+    Options options;
+
+    mutable std::mutex breaker_mutex;
+    CircuitState current{CircuitState::Closed};
+    uint32_t consecutive_failures{0};
+    uint32_t probes_in_flight{0};
+    clock::time_point opened_at;
+
+    Gauge &state_gauge;
+    Counter &opened;
+    Counter &rejected;
+
+    /**
+     * @brief Move to a new state. Called with breaker_mutex held.
+     * @param next State to move to.
+     */
+    void transitionLocked(CircuitState next);
+};
+
+#endif // CIRCUIT_BREAKER_HPP
@@ -1,6 +1,10 @@
 #ifndef CONFIG_H
 #define CONFIG_H
 
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <climits>
 #include <cstdlib>
 #include <string>
 #include <stdexcept>
@@ -20,6 +24,47 @@ public:
         return std::string(val);
     }
 
+    // Typed getters check the value where it is read, so a bad setting stops startup with the variable's name
+    // rather than a bare std::stoul error, or is silently read as false.
+    static std::string getUnsignedEnv(const char* key, const std::string& defaultValue) {
+        std::string value = getEnv(key, defaultValue);
+        const bool digits = !value.empty() && value.find_first_not_of("0123456789") == std::string::npos;
+        errno = 0;
+        if (!digits || (std::strtoull(value.c_str(), nullptr, 10) == ULLONG_MAX && errno == ERANGE)) {
+            throw invalidEnv(key, value, "a whole number");
+        }
+        return value;
+    }
+
+    static std::string getNumberEnv(const char* key, const std::string& defaultValue) {
+        std::string value = getEnv(key, defaultValue);
+        char* end = nullptr;
+        errno = 0;
+        const double number = std::strtod(value.c_str(), &end);
+        if (value.empty() || *end != '\0' || errno == ERANGE || !(number >= 0)) {
+            throw invalidEnv(key, value, "a non-negative number");
+        }
+        return value;
+    }
+
+    // Returns "true" or "false", whatever the case of the value.
+    static std::string getFlagEnv(const char* key, const std::string& defaultValue) {
+        std::string value = getEnv(key, defaultValue);
+        std::transform(value.begin(), value.end(), value.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        if (value == "true" || value == "1") {
+            return "true";
+        }
+        if (value == "false" || value == "0") {
+            return "false";
+        }
+        throw invalidEnv(key, value, "true or false");
+    }
+
+    static std::string getOptionalEnv(const char* key) {
+        char* val = std::getenv(key);
+        return val == nullptr ? std::string() : std::string(val);  // Unset means the feature is disabled
+    }
+
     static std::string getDatabaseHost() {
         return getEnv("DB_HOST", "localhost");
     }
@@ -41,12 +86,294 @@ public:
     }
 
     static std::string getApiPort() {
-        return getEnv("PORT", "8000");
+        return getUnsignedEnv("PORT", "8000");
+    }
+
+    static std::string getExportBatchHeights() {
+        return getUnsignedEnv("EXPORT_BATCH_HEIGHTS", "1000");
+    }
+
+    static std::string getExportMaxConnections() {
+        return getUnsignedEnv("EXPORT_MAX_CONNECTIONS", "2");
+    }
+
+    static std::string getAdmissionConcurrency() {
+        return getUnsignedEnv("ADMISSION_CONCURRENCY", "8");
+    }
+
+    static std::string getAdmissionQueueDepth() {
+        return getUnsignedEnv("ADMISSION_QUEUE_DEPTH", "32");
+    }
+
+    static std::string getAdmissionHeavyConcurrency() {
+        return getUnsignedEnv("ADMISSION_HEAVY_CONCURRENCY", "2");
+    }
+
+    static std::string getAdmissionHeavyQueueDepth() {
+        return getUnsignedEnv("ADMISSION_HEAVY_QUEUE_DEPTH", "4");
+    }
+
+    static std::string getAdmissionMaxQueued() {
+        const std::string value = getEnv("ADMISSION_MAX_QUEUED", "auto");
+        return value == "auto" ? value : getUnsignedEnv("ADMISSION_MAX_QUEUED", value);
+    }
+
+    static std::string getAdmissionQueueTimeoutMs() {
+        return getUnsignedEnv("ADMISSION_QUEUE_TIMEOUT_MS", "2000");
+    }
+
+    static std::string getAdmissionRetryAfterSeconds() {
+        return getUnsignedEnv("ADMISSION_RETRY_AFTER_SECONDS", "1");
+    }
+
+    static std::string getAdaptiveLimitInitial() {
+        return getUnsignedEnv("ADAPTIVE_LIMIT_INITIAL", "16");
+    }
+
+    static std::string getAdaptiveLimitMin() {
+        return getUnsignedEnv("ADAPTIVE_LIMIT_MIN", "2");
+    }
+
+    static std::string getAdaptiveLimitMax() {
+        return getUnsignedEnv("ADAPTIVE_LIMIT_MAX", "128");
+    }
+
+    static std::string getAdaptiveLimitTolerance() {
+        return getNumberEnv("ADAPTIVE_LIMIT_TOLERANCE", "2.0");
+    }
+
+    static std::string getAdaptiveLimitPoolWaitMs() {
+        return getUnsignedEnv("ADAPTIVE_LIMIT_POOL_WAIT_MS", "50");
+    }
+
+    static std::string getAdaptiveLimitWindow() {
+        return getUnsignedEnv("ADAPTIVE_LIMIT_WINDOW", "50");
+    }
+
+    static std::string getRateLimitCapacity() {
+        return getNumberEnv("RATE_LIMIT_CAPACITY", "120");
+    }
+
+    static std::string getRateLimitRefillPerSecond() {
+        return getNumberEnv("RATE_LIMIT_REFILL_PER_SECOND", "20");
+    }
+
+    static std::string getRateLimitBulkCost() {
+        return getNumberEnv("RATE_LIMIT_BULK_COST", "60");
+    }
+
+    static std::string getRateLimitTrustForwardedFor() {
+        return getFlagEnv("RATE_LIMIT_TRUST_FORWARDED_FOR", "false");
+    }
+
+    static std::string getRateLimitTrustedProxies() {
+        return getOptionalEnv("RATE_LIMIT_TRUSTED_PROXIES");
+    }
+
+    static std::string getRateLimitApiKeys() {
+        return getOptionalEnv("RATE_LIMIT_API_KEYS");
+    }
+
+    static std::string getRateLimitIdleTimeoutSeconds() {
+        return getUnsignedEnv("RATE_LIMIT_IDLE_TIMEOUT_SECONDS", "300");
+    }
+
+    static std::string getTraceSampleEvery() {
+        return getUnsignedEnv("TRACE_SAMPLE_EVERY", "100");
+    }
+
+    static std::string getSlowRequestThresholdMs() {
+        return getUnsignedEnv("SLOW_REQUEST_THRESHOLD_MS", "1000");
+    }
+
+    static std::string getLogLevel() {
+        return getEnv("LOG_LEVEL", "INFO");
+    }
+
+    static std::string getLogFlushIntervalMs() {
+        return getUnsignedEnv("LOG_FLUSH_INTERVAL_MS", "100");
+    }
+
+    static std::string getPoolMinSize() {
+        return getUnsignedEnv("DB_POOL_MIN_SIZE", "4");
+    }
+
+    static std::string getPoolMaxSize() {
+        return getUnsignedEnv("DB_POOL_MAX_SIZE", "20");
+    }
+
+    static std::string getPoolIdleTimeoutMs() {
+        return getUnsignedEnv("DB_POOL_IDLE_TIMEOUT_MS", "300000");
+    }
+
+    static std::string getPoolMaxLifetimeMs() {
+        return getUnsignedEnv("DB_POOL_MAX_LIFETIME_MS", "1800000");
+    }
+
+    static std::string getPoolMinReady() {
+        return getUnsignedEnv("DB_POOL_MIN_READY", "2");
+    }
+
+    static std::string getPoolCheckoutTimeoutMs() {
+        return getUnsignedEnv("DB_POOL_CHECKOUT_TIMEOUT_MS", "5000");
+    }
+
+    static std::string getPoolValidationIntervalMs() {
+        return getUnsignedEnv("DB_POOL_VALIDATION_INTERVAL_MS", "5000");
+    }
+
+    static std::string getPoolKeepaliveIntervalMs() {
+        return getUnsignedEnv("DB_POOL_KEEPALIVE_INTERVAL_MS", "30000");
+    }
+
+    static std::string getPoolReconnectBackoffMaxMs() {
+        return getUnsignedEnv("DB_POOL_RECONNECT_BACKOFF_MAX_MS", "30000");
+    }
+
+    static std::string getReadRetryAttempts() {
+        return getUnsignedEnv("DB_READ_RETRY_ATTEMPTS", "2");
+    }
+
+    static std::string getReplicaHosts() {
+        return getOptionalEnv("DB_REPLICA_HOSTS");
+    }
+
+    static std::string getReplicaMaxLagBlocks() {
+        return getUnsignedEnv("DB_REPLICA_MAX_LAG_BLOCKS", "1");
+    }
+
+    static std::string getReplicaEjectFailures() {
+        return getUnsignedEnv("DB_REPLICA_EJECT_FAILURES", "3");
+    }
+
+    static std::string getReplicaEjectMs() {
+        return getUnsignedEnv("DB_REPLICA_EJECT_MS", "30000");
+    }
+
+    static std::string getHedgeEnabled() {
+        return getFlagEnv("HEDGE_ENABLED", "false");
+    }
+
+    static std::string getHedgeBudgetPercent() {
+        return getNumberEnv("HEDGE_BUDGET_PERCENT", "5");
+    }
+
+    static std::string getHedgeMinDelayMs() {
+        return getUnsignedEnv("HEDGE_MIN_DELAY_MS", "2");
+    }
+
+    static std::string getHedgeMinSamples() {
+        return getUnsignedEnv("HEDGE_MIN_SAMPLES", "50");
+    }
+
+    static std::string getHedgeMaxThreads() {
+        return getUnsignedEnv("HEDGE_MAX_THREADS", "4");
+    }
+
+    static std::string getCircuitFailureThreshold() {
+        return getUnsignedEnv("DB_CIRCUIT_FAILURE_THRESHOLD", "5");
+    }
+
+    static std::string getCircuitOpenMs() {
+        return getUnsignedEnv("DB_CIRCUIT_OPEN_MS", "5000");
+    }
+
+    static std::string getCircuitHalfOpenProbes() {
+        return getUnsignedEnv("DB_CIRCUIT_HALF_OPEN_PROBES", "1");
+    }
+
+    static std::string getStatementTimeoutMs() {
+        return getUnsignedEnv("STATEMENT_TIMEOUT_MS", "5000");
+    }
+
+    static std::string getStatementTimeoutHeavyMs() {
+        return getUnsignedEnv("STATEMENT_TIMEOUT_HEAVY_MS", "60000");
+    }
+
+    static std::string getQueryWatchdogIntervalMs() {
+        return getUnsignedEnv("QUERY_WATCHDOG_INTERVAL_MS", "100");
+    }
+
+    static std::string getTipPollIntervalMs() {
+        return getUnsignedEnv("TIP_POLL_INTERVAL_MS", "5000");
+    }
+
+    static std::string getTipMaxAgeMs() {
+        return getUnsignedEnv("TIP_MAX_AGE_MS", "30000");
+    }
+
+    static std::string getHeaderStoreEnabled() {
+        return getFlagEnv("HEADER_STORE_ENABLED", "true");
+    }
+
+    static std::string getHeaderStoreLoadBatch() {
+        return getUnsignedEnv("HEADER_STORE_LOAD_BATCH", "10000");
+    }
+
+    static std::string getHeaderStoreReorgDepth() {
+        return getUnsignedEnv("HEADER_STORE_REORG_DEPTH", "10");
+    }
+
+    static std::string getHashIndexEnabled() {
+        return getFlagEnv("HASH_INDEX_ENABLED", "true");
+    }
+
+    static std::string getHashIndexLoadBatch() {
+        return getUnsignedEnv("HASH_INDEX_LOAD_BATCH", "10000");
+    }
+
+    static std::string getHashIndexMergeThreshold() {
+        return getUnsignedEnv("HASH_INDEX_MERGE_THRESHOLD", "65536");
+    }
+
+    static std::string getHashIndexSnapshotPath() {
+        return getOptionalEnv("HASH_INDEX_SNAPSHOT_PATH");
+    }
+
+    static std::string getBlocksRangeMaxSpan() {
+        return getUnsignedEnv("BLOCKS_RANGE_MAX_SPAN", "1000");
+    }
+
+    static std::string getBlocksImmutableDepth() {
+        return getUnsignedEnv("BLOCKS_IMMUTABLE_DEPTH", "100");
+    }
+
+    static std::string getHashFilterEnabled() {
+        return getFlagEnv("HASH_FILTER_ENABLED", "true");
+    }
+
+    static std::string getHashFilterBlockCapacity() {
+        return getUnsignedEnv("HASH_FILTER_BLOCK_CAPACITY", "4000000");
+    }
+
+    static std::string getHashFilterTransactionCapacity() {
+        return getUnsignedEnv("HASH_FILTER_TRANSACTION_CAPACITY", "40000000");
+    }
+
+    static std::string getHashFilterBitsPerEntry() {
+        return getUnsignedEnv("HASH_FILTER_BITS_PER_ENTRY", "10");
+    }
+
+    static std::string getChainSnapshotPath() {
+        return getOptionalEnv("CHAIN_SNAPSHOT_PATH");
+    }
+
+    static std::string getChainSnapshotVerify() {
+        return getFlagEnv("CHAIN_SNAPSHOT_VERIFY", "true");
+    }
+
+    static std::string getChainSnapshotConfirmations() {
+        return getUnsignedEnv("CHAIN_SNAPSHOT_CONFIRMATIONS", "100");
     }
 
     static std::string getAccessControlOrigin() {
         return getEnv("ACCESS_CONTROL_ORIGIN", "*");
     }
+
+private:
+    static std::runtime_error invalidEnv(const char* key, const std::string& value, const char* expected) {
+        return std::runtime_error(std::string("Environment variable ") + key + " must be " + expected + ", got \"" + value + "\".");
+    }
 };
 
 #endif // CONFIG_H
@@ -0,0 +1,623 @@
+#include "connection_pool.hpp"
+#include "../include/crow_all.h"
+#include <algorithm>
+#include <random>
+#include <stdexcept>
+
+#ifndef CONNECTION_POOL_CPP
+#define CONNECTION_POOL_CPP
+
+ConnectionPool::Instruments::Instruments(const std::string &pool)
+    : idle(Metrics::instance().gauge("zcash_api_db_pool_connections", "Pooled database connections by state.", "pool=\"" + pool + "\",state=\"idle\"")),
+      in_use(Metrics::instance().gauge("zcash_api_db_pool_connections", "Pooled database connections by state.", "pool=\"" + pool + "\",state=\"in_use\"")),
+      waiters(Metrics::instance().gauge("zcash_api_db_pool_waiters", "Callers waiting to check out a database connection.", "pool=\"" + pool + "\"")),
+      pending(Metrics::instance().gauge("zcash_api_db_pool_pending_opens", "Database connections scheduled to open.", "pool=\"" + pool + "\"")),
+      grown(Metrics::instance().counter("zcash_api_db_pool_events_total", "Database connection pool events.", "pool=\"" + pool + "\",event=\"grow\"")),
+      reaped(Metrics::instance().counter("zcash_api_db_pool_events_total", "Database connection pool events.", "pool=\"" + pool + "\",event=\"reap\"")),
+      retired(Metrics::instance().counter("zcash_api_db_pool_events_total", "Database connection pool events.", "pool=\"" + pool + "\",event=\"retire\"")),
+      reconnects(Metrics::instance().counter("zcash_api_db_pool_events_total", "Database connection pool events.", "pool=\"" + pool + "\",event=\"reconnect\"")),
+      connect_failures(Metrics::instance().counter("zcash_api_db_pool_events_total", "Database connection pool events.", "pool=\"" + pool + "\",event=\"connect_failure\"")),
+      validation_failures(Metrics::instance().counter("zcash_api_db_pool_events_total", "Database connection pool events.", "pool=\"" + pool + "\",event=\"validation_failure\"")),
+      checkout_timeouts(Metrics::instance().counter("zcash_api_db_pool_events_total", "Database connection pool events.", "pool=\"" + pool + "\",event=\"checkout_timeout\""))
+{
+}
+
+ConnectionPool::ConnectionPool(std::string connection_string_, Options options_)
+    : connection_string(std::move(connection_string_)), options(std::move(options_)), instruments(options.name)
+{
+    options.max_size = std::max(options.max_size, options.min_size);
+}
+
+ConnectionPool::~ConnectionPool() noexcept
+{
+    shutdown();
+}
+
+void ConnectionPool::open()
+{
+    const size_t minReady = std::min(std::max<size_t>(options.min_ready, 1), std::max<size_t>(options.min_size, 1));
+    const size_t initial = std::max(options.min_size, minReady);
+
+    {
+        std::lock_guard<std::mutex> lock(pool_mutex);
+        opening = initial;
+    }
+
+    // Each handshake is mostly network round trips, so opening them side by side costs about one.
+    for (size_t i = 0; i < initial; ++i)
+    {
+        openers.emplace_back(&ConnectionPool::openOne, this);
+    }
+    maintainer = std::thread(&ConnectionPool::maintain, this);
+
+    std::unique_lock<std::mutex> lock(pool_mutex);
+    connection_available.wait(lock, [&]
+                              { return opened >= minReady || opening == 0; });
+
+    if (opened < minReady)
+    {
+        throw std::runtime_error("Opened " + std::to_string(opened) + " of the " + std::to_string(minReady) +
+                                 " required database connections: " + last_open_error);
+    }
+
+    CROW_LOG_INFO << "Database pool " << options.name << " ready with " << opened << " of " << initial << " connections.";
+}
+
+void ConnectionPool::openOne()
+{
+    try
+    {
+        auto conn = connect();
+
+        {
+            std::lock_guard<std::mutex> lock(pool_mutex);
+            --opening;
+            ++opened;
+            if (!stopping)
+            {
+                idle.push_back(std::move(conn));
+            }
+            publishLocked();
+        }
+        connection_available.notify_all();
+    }
+    catch (const std::exception &e)
+    {
+        {
+            std::lock_guard<std::mutex> lock(pool_mutex);
+            --opening;
+            last_open_error = e.what();
+            instruments.connect_failures.increment();
+
+            // The maintenance thread retries it like any other broken connection.
+            discardLocked(nullptr);
+        }
+        connection_available.notify_all();
+
+        CROW_LOG_WARNING << "Opening a database connection failed: " << e.what();
+    }
+}
+
+std::unique_ptr<PooledConnection> ConnectionPool::acquire()
+{
+    const auto requested = clock::now();
+    const auto deadline = requested + options.checkout_timeout;
+    std::unique_lock<std::mutex> lock(pool_mutex);
+
+    while (true)
+    {
+        if (idle.empty())
+        {
+            ++waiters;
+            requestGrowthLocked();
+            publishLocked();
+
+            const bool available = connection_available.wait_until(lock, deadline, [this]
+                                                                   { return !idle.empty() || stopping; });
+            --waiters;
+
+            if (stopping)
+            {
+                throw std::runtime_error("Database connection pool is shut down.");
+            }
+
+            if (!available)
+            {
+                ++checkout_timeouts;
+                instruments.checkout_timeouts.increment();
+                publishLocked();
+                throw std::runtime_error("Timed out waiting for a database connection.");
+            }
+        }
+
+        auto conn = std::move(idle.front());
+        idle.pop_front();
+
+        if (clock::now() >= conn->retire_at)
+        {
+            ++retired;
+            instruments.retired.increment();
+            discardLocked(std::move(conn));
+            continue;
+        }
+
+        // Connections that sat idle may have been dropped by a failover or an idle timeout upstream.
+        if (clock::now() - conn->last_used >= options.validation_interval)
+        {
+            ++pinging;
+            lock.unlock();
+            const bool alive = ping(*conn);
+            lock.lock();
+            --pinging;
+
+            if (!alive)
+            {
+                ++validation_failures;
+                instruments.validation_failures.increment();
+                discardLocked(std::move(conn));
+                continue;
+            }
+        }
+
+        ++in_use;
+        ++checkouts;
+
+        conn->checked_out = clock::now();
+        conn->last_used = conn->checked_out;
+        total_checkout_wait += conn->checked_out - requested;
+        publishLocked();
+
+        return conn;
+    }
+}
+
+void ConnectionPool::release(std::unique_ptr<PooledConnection> conn, bool broken)
+{
+    if (!conn)
+    {
+        return;
+    }
+
+    broken = broken || !conn->connection || !conn->connection->is_open();
+
+    {
+        std::lock_guard<std::mutex> lock(pool_mutex);
+        conn->last_used = clock::now();
+        total_hold += conn->last_used - conn->checked_out;
+        ++releases;
+        --in_use;
+
+        if (stopping)
+        {
+            publishLocked();
+            return;
+        }
+
+        if (broken || conn->last_used >= conn->retire_at)
+        {
+            if (!broken)
+            {
+                ++retired;
+                instruments.retired.increment();
+            }
+
+            discardLocked(std::move(conn));
+            publishLocked();
+            return;
+        }
+
+        idle.push_back(std::move(conn));
+        publishLocked();
+    }
+    connection_available.notify_one();
+}
+
+void ConnectionPool::shutdown()
+{
+    {
+        std::lock_guard<std::mutex> lock(pool_mutex);
+        stopping = true;
+    }
+    maintenance_wakeup.notify_all();
+    connection_available.notify_all();
+
+    if (maintainer.joinable())
+    {
+        maintainer.join();
+    }
+    for (std::thread &opener : openers)
+    {
+        if (opener.joinable())
+        {
+            opener.join();
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(pool_mutex);
+    idle.clear();
+}
+
+PoolStats ConnectionPool::stats() const
+{
+    std::lock_guard<std::mutex> lock(pool_mutex);
+
+    size_t healthy = in_use + pinging;
+    for (const auto &conn : idle)
+    {
+        if (conn->connection && conn->connection->is_open())
+        {
+            ++healthy;
+        }
+    }
+
+    auto averageMs = [](clock::duration total, uint64_t count)
+    {
+        return count == 0 ? 0.0 : std::chrono::duration<double, std::milli>(total).count() / count;
+    };
+
+    PoolStats stats;
+    stats.size = idle.size() + in_use + pinging;
+    stats.min_size = options.min_size;
+    stats.max_size = options.max_size;
+    stats.idle = idle.size();
+    stats.in_use = in_use;
+    stats.waiters = waiters;
+    stats.healthy = healthy;
+    stats.opening = opening;
+    stats.reconnecting = missing;
+    stats.growing = grow_pending;
+    stats.checkouts = checkouts;
+    stats.checkout_timeouts = checkout_timeouts;
+    stats.reconnects = reconnects;
+    stats.validation_failures = validation_failures;
+    stats.grown = grown;
+    stats.reaped = reaped;
+    stats.retired = retired;
+    stats.average_checkout_wait_ms = averageMs(total_checkout_wait, checkouts);
+    stats.average_hold_ms = averageMs(total_hold, releases);
+    return stats;
+}
+
+std::unique_ptr<PooledConnection> ConnectionPool::connect()
+{
+    auto conn = std::make_unique<PooledConnection>(std::make_unique<pqxx::connection>(connection_string));
+    conn->pool = this;
+
+    if (options.max_lifetime.count() > 0)
+    {
+        // Up to 10% jitter so connections opened together don't all retire together.
+        thread_local std::minstd_rand jitterSource{std::random_device{}()};
+        const auto maxJitter = std::max<std::chrono::milliseconds::rep>(options.max_lifetime.count() / 10, 1);
+        const std::chrono::milliseconds jitter(std::uniform_int_distribution<std::chrono::milliseconds::rep>(0, maxJitter)(jitterSource));
+        conn->retire_at = conn->created + options.max_lifetime - jitter;
+    }
+
+    return conn;
+}
+
+bool ConnectionPool::ping(PooledConnection &conn) noexcept
+{
+    try
+    {
+        if (!conn.connection || !conn.connection->is_open())
+        {
+            return false;
+        }
+
+        pqxx::nontransaction tx(*conn.connection);
+        tx.exec("SELECT 1");
+        return true;
+    }
+    catch (const std::exception &)
+    {
+        return false;
+    }
+}
+
+size_t ConnectionPool::slotsLocked() const noexcept
+{
+    return idle.size() + in_use + pinging + opening + missing + grow_pending;
+}
+
+void ConnectionPool::discardLocked(std::unique_ptr<PooledConnection> conn)
+{
+    conn.reset();
+
+    if (slotsLocked() < options.min_size)
+    {
+        ++missing;
+        scheduleOpenLocked();
+    }
+    else
+    {
+        requestGrowthLocked();
+    }
+}
+
+void ConnectionPool::requestGrowthLocked()
+{
+    // Each waiter asks for at most one connection, and only when nothing else is on its way.
+    if (waiters > opening + missing + grow_pending && slotsLocked() < options.max_size)
+    {
+        ++grow_pending;
+        scheduleOpenLocked();
+    }
+}
+
+void ConnectionPool::scheduleOpenLocked()
+{
+    // The first scheduled open runs straight away unless a recent failure is still backing off.
+    if (missing + grow_pending == 1)
+    {
+        next_reconnect = std::max(next_reconnect, clock::now());
+    }
+    maintenance_wakeup.notify_one();
+}
+
+void ConnectionPool::publishLocked()
+{
+    instruments.idle.set(static_cast<double>(idle.size()));
+    instruments.in_use.set(static_cast<double>(in_use));
+    instruments.waiters.set(static_cast<double>(waiters));
+    instruments.pending.set(static_cast<double>(opening + missing + grow_pending));
+}
+
+void ConnectionPool::maintain()
+{
+    std::unique_lock<std::mutex> lock(pool_mutex);
+
+    std::chrono::milliseconds sweepPeriod = options.keepalive_interval;
+    if (options.idle_timeout.count() > 0)
+    {
+        sweepPeriod = std::min(sweepPeriod, options.idle_timeout);
+    }
+    sweepPeriod = std::max(sweepPeriod / 2, std::chrono::milliseconds(1));
+
+    auto nextSweep = clock::now() + sweepPeriod;
+
+    while (!stopping)
+    {
+        auto openDue = [this]
+        { return missing + grow_pending > 0 && clock::now() >= next_reconnect; };
+
+        auto wake = nextSweep;
+        if (missing + grow_pending > 0)
+        {
+            wake = std::min(wake, next_reconnect);
+        }
+
+        maintenance_wakeup.wait_until(lock, wake, [&]
+                                      { return stopping || openDue(); });
+        if (stopping)
+        {
+            break;
+        }
+
+        const bool open = openDue();
+        const bool sweep = clock::now() >= nextSweep;
+        lock.unlock();
+
+        if (open)
+        {
+            openScheduled();
+        }
+        if (sweep)
+        {
+            sweepIdle();
+            nextSweep = clock::now() + sweepPeriod;
+        }
+
+        lock.lock();
+    }
+}
+
+void ConnectionPool::openScheduled()
+{
+    try
+    {
+        auto conn = connect();
+
+        {
+            std::lock_guard<std::mutex> lock(pool_mutex);
+            if (stopping)
+            {
+                return;
+            }
+
+            if (missing > 0)
+            {
+                --missing;
+                ++reconnects;
+                instruments.reconnects.increment();
+            }
+            else if (grow_pending > 0)
+            {
+                --grow_pending;
+                ++grown;
+                instruments.grown.increment();
+            }
+
+            backoff = std::chrono::milliseconds(0);
+            idle.push_back(std::move(conn));
+            publishLocked();
+        }
+        connection_available.notify_one();
+    }
+    catch (const std::exception &e)
+    {
+        std::chrono::milliseconds delay;
+        {
+            std::lock_guard<std::mutex> lock(pool_mutex);
+            instruments.connect_failures.increment();
+
+            // Growth nobody is waiting for any more isn't worth retrying.
+            grow_pending = std::min(grow_pending, waiters);
+
+            backoff = backoff.count() == 0 ? options.backoff_initial : std::min(backoff * 2, options.backoff_max);
+            next_reconnect = clock::now() + backoff;
+            delay = backoff;
+            publishLocked();
+        }
+
+        CROW_LOG_WARNING << "Database reconnect failed, retrying in " << delay.count() << " ms: " << e.what();
+    }
+}
+
+void ConnectionPool::sweepIdle()
+{
+    const auto now = clock::now();
+
+    {
+        std::lock_guard<std::mutex> lock(pool_mutex);
+
+        for (auto it = idle.begin(); it != idle.end();)
+        {
+            if (now >= (*it)->retire_at)
+            {
+                auto conn = std::move(*it);
+                it = idle.erase(it);
+                ++retired;
+                instruments.retired.increment();
+                discardLocked(std::move(conn));
+            }
+            else
+            {
+                ++it;
+            }
+        }
+
+        // Idle connections are appended as they are released, so the front is always the stalest.
+        if (options.idle_timeout.count() > 0)
+        {
+            while (!idle.empty() && slotsLocked() > options.min_size && now - idle.front()->last_used >= options.idle_timeout)
+            {
+                idle.pop_front();
+                ++reaped;
+                instruments.reaped.increment();
+            }
+        }
+
+        publishLocked();
+    }
+
+    const auto staleBefore = now - options.keepalive_interval;
+    while (true)
+    {
+        std::unique_ptr<PooledConnection> conn;
+        {
+            std::lock_guard<std::mutex> lock(pool_mutex);
+            if (stopping || idle.empty() || idle.front()->last_used > staleBefore)
+            {
+                return;
+            }
+
+            conn = std::move(idle.front());
+            idle.pop_front();
+            ++pinging;
+        }
+
+        const bool alive = ping(*conn);
+
+        {
+            std::lock_guard<std::mutex> lock(pool_mutex);
+            --pinging;
+
+            if (!alive)
+            {
+                ++validation_failures;
+                instruments.validation_failures.increment();
+                discardLocked(std::move(conn));
+                publishLocked();
+                continue;
+            }
+
+            conn->last_used = clock::now();
+            idle.push_back(std::move(conn));
+        }
+        connection_available.notify_one();
+    }
+}
+
+CopyConnectionPool::CopyConnectionPool(size_t max_size_, std::chrono::milliseconds checkout_timeout_)
+    : max_size(std::max<size_t>(max_size_, 1)), checkout_timeout(checkout_timeout_),
+      idle_gauge(Metrics::instance().gauge("zcash_api_db_pool_connections", "Pooled database connections by state.", "pool=\"export\",state=\"idle\"")),
+      in_use_gauge(Metrics::instance().gauge("zcash_api_db_pool_connections", "Pooled database connections by state.", "pool=\"export\",state=\"in_use\""))
+{
+}
+
+CopyConnectionPool::Handle CopyConnectionPool::acquire(const std::string &connection_string)
+{
+    // Closing can block on the network, so connections given up are closed outside the lock.
+    Handle retired(nullptr, &PQfinish);
+    {
+        std::unique_lock<std::mutex> lock(pool_mutex);
+        const bool ready = connection_available.wait_for(lock, checkout_timeout, [this]
+                                                         { return !idle.empty() || open_count < max_size; });
+        if (!ready)
+        {
+            throw std::runtime_error("No export connection freed up within the checkout timeout.");
+        }
+
+        auto match = std::find_if(idle.begin(), idle.end(), [&](const auto &entry)
+                                  { return entry.first == connection_string; });
+        if (match != idle.end())
+        {
+            Handle conn = std::move(match->second);
+            idle.erase(match);
+            if (PQstatus(conn.get()) == CONNECTION_OK)
+            {
+                publishLocked();
+                return conn;
+            }
+            retired = std::move(conn);
+            --open_count;
+        }
+        else if (open_count >= max_size)
+        {
+            // Only idle connections to other targets are left, trade the oldest for one to this target.
+            retired = std::move(idle.front().second);
+            idle.pop_front();
+            --open_count;
+        }
+
+        ++open_count;
+        publishLocked();
+    }
+
+    Handle conn(PQconnectdb(connection_string.c_str()), &PQfinish);
+    if (PQstatus(conn.get()) != CONNECTION_OK)
+    {
+        const std::string error = PQerrorMessage(conn.get());
+        release(connection_string, std::move(conn), true);
+        throw std::runtime_error("Export connection failed: " + error);
+    }
+    return conn;
+}
+
+void CopyConnectionPool::release(const std::string &connection_string, Handle conn, bool broken)
+{
+    broken = broken || !conn || PQstatus(conn.get()) != CONNECTION_OK || PQtransactionStatus(conn.get()) != PQTRANS_IDLE;
+
+    {
+        std::lock_guard<std::mutex> lock(pool_mutex);
+        if (broken)
+        {
+            --open_count;
+        }
+        else
+        {
+            idle.emplace_back(connection_string, std::move(conn));
+        }
+        publishLocked();
+    }
+    connection_available.notify_one();
+    conn.reset();
+}
+
+void CopyConnectionPool::publishLocked()
+{
+    idle_gauge.set(static_cast<double>(idle.size()));
+    in_use_gauge.set(static_cast<double>(open_count - idle.size()));
+}
+
+#endif // CONNECTION_POOL_CPP
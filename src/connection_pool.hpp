@@ -0,0 +1,315 @@
+#ifndef CONNECTION_POOL_HPP
+#define CONNECTION_POOL_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <libpq-fe.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <pqxx/pqxx>
+#include "metrics.hpp"
+
+class ConnectionPool;
+
+/**
+ * @brief A database connection owned by a ConnectionPool, with the bookkeeping the pool needs.
+ */
+struct PooledConnection
+{
+    using clock = std::chrono::steady_clock;
+
+    explicit PooledConnection(std::unique_ptr<pqxx::connection> connection_)
+        : connection(std::move(connection_)), created(clock::now()), last_used(created), retire_at(clock::time_point::max()) {}
+
+    std::unique_ptr<pqxx::connection> connection;
+    clock::time_point created;        ///< When the connection was established.
+    clock::time_point last_used;      ///< When the connection was last returned to the pool or pinged.
+    clock::time_point checked_out;    ///< When the connection was last checked out.
+    clock::time_point retire_at;      ///< When the connection reaches its maximum lifetime.
+    ConnectionPool *pool{nullptr};    ///< Pool the connection must be released to.
+};
+
+/**
+ * @brief Point in time snapshot of a pool's state.
+ */
+struct PoolStats
+{
+    size_t size{0};                      ///< Open connections, idle or in use.
+    size_t min_size{0};                  ///< Connections the pool keeps open when quiet.
+    size_t max_size{0};                  ///< Connections the pool may grow to under load.
+    size_t idle{0};                      ///< Connections waiting in the pool.
+    size_t in_use{0};                    ///< Connections checked out.
+    size_t waiters{0};                   ///< Callers blocked waiting for a connection.
+    size_t healthy{0};                   ///< Connections believed usable.
+    size_t opening{0};                   ///< Connections still being established at startup.
+    size_t reconnecting{0};              ///< Broken or retired connections waiting to be replaced.
+    size_t growing{0};                   ///< Extra connections being opened for waiters.
+    uint64_t checkouts{0};               ///< Total successful checkouts.
+    uint64_t checkout_timeouts{0};       ///< Checkouts that gave up waiting.
+    uint64_t reconnects{0};              ///< Connections replaced after breaking or retiring.
+    uint64_t validation_failures{0};     ///< Connections found broken by a checkout validation or keepalive ping.
+    uint64_t grown{0};                   ///< Connections opened above the minimum because callers were waiting.
+    uint64_t reaped{0};                  ///< Connections closed after idling past the idle timeout.
+    uint64_t retired{0};                 ///< Connections closed after reaching their maximum lifetime.
+    double average_checkout_wait_ms{0.0}; ///< Mean time spent waiting to check out.
+    double average_hold_ms{0.0};         ///< Mean time connections stay checked out.
+};
+
+/**
+ * @brief Elastic pool of PostgreSQL connections. Callers block until a connection is free
+ * or the checkout timeout passes.
+ *
+ * The pool keeps min_size connections open and grows towards max_size while callers are waiting.
+ * Connections above the minimum are closed once they idle past the idle timeout, and every
+ * connection is retired after its maximum lifetime so load rebalances after a failover.
+ *
+ * Connections are established concurrently. open() returns once the minimum number are ready
+ * and the rest keep connecting in the background.
+ *
+ * Connections idle for longer than the validation interval are pinged before being handed out,
+ * and a background thread pings connections left idle past the keepalive interval. Broken
+ * connections are dropped and reopened in the background with exponential backoff.
+ */
+class ConnectionPool
+{
+public:
+    struct Options
+    {
+        std::string name{"primary"};                     ///< Value of the pool label on the pool's metrics.
+        size_t min_size{10};
+        size_t max_size{10};
+        size_t min_ready{1};                             ///< Connections open() waits for before returning.
+        std::chrono::milliseconds checkout_timeout{5000};    ///< Longest acquire() waits for a free connection.
+        std::chrono::milliseconds validation_interval{5000}; ///< Idle time after which a checkout pings first.
+        std::chrono::milliseconds keepalive_interval{30000}; ///< Idle time after which the background thread pings.
+        std::chrono::milliseconds idle_timeout{0};       ///< Idle time after which connections above min_size close. Zero disables.
+        std::chrono::milliseconds max_lifetime{0};       ///< Age after which connections are retired. Zero disables.
+        std::chrono::milliseconds backoff_initial{100};  ///< First delay between failed reconnect attempts.
+        std::chrono::milliseconds backoff_max{30000};    ///< Cap on the delay between failed reconnect attempts.
+    };
+
+    /**
+     * @brief Constructor for the ConnectionPool class.
+     * @param connection_string libpq connection string.
+     * @param options Pool sizing and health check tuning.
+     */
+    ConnectionPool(std::string connection_string, Options options);
+
+    /**
+     * @brief Destructor for the ConnectionPool class. Stops the maintenance thread.
+     */
+    ~ConnectionPool() noexcept;
+
+    /**
+     * @brief Start opening min_size connections concurrently and start the maintenance thread.
+     * Blocks until min_ready connections are established.
+     * @throws std::runtime_error if every attempt finished with fewer than min_ready connections.
+     */
+    void open();
+
+    /**
+     * @brief Check out a connection, waiting for one to be released or opened if none are idle.
+     * @return A validated connection owned by the caller until release().
+     * @throws std::runtime_error if no usable connection frees up within the checkout timeout.
+     */
+    std::unique_ptr<PooledConnection> acquire();
+
+    /**
+     * @brief Return a checked out connection to the pool.
+     * @param conn Connection obtained from acquire().
+     * @param broken True if the caller saw the connection fail. Closed connections are treated as broken too.
+     */
+    void release(std::unique_ptr<PooledConnection> conn, bool broken = false);
+
+    /**
+     * @brief Stop the maintenance thread and close every idle connection.
+     */
+    void shutdown();
+
+    /**
+     * @brief Take a snapshot of the pool's state. Never touches the network.
+     * @return Pool statistics.
+     */
+    PoolStats stats() const;
+
+    /**
+     * @brief Get the connection string the pool connects with.
+     * @return libpq connection string.
+     */
+    const std::string &connectionString() const noexcept { return connection_string; }
+
+private:
+    using clock = std::chrono::steady_clock;
+
+    /**
+     * @brief Metrics describing one pool, labelled with its name.
+     */
+    struct Instruments
+    {
+        explicit Instruments(const std::string &pool);
+
+        Gauge &idle;
+        Gauge &in_use;
+        Gauge &waiters;
+        Gauge &pending;
+        Counter &grown;
+        Counter &reaped;
+        Counter &retired;
+        Counter &reconnects;
+        Counter &connect_failures;
+        Counter &validation_failures;
+        Counter &checkout_timeouts;
+    };
+
+    std::string connection_string;
+    Options options;
+    Instruments instruments;
+
+    mutable std::mutex pool_mutex;
+    std::condition_variable connection_available;
+    std::condition_variable maintenance_wakeup;
+    std::deque<std::unique_ptr<PooledConnection>> idle;
+    size_t in_use{0};
+    size_t pinging{0};
+    size_t missing{0};
+    size_t grow_pending{0};
+    size_t opening{0};
+    size_t opened{0};
+    std::string last_open_error;
+    size_t waiters{0};
+    bool stopping{false};
+    std::chrono::milliseconds backoff{0};
+    clock::time_point next_reconnect{};
+    std::thread maintainer;
+    std::vector<std::thread> openers;
+
+    uint64_t checkouts{0};
+    uint64_t checkout_timeouts{0};
+    uint64_t reconnects{0};
+    uint64_t validation_failures{0};
+    uint64_t grown{0};
+    uint64_t reaped{0};
+    uint64_t retired{0};
+    clock::duration total_checkout_wait{};
+    clock::duration total_hold{};
+    uint64_t releases{0};
+
+    /**
+     * @brief Open a connection, stamping it with a jittered retirement time.
+     * @return Newly established connection.
+     */
+    std::unique_ptr<PooledConnection> connect();
+
+    /**
+     * @brief Run a trivial query to check a connection still works.
+     * @param conn Connection not visible to other threads.
+     * @return True if the query succeeded.
+     */
+    static bool ping(PooledConnection &conn) noexcept;
+
+    /**
+     * @brief Connections open, being opened or scheduled to open. Caller must hold pool_mutex.
+     */
+    size_t slotsLocked() const noexcept;
+
+    /**
+     * @brief Forget a connection that left the pool and replace it if the pool fell below min_size
+     * or callers are waiting. Caller must hold pool_mutex.
+     * @param conn Connection to close, or nullptr if it never opened.
+     */
+    void discardLocked(std::unique_ptr<PooledConnection> conn);
+
+    /**
+     * @brief Schedule one more connection if callers are waiting and the pool is below max_size.
+     * Caller must hold pool_mutex.
+     */
+    void requestGrowthLocked();
+
+    /**
+     * @brief Wake the maintenance thread to open scheduled connections. Caller must hold pool_mutex.
+     */
+    void scheduleOpenLocked();
+
+    /**
+     * @brief Push the pool's current state to its gauges. Caller must hold pool_mutex.
+     */
+    void publishLocked();
+
+    /**
+     * @brief Opener thread body: establishes one of the pool's initial connections.
+     */
+    void openOne();
+
+    /**
+     * @brief Maintenance thread body: opens scheduled connections and sweeps idle ones.
+     */
+    void maintain();
+
+    /**
+     * @brief Open one scheduled connection, backing off on failure.
+     */
+    void openScheduled();
+
+    /**
+     * @brief Retire expired idle connections, reap those idle past the idle timeout and
+     * ping those unused for longer than the keepalive interval.
+     */
+    void sweepIdle();
+};
+
+/**
+ * @brief Bounded pool of raw libpq connections for COPY exports, which libpqxx can't stream without parsing rows.
+ *
+ * At most max_size connections are open across all targets. Idle connections are reused for the same
+ * connection string, and an idle connection to another target is closed to make room for a new one.
+ */
+class CopyConnectionPool
+{
+public:
+    using Handle = std::unique_ptr<PGconn, decltype(&PQfinish)>;
+
+    /**
+     * @brief Constructor for the CopyConnectionPool class.
+     * @param max_size Most connections open at once.
+     * @param checkout_timeout Longest acquire() waits for a connection to free up.
+     */
+    CopyConnectionPool(size_t max_size, std::chrono::milliseconds checkout_timeout);
+
+    /**
+     * @brief Check out a connection to a target, reusing an idle one or opening a new one.
+     * @param connection_string libpq connection string of the target.
+     * @return An open connection owned by the caller until release().
+     * @throws std::runtime_error if no connection frees up within the checkout timeout or connecting fails.
+     */
+    Handle acquire(const std::string &connection_string);
+
+    /**
+     * @brief Return a checked out connection to the pool.
+     * @param connection_string Connection string it was acquired for.
+     * @param conn Connection obtained from acquire().
+     * @param broken True if the caller saw the connection fail. Connections not idle on return are closed too.
+     */
+    void release(const std::string &connection_string, Handle conn, bool broken = false);
+
+private:
+    const size_t max_size;
+    const std::chrono::milliseconds checkout_timeout;
+    std::mutex pool_mutex;
+    std::condition_variable connection_available;
+    size_t open_count{0};
+    std::deque<std::pair<std::string, Handle>> idle;
+    Gauge &idle_gauge;
+    Gauge &in_use_gauge;
+
+    /**
+     * @brief Push the pool's current state to its gauges. Caller must hold pool_mutex.
+     */
+    void publishLocked();
+};
+
+#endif // CONNECTION_POOL_HPP
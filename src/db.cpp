@@ -1,30 +1,380 @@
 #include "db.hpp"
 #include <pqxx/pqxx>
 #include <iostream>
+#include <sstream>
 #include "parser.hpp"
 #include "chain_utils.hpp"
+#include "trace.hpp"
+#include <libpq-fe.h>
+#include <array>
+#include <condition_variable>
+#include <exception>
+#include <utility>
 
 #ifndef DB_CPP
 #define DB_CPP
 
-const uint8_t Database::connection_pool_size = 10;
+namespace {
 
-void Database::connect(const std::string &dbname, const std::string &user, const std::string &password, const std::string &host, std::string port)
+/**
+ * Runs a statement, recording its execution time, name and row count on the request's trace.
+ */
+template <typename Run>
+pqxx::result tracedExec(const char *statement, Run &&run)
+{
+    TraceScope scope(TracePhase::Query);
+    pqxx::result result = run();
+    RequestTrace::recordStatement(statement, result.size());
+    return result;
+}
+
+}
+
+/**
+ * @brief Shared by a hedged read and its hedge. The hedge may outlive the request that started it.
+ */
+struct HedgeState
 {
+    std::function<pqxx::result(transaction &)> run;
+    std::optional<QueryContext::clock::time_point> deadline; ///< Deadline of the request that started the read.
+    std::mutex mutex;
+    std::condition_variable settled;
+    std::optional<pqxx::result> result; ///< The hedge's answer, if it won.
+    std::exception_ptr error;           ///< The hedge's failure, if it failed.
+    int winner{-1};
+    bool read_done{false};     ///< The read has returned, so a hedge that hasn't started is no longer needed.
+    bool hedge_running{false};
+    std::array<pqxx::connection *, 2> running{}; ///< Connections with a query in flight, cleared before they are released.
+    std::array<const ConnectionPool *, 2> pools{};
+};
+
+namespace {
+
+/**
+ * Runs one attempt of a hedged read on a transaction, registering its connection so the winner can cancel it.
+ */
+pqxx::result runHedgeAttempt(HedgeState &state, size_t attempt, ManagedConnection &conn, transaction &tx)
+{
+    {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        if (state.winner >= 0)
+        {
+            throw std::runtime_error("Hedged read already answered.");
+        }
+        state.pools[attempt] = conn.pool();
+        state.running[attempt] = &*conn;
+    }
+
+    // Past the query a cancel could only hit the rollback or the connection's next user, so it is unregistered first.
     try
     {
-        const std::string connection_string =
-            "dbname=" + dbname +
-            " user=" + user +
-            " password=" + password +
-            " host=/cloudsql/" + host +
-            " port=" + port;
+        pqxx::result result = state.run(tx);
+        std::lock_guard<std::mutex> lock(state.mutex);
+        state.running[attempt] = nullptr;
+        return result;
+    }
+    catch (...)
+    {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        state.running[attempt] = nullptr;
+        throw;
+    }
+}
+
+/**
+ * Cancels the attempt that lost a hedged read so it stops using its pool. Called with the state's mutex held.
+ */
+void cancelHedgeLoser(HedgeState &state, size_t winner, const char *statement)
+{
+    pqxx::connection *loser = state.running[1 - winner];
+    if (loser == nullptr)
+    {
+        return;
+    }
+
+    try
+    {
+        loser->cancel_query();
+    }
+    catch (const std::exception &e)
+    {
+        CROW_LOG_WARNING << "Cancelling a hedged " << statement << " failed: " << e.what();
+    }
+    state.running[1 - winner] = nullptr;
+}
+
+}
+
+template <typename Run>
+pqxx::result Database::tracedRead(ManagedConnection &conn, const char *statement, Run &&run)
+{
+    for (uint32_t attempt = 1;; ++attempt)
+    {
+        try
+        {
+            transaction tx(*conn);
+            if (const QueryContext *context = QueryContext::current())
+            {
+                QueryContext::applyStatementTimeout(tx, context->deadline());
+            }
+
+            QueryWatchdog::Watch watch(queryWatchdog.get(), *conn);
+            return tracedExec(statement, [&]
+                { return run(tx); });
+        }
+        catch (const pqxx::broken_connection &e)
+        {
+            if (attempt >= read_retry_attempts)
+            {
+                throw;
+            }
+
+            CROW_LOG_WARNING << "Connection broke during " << statement << ", retrying on a fresh connection: " << e.what();
+            conn.replace();
+        }
+    }
+}
+
+pqxx::result Database::hedgedRead(const char *statement, std::function<pqxx::result(transaction &)> run)
+{
+    if (!hedger || !hedger->enabled() || !replicas)
+    {
+        ManagedConnection conn(*this);
+        return tracedRead(conn, statement, run);
+    }
+
+    const auto started = std::chrono::steady_clock::now();
+    const std::optional<std::chrono::microseconds> delay = hedger->begin(statement);
+
+    auto state = std::make_shared<HedgeState>();
+    state->run = std::move(run);
+    if (const QueryContext *context = QueryContext::current())
+    {
+        state->deadline = context->deadline();
+    }
+
+    // The read runs on this thread, only its hedge goes to the executor, to start if the read outlasts the delay.
+    // A full executor costs the read its hedge, never its start.
+    ManagedConnection conn(*this);
+    state->pools[0] = conn.pool();
+    if (delay.has_value())
+    {
+        hedgeExecutor->submit([this, state, statement]
+                              { runHedge(state, statement); },
+                              started + delay.value());
+    }
 
-        for (size_t i = 0; i < Database::connection_pool_size; ++i)
+    std::optional<pqxx::result> result;
+    std::exception_ptr error;
+    try
+    {
+        result = tracedRead(conn, statement, [&state, &conn](transaction &tx)
+                            { return runHedgeAttempt(*state, 0, conn, tx); });
+    }
+    catch (...)
+    {
+        error = std::current_exception();
+    }
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->read_done = true;
+    if (result.has_value() && state->winner < 0)
+    {
+        state->winner = 0;
+        cancelHedgeLoser(*state, 0, statement);
+    }
+
+    // If the read failed, a hedge already running may still answer.
+    state->settled.wait(lock, [&state]
+                        { return state->winner >= 0 || !state->hedge_running; });
+    if (state->winner < 0)
+    {
+        std::rethrow_exception(error);
+    }
+
+    const bool hedgeWon = state->winner == 1;
+    pqxx::result answer = hedgeWon ? state->result.value() : result.value();
+    lock.unlock();
+
+    const auto elapsed = std::chrono::steady_clock::now() - started;
+    hedger->record(statement, std::chrono::duration_cast<std::chrono::microseconds>(elapsed));
+    if (hedgeWon)
+    {
+        // The read was cancelled before it could record itself.
+        hedger->hedgeWon();
+        RequestTrace::recordStatement(statement, answer.size());
+    }
+
+    return answer;
+}
+
+void Database::runHedge(std::shared_ptr<HedgeState> state, const char *statement)
+{
+    const ConnectionPool *slow = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        if (state->read_done)
+        {
+            return;
+        }
+        slow = state->pools[0];
+        state->hedge_running = true;
+    }
+
+    std::optional<pqxx::result> result;
+    std::exception_ptr error;
+
+    // Hedge on a different pool than the slow read, preferring another fresh replica over the primary.
+    ConnectionPool *replica = replicas->choose(true, slow);
+    if ((replica != nullptr || slow != connectionPool.get()) && hedger->tryHedge())
+    {
+        try
+        {
+            // The hedge may outlive the request, so it is bounded by the request's deadline rather than its client.
+            std::optional<QueryContext> context;
+            if (state->deadline.has_value())
+            {
+                context.emplace(std::chrono::milliseconds(QueryContext::remainingMs(state->deadline.value())), nullptr);
+            }
+
+            // A retry after a broken connection picks a pool again.
+            ManagedConnection conn(*this, [this, slow, &replica]() -> std::unique_ptr<PooledConnection>
+                                   {
+                ConnectionPool *pool = std::exchange(replica, nullptr);
+                if (pool == nullptr)
+                {
+                    pool = replicas->choose(true, slow);
+                }
+                if (pool == nullptr)
+                {
+                    return acquirePrimary();
+                }
+
+                try
+                {
+                    return pool->acquire();
+                }
+                catch (const std::exception &)
+                {
+                    replicas->finished(pool, true);
+                    throw;
+                } });
+            result = tracedRead(conn, statement, [&state, &conn](transaction &tx)
+                                { return runHedgeAttempt(*state, 1, conn, tx); });
+        }
+        catch (...)
+        {
+            error = std::current_exception();
+        }
+    }
+
+    // Chosen but never checked out.
+    if (replica != nullptr)
+    {
+        replicas->finished(replica, false);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        state->hedge_running = false;
+        if (result.has_value() && state->winner < 0)
+        {
+            state->winner = 1;
+            state->result = std::move(result);
+            cancelHedgeLoser(*state, 1, statement);
+        }
+        else if (error)
+        {
+            state->error = error;
+        }
+    }
+    state->settled.notify_all();
+}
+
+const std::vector<std::string> Database::csv_export_tables = {"blocks", "transactions", "transparent_inputs", "transparent_outputs"};
+
+void Database::connect(const std::string &dbname, const std::string &user, const std::string &password, const std::string &host, std::string port)
+{
+    try
+    {
+        auto connectionStringFor = [&](const std::string &instance)
         {
-            auto conn = std::make_unique<pqxx::connection>(connection_string);
-            connectionPool.push(std::move(conn));
+            return "dbname=" + dbname +
+                   " user=" + user +
+                   " password=" + password +
+                   " host=/cloudsql/" + instance +
+                   " port=" + port;
+        };
+        connection_string = connectionStringFor(host);
+
+        read_retry_attempts = std::max<uint32_t>(1, static_cast<uint32_t>(std::stoul(Config::getReadRetryAttempts())));
+
+        ConnectionPool::Options poolOptions;
+        poolOptions.name = "primary";
+        poolOptions.min_size = std::stoul(Config::getPoolMinSize());
+        poolOptions.max_size = std::stoul(Config::getPoolMaxSize());
+        poolOptions.min_ready = std::stoul(Config::getPoolMinReady());
+        poolOptions.checkout_timeout = std::chrono::milliseconds(std::stoul(Config::getPoolCheckoutTimeoutMs()));
+        poolOptions.validation_interval = std::chrono::milliseconds(std::stoul(Config::getPoolValidationIntervalMs()));
+        poolOptions.keepalive_interval = std::chrono::milliseconds(std::stoul(Config::getPoolKeepaliveIntervalMs()));
+        poolOptions.idle_timeout = std::chrono::milliseconds(std::stoul(Config::getPoolIdleTimeoutMs()));
+        poolOptions.max_lifetime = std::chrono::milliseconds(std::stoul(Config::getPoolMaxLifetimeMs()));
+        poolOptions.backoff_max = std::chrono::milliseconds(std::stoul(Config::getPoolReconnectBackoffMaxMs()));
+
+        copyPool = std::make_unique<CopyConnectionPool>(std::stoul(Config::getExportMaxConnections()), poolOptions.checkout_timeout);
+
+        breaker = std::make_unique<CircuitBreaker>("primary", CircuitBreaker::Options{static_cast<uint32_t>(std::stoul(Config::getCircuitFailureThreshold())),
+                                                                                    std::chrono::milliseconds(std::stoul(Config::getCircuitOpenMs())),
+                                                                                    static_cast<uint32_t>(std::stoul(Config::getCircuitHalfOpenProbes()))});
+
+        connectionPool = std::make_unique<ConnectionPool>(connection_string, poolOptions);
+        connectionPool->open();
+
+        queryWatchdog = std::make_unique<QueryWatchdog>();
+        queryWatchdog->start(std::chrono::milliseconds(std::stoul(Config::getQueryWatchdogIntervalMs())));
+
+        hedger = std::make_unique<Hedger>(Hedger::Options{Config::getHedgeEnabled() == "true",
+                                                          std::stod(Config::getHedgeBudgetPercent()) / 100.0,
+                                                          std::chrono::milliseconds(std::stoul(Config::getHedgeMinDelayMs())),
+                                                          static_cast<uint32_t>(std::stoul(Config::getHedgeMinSamples()))});
+
+        std::stringstream replicaHosts(Config::getReplicaHosts());
+        std::string replicaHost;
+        size_t replicaCount = 0;
+        while (std::getline(replicaHosts, replicaHost, ','))
+        {
+            if (replicaHost.empty())
+            {
+                continue;
+            }
+            ++replicaCount;
+
+            if (!replicas)
+            {
+                replicas = std::make_unique<ReplicaSet>(ReplicaSet::Options{std::stoul(Config::getReplicaMaxLagBlocks()),
+                                                                            static_cast<uint32_t>(std::stoul(Config::getReplicaEjectFailures())),
+                                                                            std::chrono::milliseconds(std::stoul(Config::getReplicaEjectMs()))});
+            }
+
+            ConnectionPool::Options replicaOptions = poolOptions;
+            replicaOptions.name = replicaHost;
+            auto replicaPool = std::make_unique<ConnectionPool>(connectionStringFor(replicaHost), replicaOptions);
+
+            // An unreachable replica mustn't stop the API starting, its pool keeps reconnecting in the background.
+            try
+            {
+                replicaPool->open();
+            }
+            catch (const std::exception &e)
+            {
+                CROW_LOG_WARNING << "Replica " << replicaHost << " is not reachable yet: " << e.what();
+            }
+
+            replicas->add(replicaHost, std::move(replicaPool));
         }
+
+        // Every read in flight may have a hedge scheduled, and reads are bounded by the connections they can hold.
+        hedgeExecutor = std::make_unique<HedgeExecutor>(std::stoul(Config::getHedgeMaxThreads()), poolOptions.max_size * (replicaCount + 1));
     }
 
     catch (std::exception &e)
@@ -38,9 +388,9 @@ std::optional<json> Database::fetchAllBlocks()
 {
     try
     {
-        ManagedConnection conn(*this);
-        transaction tx(*conn);
-        auto result = tx.exec("SELECT * FROM blocks");
+        ManagedConnection conn(*this, ReadTarget::AnyReplica);
+        auto result = tracedRead(conn, "fetch_all_blocks", [&](transaction &tx)
+            { return tx.exec("SELECT * FROM blocks"); });
         json retVal({});
 
         if (result.empty())
@@ -69,10 +419,10 @@ json Database::fetchAllTransactions()
 {
     try
     {
-        ManagedConnection conn(*this);
+        ManagedConnection conn(*this, ReadTarget::AnyReplica);
         json retVal{{}};
-        transaction tx(*conn);
-        auto result = tx.exec("SELECT * FROM transactions");
+        auto result = tracedRead(conn, "fetch_all_transactions", [&](transaction &tx)
+            { return tx.exec("SELECT * FROM transactions"); });
         if (result.empty())
         {
             return retVal;
@@ -145,8 +495,8 @@ std::optional<json> Database::fetchPaginatedBlocks(int page, int limit, bool rev
     try
     {
         ManagedConnection conn(*this);
-        transaction tx(*conn);
-        auto result = tx.exec(query);
+        auto result = tracedRead(conn, "fetch_paginated_blocks", [&](transaction &tx)
+            { return tx.exec(query); });
 
         if (result.empty())
         {
@@ -223,8 +573,8 @@ std::optional<json> Database::fetchPaginatedTransactions(int page, int limit, bo
     try
     {
         ManagedConnection conn(*this);
-        transaction tx(*conn);
-        auto result = tx.exec(query);
+        auto result = tracedRead(conn, "fetch_paginated_transactions", [&](transaction &tx)
+            { return tx.exec(query); });
 
         std::vector<json> jsonTxVec;
         jsonTxVec.reserve(result.size());
@@ -251,8 +601,8 @@ std::optional<uint64_t> Database::fetchTotalTransactionCount()
     try
     {
         ManagedConnection conn(*this);
-        transaction tx(*conn);
-        auto result = tx.exec("SELECT COUNT(*) FROM transactions");
+        auto result = tracedRead(conn, "count_transactions", [&](transaction &tx)
+            { return tx.exec("SELECT COUNT(*) FROM transactions"); });
 
         int retVal = 0;
         if (result.empty())
@@ -275,8 +625,8 @@ std::optional<uint64_t> Database::getMostRecentTransactionTimestamp()
     try
     {
         ManagedConnection conn(*this);
-        transaction tx(*conn);
-        auto result = tx.exec("SELECT MAX(timestamp) FROM transactions");
+        auto result = tracedRead(conn, "latest_transaction_timestamp", [&](transaction &tx)
+            { return tx.exec("SELECT MAX(timestamp) FROM transactions"); });
 
         if (result.empty() || result[0][0].is_null())
         {
@@ -298,8 +648,8 @@ std::optional<uint64_t> Database::fetchTotalBlocksCount()
     try
     {
         ManagedConnection conn(*this);
-        transaction tx(*conn);
-        auto result = tx.exec("SELECT COUNT(*) FROM blocks");
+        auto result = tracedRead(conn, "count_blocks", [&](transaction &tx)
+            { return tx.exec("SELECT COUNT(*) FROM blocks"); });
 
         uint64_t retVal = 0;
         if (result.empty())
@@ -317,15 +667,15 @@ std::optional<uint64_t> Database::fetchTotalBlocksCount()
     }
 }
 
-std::optional<json> Database::fetchBlockByHash(const std::string &block_hash)
+std::optional<json> Database::fetchBlockByHash(const std::string &block_hash, std::optional<uint64_t> height)
 {
 
     try
     {
-        ManagedConnection conn(*this);
-        transaction txn(*conn);
-        std::string query = "SELECT * FROM blocks WHERE hash = " + txn.quote(block_hash);
-        auto result = txn.exec(query);
+        // Heights are stored as text, so a known height is matched as text to stay on the column's index.
+        auto result = hedgedRead("fetch_block_by_hash", [block_hash, height](transaction &txn)
+            { return txn.exec("SELECT * FROM blocks WHERE hash = " + txn.quote(block_hash) +
+                              (height.has_value() ? " AND height = " + txn.quote(std::to_string(height.value())) : "")); });
         json retVal{{}};
 
         if (result.empty())
@@ -341,14 +691,13 @@ std::optional<json> Database::fetchBlockByHash(const std::string &block_hash)
     }
 }
 
-std::optional<json> Database::fetchTransactionByHash(const std::string &transaction_hash)
+std::optional<json> Database::fetchTransactionByHash(const std::string &transaction_hash, std::optional<uint64_t> height)
 {
     try
     {
-        ManagedConnection conn(*this);
-        transaction txn(*conn);
-        std::string query = "SELECT * FROM transactions WHERE tx_id = " + txn.quote(transaction_hash);
-        auto result = txn.exec(query);
+        auto result = hedgedRead("fetch_transaction_by_hash", [transaction_hash, height](transaction &txn)
+            { return txn.exec("SELECT * FROM transactions WHERE tx_id = " + txn.quote(transaction_hash) +
+                              (height.has_value() ? " AND height = " + txn.quote(std::to_string(height.value())) : "")); });
         json retVal{{}};
 
         if (!result.empty())
@@ -364,15 +713,60 @@ std::optional<json> Database::fetchTransactionByHash(const std::string &transact
     }
 }
 
+std::optional<json> Database::fetchExpandedTransactionByHash(const std::string &transaction_hash, std::optional<uint64_t> height, bool inputs, bool outputs)
+{
+    // Rows of a related table as a JSON array of objects with text values, the shape Parser::row_to_json gives them.
+    auto related = [](const std::string &table, const std::string &column)
+    {
+        return ", (SELECT COALESCE(json_agg((SELECT json_object_agg(f.key, COALESCE(f.value, '')) FROM json_each_text(row_to_json(r)) f)), '[]') FROM " +
+               table + " r WHERE r.tx_id = t.tx_id) AS " + column;
+    };
+
+    const std::string selected = (inputs ? related("transparent_inputs", "expanded_transparent_inputs") : "") +
+                                 (outputs ? related("transparent_outputs", "expanded_transparent_outputs") : "");
+
+    try
+    {
+        auto result = hedgedRead("fetch_expanded_transaction_by_hash", [transaction_hash, height, selected](transaction &txn)
+            { return txn.exec("SELECT t.*" + selected + " FROM transactions t WHERE t.tx_id = " + txn.quote(transaction_hash) +
+                              (height.has_value() ? " AND t.height = " + txn.quote(std::to_string(height.value())) : "")); });
+
+        if (result.empty())
+        {
+            return std::nullopt;
+        }
+
+        json retVal;
+        for (const auto &field : result[0])
+        {
+            const std::string name = field.name();
+            if (name == "expanded_transparent_inputs" || name == "expanded_transparent_outputs")
+            {
+                retVal[name.substr(std::string("expanded_").size())] = json::parse(field.c_str());
+            }
+            else
+            {
+                retVal[name] = field.c_str();
+            }
+        }
+
+        return retVal;
+    }
+    catch (const std::exception &e)
+    {
+        throw;
+    }
+}
+
 std::optional<json> Database::fetchTransparentOutputsRelatedToTransactionId(const std::string &transaction_id)
 {
 
     try
     {
         ManagedConnection conn(*this);
-        transaction tx(*conn);
         std::string query = "SELECT * FROM transparent_outputs WHERE tx_id = $1";
-        auto result = tx.exec_params(query, transaction_id);
+        auto result = tracedRead(conn, "fetch_transparent_outputs", [&](transaction &tx)
+            { return tx.exec_params(query, transaction_id); });
         json retVal{{}};
 
         if (result.empty())
@@ -400,9 +794,9 @@ std::optional<json> Database::fetchTransparentInputsRelatedToTransactionId(const
     try
     {
         ManagedConnection conn(*this);
-        transaction tx(*conn);
         std::string query = "SELECT * FROM transparent_inputs WHERE tx_id = $1";
-        auto result = tx.exec_params(query, transaction_id);
+        auto result = tracedRead(conn, "fetch_transparent_inputs", [&](transaction &tx)
+            { return tx.exec_params(query, transaction_id); });
         json retVal{{}};
 
         if (result.empty())
@@ -436,7 +830,6 @@ std::optional<json> Database::fetchTransactionsDetailsFromIds(const std::vector<
     try
     {
         ManagedConnection conn(*this);
-        transaction tx(*conn);
         std::string query{""};
         pqxx::result res;
         std::vector<json> transaction_details;
@@ -444,7 +837,8 @@ std::optional<json> Database::fetchTransactionsDetailsFromIds(const std::vector<
         for (const std::string &id : transaction_ids)
         {
             query = "SELECT * FROM transactions WHERE tx_id = $1";
-            res = tx.exec_params(query, id);
+            res = tracedRead(conn, "fetch_transaction_details", [&](transaction &tx)
+                { return tx.exec_params(query, id); });
 
             if (!res.empty())
             {
@@ -470,8 +864,8 @@ std::optional<json> Database::fetchPeerInfo()
     {
         ManagedConnection connection(*this);
         json retVal{{}};
-        transaction tx{*connection};
-        auto result = tx.exec("SELECT * FROM peerinfo");
+        auto result = tracedRead(connection, "fetch_peer_info", [&](transaction &tx)
+            { return tx.exec("SELECT * FROM peerinfo"); });
         std::vector<json> peer_info_list{result.size()};
 
         if (result.empty())
@@ -501,9 +895,8 @@ std::optional<json> Database::fetchBlockchainInfo()
     {
         ManagedConnection connection(*this);
         json retVal{{}};
-        transaction tx(*connection);
-
-        auto result = tx.exec("SELECT * FROM chain_info");
+        auto result = tracedRead(connection, "fetch_chain_info", [&](transaction &tx)
+            { return tx.exec("SELECT * FROM chain_info"); });
 
         if (result.empty())
         {
@@ -530,12 +923,11 @@ std::optional<json> Database::directSearch(const std::string &pattern)
 
     try
     {
-        ManagedConnection connection(*this);
-        transaction tx{*connection};
-
-        connection->prepare(preparedStmt, "SELECT 'transactions' AS source_table, tx_id AS identifier FROM transactions WHERE tx_id = $1 UNION ALL SELECT 'blocks', hash FROM blocks WHERE hash = $1");
-
-        auto result = tx.exec_prepared(preparedStmt, pattern);
+        auto result = hedgedRead("direct_search_query", [preparedStmt, pattern](transaction &tx)
+            {
+                // Prepared on whichever connection runs the read, including a replacement after a failover.
+                tx.conn().prepare(preparedStmt, "SELECT 'transactions' AS source_table, tx_id AS identifier FROM transactions WHERE tx_id = $1 UNION ALL SELECT 'blocks', hash FROM blocks WHERE hash = $1");
+                return tx.exec_prepared(preparedStmt, pattern); });
 
         if (result.empty())
         {
@@ -550,6 +942,50 @@ std::optional<json> Database::directSearch(const std::string &pattern)
     }
 }
 
+bool Database::transparentAddressExists(const std::string &address)
+{
+    const std::string preparedStmt{"address_search_query"};
+
+    try
+    {
+        auto result = hedgedRead("address_search_query", [preparedStmt, address](transaction &tx)
+            {
+                tx.conn().prepare(preparedStmt, "SELECT 1 FROM transparent_outputs WHERE address = $1 LIMIT 1");
+                return tx.exec_prepared(preparedStmt, address); });
+
+        return !result.empty();
+    }
+    catch (const std::exception &e)
+    {
+        throw;
+    }
+}
+
+json Database::fetchTransparentOutputsForAddress(const std::string &address, uint64_t limit)
+{
+    const std::string preparedStmt{"address_outputs_query"};
+
+    try
+    {
+        auto result = hedgedRead("address_outputs_query", [preparedStmt, address, limit](transaction &tx)
+            {
+                tx.conn().prepare(preparedStmt, "SELECT o.*, CAST(t.height AS INTEGER) AS height FROM transparent_outputs o JOIN transactions t ON t.tx_id = o.tx_id"
+                                                " WHERE o.address = $1 ORDER BY CAST(t.height AS INTEGER) DESC, o.tx_id LIMIT $2");
+                return tx.exec_prepared(preparedStmt, address, limit); });
+
+        json outputs = json::array();
+        for (const auto &row : result)
+        {
+            outputs.push_back(Parser::row_to_json(row));
+        }
+        return outputs;
+    }
+    catch (const std::exception &e)
+    {
+        throw;
+    }
+}
+
 std::optional<json> Database::fetchTransactionInPeriod(uint64_t startTimestamp, uint64_t _endTimestamp)
 {
     try
@@ -559,10 +995,10 @@ std::optional<json> Database::fetchTransactionInPeriod(uint64_t startTimestamp,
         uint64_t endTimestamp = startTimestamp + (14 * 24 * 60 * 60); // 14 days in seconds
 
         // Execute the SQL query to get transactions within the specified period
-        transaction tx(*connection);
-        auto result = tx.exec("SELECT * FROM transactions WHERE timestamp >= " +
-                              std::to_string(startTimestamp) + " AND timestamp <= " +
-                              std::to_string(endTimestamp));
+        auto result = tracedRead(connection, "fetch_transactions_in_period", [&](transaction &tx)
+                                 { return tx.exec("SELECT * FROM transactions WHERE timestamp >= " +
+                                                  std::to_string(startTimestamp) + " AND timestamp <= " +
+                                                  std::to_string(endTimestamp)); });
 
         if (result.empty())
         {
@@ -597,6 +1033,229 @@ std::optional<json> Database::fetchTransactionInPeriod(uint64_t startTimestamp,
     }
 }
 
+std::unique_ptr<ExportCursor> Database::exportBlocks(uint64_t fromHeight, uint64_t batchHeights)
+{
+    return exportByHeight("blocks", "CAST(height AS INTEGER)", fromHeight, batchHeights);
+}
+
+std::unique_ptr<ExportCursor> Database::exportTransactions(uint64_t fromHeight, uint64_t batchHeights)
+{
+    return exportByHeight("transactions", "CAST(height AS INTEGER), tx_id", fromHeight, batchHeights);
+}
+
+std::unique_ptr<ExportCursor> Database::exportByHeight(const std::string &table, const std::string &orderBy, uint64_t fromHeight, uint64_t batchHeights)
+{
+    if (batchHeights == 0)
+    {
+        throw std::invalid_argument("Export batch size must be greater than zero.");
+    }
+
+    return std::make_unique<ExportCursor>(*this, table, orderBy, fromHeight, batchHeights);
+}
+
+ExportCursor::ExportCursor(Database &db, const std::string &table, const std::string &orderBy, uint64_t fromHeight, uint64_t batchHeights)
+    : conn(db, ReadTarget::AnyReplica),
+      tx(*conn),
+      query("SELECT * FROM " + table +
+            " WHERE CAST(height AS INTEGER) >= $1 AND CAST(height AS INTEGER) < $2"
+            " ORDER BY " + orderBy),
+      next_height(fromHeight),
+      batch_heights(batchHeights)
+{
+    // Exports are expected to run long, so each batch gets the route's timeout rather than sharing one deadline.
+    if (const QueryContext *context = QueryContext::current())
+    {
+        timeout = context->timeout();
+        QueryContext::applyStatementTimeout(tx, QueryContext::clock::now() + timeout.value());
+    }
+
+    auto tipResult = tracedExec("export_tip", [&]
+        { return tx.exec("SELECT MAX(CAST(height AS INTEGER)) FROM " + table); });
+    if (tipResult.empty() || tipResult[0][0].is_null())
+    {
+        exhausted = true;
+        return;
+    }
+    tip_height = tipResult[0][0].as<uint64_t>();
+}
+
+bool ExportCursor::next(std::vector<json> &batch)
+{
+    if (exhausted || next_height > tip_height)
+    {
+        return false;
+    }
+
+    if (timeout.has_value())
+    {
+        QueryContext::applyStatementTimeout(tx, QueryContext::clock::now() + timeout.value());
+    }
+
+    auto result = tracedExec("export_batch", [&]
+        { return tx.exec_params(query, next_height, next_height + batch_heights); });
+    next_height += batch_heights;
+
+    batch.clear();
+    batch.reserve(result.size());
+    for (const pqxx::row &row : result)
+    {
+        batch.push_back(Parser::row_to_json(row));
+    }
+    return true;
+}
+
+std::unique_ptr<CsvCopyCursor> Database::copyTableToCsv(const std::string &table, std::optional<uint64_t> fromHeight, std::optional<uint64_t> toHeight)
+{
+    if (std::find(csv_export_tables.begin(), csv_export_tables.end(), table) == csv_export_tables.end())
+    {
+        throw std::invalid_argument("Unknown export table " + table + ".");
+    }
+
+    // COPY does not accept bind parameters, the bounds are integers so they are inlined.
+    const bool keyedByTransaction = table == "transparent_inputs" || table == "transparent_outputs";
+    const std::string heightColumn = keyedByTransaction ? "CAST(t.height AS INTEGER)" : "CAST(height AS INTEGER)";
+
+    std::string query = keyedByTransaction
+                            ? "SELECT s.* FROM " + table + " s JOIN transactions t ON t.tx_id = s.tx_id WHERE TRUE"
+                            : "SELECT * FROM " + table + " WHERE TRUE";
+    if (fromHeight.has_value())
+    {
+        query += " AND " + heightColumn + " >= " + std::to_string(fromHeight.value());
+    }
+    if (toHeight.has_value())
+    {
+        query += " AND " + heightColumn + " <= " + std::to_string(toHeight.value());
+    }
+    query += " ORDER BY " + heightColumn;
+
+    // Bulk copies are served by the least busy replica when one is healthy.
+    ConnectionPool *replica = replicas ? replicas->choose(false) : nullptr;
+    const std::string &target = replica != nullptr ? replica->connectionString() : connection_string;
+
+    if (replica == nullptr && !breaker->allow())
+    {
+        threadConnectionUsage().circuit_open = true;
+        throw std::runtime_error("Database is unavailable, retry later.");
+    }
+
+    CopyConnectionPool::Handle conn(nullptr, &PQfinish);
+    try
+    {
+        conn = copyPool->acquire(target);
+    }
+    catch (const std::exception &)
+    {
+        replica != nullptr ? replicas->finished(replica, true) : breaker->failed();
+        throw;
+    }
+    replica != nullptr ? replicas->finished(replica, false) : breaker->succeeded();
+
+    try
+    {
+        startCopy(conn.get(), query);
+    }
+    catch (const std::exception &)
+    {
+        copyPool->release(target, std::move(conn), true);
+        throw;
+    }
+    return std::make_unique<CsvCopyCursor>(*copyPool, target, std::move(conn));
+}
+
+void Database::startCopy(PGconn *conn, const std::string &query)
+{
+    // Pooled connections are reused, so the timeout is set on every copy, 0 clearing an earlier one.
+    const QueryContext *context = QueryContext::current();
+    std::unique_ptr<PGresult, decltype(&PQclear)> timeout(
+        PQexec(conn, ("SET statement_timeout = " + std::to_string(context != nullptr ? context->timeout().count() : 0)).c_str()), &PQclear);
+    if (PQresultStatus(timeout.get()) != PGRES_COMMAND_OK)
+    {
+        throw std::runtime_error(std::string("Export failed: ") + PQerrorMessage(conn));
+    }
+
+    std::unique_ptr<PGresult, decltype(&PQclear)> copyStart(
+        PQexec(conn, ("COPY (" + query + ") TO STDOUT WITH (FORMAT csv, HEADER)").c_str()), &PQclear);
+    if (PQresultStatus(copyStart.get()) != PGRES_COPY_OUT)
+    {
+        throw std::runtime_error(std::string("Export failed: ") + PQerrorMessage(conn));
+    }
+}
+
+CsvCopyCursor::CsvCopyCursor(CopyConnectionPool &pool_, std::string target_, CopyConnectionPool::Handle conn_)
+    : pool(pool_), target(std::move(target_)), conn(std::move(conn_))
+{
+}
+
+CsvCopyCursor::~CsvCopyCursor()
+{
+    if (!conn)
+    {
+        return;
+    }
+
+    std::unique_ptr<PGcancel, decltype(&PQfreeCancel)> cancel(PQgetCancel(conn.get()), &PQfreeCancel);
+    char errbuf[256];
+    PQcancel(cancel.get(), errbuf, sizeof(errbuf));
+
+    // Keep reading until the server acknowledges so the connection leaves COPY state. The cancel reports an error.
+    char *buffer = nullptr;
+    while (PQgetCopyData(conn.get(), &buffer, 0) > 0)
+    {
+        PQfreemem(buffer);
+    }
+    while (PGresult *result = PQgetResult(conn.get()))
+    {
+        PQclear(result);
+    }
+
+    pool.release(target, std::move(conn), true);
+}
+
+bool CsvCopyCursor::next(std::string &part, size_t maxBytes)
+{
+    if (!conn)
+    {
+        return false;
+    }
+
+    char *buffer = nullptr;
+    int length = 0;
+    while (part.size() < maxBytes && (length = PQgetCopyData(conn.get(), &buffer, 0)) > 0)
+    {
+        part.append(buffer, static_cast<size_t>(length));
+        PQfreemem(buffer);
+    }
+
+    // -1 ends the copy, -2 reports that it failed.
+    if (length < 0)
+    {
+        finish(length == -2);
+    }
+    return true;
+}
+
+void CsvCopyCursor::finish(bool failed)
+{
+    std::string error = PQerrorMessage(conn.get());
+
+    // Drain the final command status.
+    while (PGresult *result = PQgetResult(conn.get()))
+    {
+        if (PQresultStatus(result) != PGRES_COMMAND_OK && !failed)
+        {
+            failed = true;
+            error = PQerrorMessage(conn.get());
+        }
+        PQclear(result);
+    }
+
+    pool.release(target, std::move(conn), failed);
+    if (failed)
+    {
+        throw std::runtime_error("Export failed: " + error);
+    }
+}
+
 std::string Database::unixTimestampToDateString(uint64_t timestamp)
 {
     std::time_t time = static_cast<std::time_t>(timestamp);
@@ -606,48 +1265,313 @@ std::string Database::unixTimestampToDateString(uint64_t timestamp)
     return std::string(buffer);
 }
 
-std::unique_ptr<pqxx::connection> Database::GetConnection()
+std::unique_ptr<PooledConnection> Database::GetConnection(ReadTarget target)
 {
-    try
+    if (!connectionPool)
     {
-        std::lock_guard<std::mutex> lock(cs_pool_mutex);
+        throw std::runtime_error("Database is not connected.");
+    }
 
-        // TODO: Refactor to wait until the connection pool has > 1 pqxx::connection
-        if (connectionPool.empty())
+    if (target != ReadTarget::Primary && replicas)
+    {
+        if (ConnectionPool *replica = replicas->choose(target == ReadTarget::FreshReplica))
         {
-            return nullptr;
+            try
+            {
+                return replica->acquire();
+            }
+            catch (const std::exception &e)
+            {
+                replicas->finished(replica, true);
+                CROW_LOG_WARNING << "Replica checkout failed, falling back to the primary: " << e.what();
+            }
         }
+    }
 
-        auto conn = std::move(connectionPool.front());
-        connectionPool.pop();
+    return acquirePrimary();
+}
 
-        return conn;
+std::unique_ptr<PooledConnection> Database::acquirePrimary()
+{
+    if (!breaker->allow())
+    {
+        threadConnectionUsage().circuit_open = true;
+        throw std::runtime_error("Database is unavailable, retry later.");
     }
-    catch (const std::exception &e)
+
+    try
+    {
+        return connectionPool->acquire();
+    }
+    catch (const std::exception &)
     {
-        throw std::runtime_error(e.what());
+        // A checkout that times out while connections are healthy means the pool is busy, not that the primary is down.
+        connectionPool->stats().healthy == 0 ? breaker->failed() : breaker->succeeded();
+        throw;
     }
 }
 
+ConnectionUsage &Database::threadConnectionUsage()
+{
+    thread_local ConnectionUsage usage;
+    return usage;
+}
+
 void Database::createJsonErrorResponse(json &errorResponse, const std::exception &e)
 {
     errorResponse["error"] = e.what();
 }
 
-bool Database::ReleaseConnection(std::unique_ptr<pqxx::connection> conn)
+bool Database::ReleaseConnection(std::unique_ptr<PooledConnection> conn, bool broken)
 {
-    std::lock_guard<std::mutex> lock(cs_pool_mutex);
-    connectionPool.push(std::move(conn));
+    if (!conn)
+    {
+        return false;
+    }
+
+    ConnectionPool *pool = conn->pool != nullptr ? conn->pool : connectionPool.get();
+    broken = broken || !conn->connection || !conn->connection->is_open();
+    pool->release(std::move(conn), broken);
+
+    if (pool == connectionPool.get())
+    {
+        broken ? breaker->failed() : breaker->succeeded();
+    }
+    else if (replicas)
+    {
+        replicas->finished(pool, broken);
+    }
     return true;
 }
 
+Database::~Database() noexcept
+{
+    // Hedge attempts use the pools and replicas, so they must finish before those are destroyed.
+    if (hedgeExecutor)
+    {
+        hedgeExecutor->stop();
+    }
+}
+
 void Database::ShutdownConnections()
 {
-    while (!connectionPool.empty()) {
-        std::unique_ptr<pqxx::connection> conn = std::move(connectionPool.front());
-        conn.reset();
+    if (hedgeExecutor)
+    {
+        hedgeExecutor->stop();
+    }
+
+    if (queryWatchdog)
+    {
+        queryWatchdog->stop();
+    }
 
-        connectionPool.pop();
+    if (connectionPool)
+    {
+        connectionPool->shutdown();
+    }
+}
+
+CircuitState Database::circuitState() const
+{
+    return breaker ? breaker->state() : CircuitState::Closed;
+}
+
+std::chrono::milliseconds Database::circuitRetryAfter() const
+{
+    return breaker ? breaker->retryAfter() : std::chrono::milliseconds(0);
+}
+
+std::vector<ReplicaStats> Database::replicaStats() const
+{
+    if (!replicas)
+    {
+        return {};
+    }
+
+    return replicas->stats();
+}
+
+void Database::refreshReplicaLag(uint64_t tipHeight)
+{
+    if (replicas)
+    {
+        replicas->refreshLag(tipHeight);
+    }
+}
+
+PoolStats Database::poolStats() const
+{
+    if (!connectionPool)
+    {
+        return PoolStats{};
+    }
+
+    return connectionPool->stats();
+}
+
+std::optional<uint64_t> Database::fetchTipHeight()
+{
+    try
+    {
+        ManagedConnection conn(*this, ReadTarget::Primary);
+        auto result = tracedRead(conn, "fetch_tip_height", [&](transaction &tx)
+            { return tx.exec("SELECT MAX(CAST(height AS INTEGER)) FROM blocks"); });
+
+        if (result.empty() || result[0][0].is_null())
+        {
+            return std::nullopt;
+        }
+
+        return result[0][0].as<uint64_t>();
+    }
+    catch (const std::exception &e)
+    {
+        throw;
+    }
+}
+
+void Database::fetchBlockHeaders(uint64_t fromHeight, uint64_t toHeight, std::vector<BlockHeader> &out)
+{
+    try
+    {
+        ManagedConnection conn(*this);
+        auto result = tracedRead(conn, "fetch_block_headers", [&](transaction &tx)
+            { return tx.exec_params("SELECT b.hash, CAST(b.height AS INTEGER), b.timestamp, b.size, b.difficulty,"
+                                    " (SELECT COUNT(*) FROM transactions t WHERE t.height = b.height)"
+                                    " FROM blocks b WHERE CAST(b.height AS INTEGER) >= $1 AND CAST(b.height AS INTEGER) < $2"
+                                    " ORDER BY CAST(b.height AS INTEGER)",
+                                    fromHeight, toHeight); });
+
+        out.clear();
+        out.reserve(result.size());
+
+        for (const pqxx::row &row : result)
+        {
+            BlockHeader header{};
+            if (!decodeSHA256Hash(row[0].c_str(), header.hash))
+            {
+                throw std::runtime_error("Block at height " + std::string(row[1].c_str()) + " has a malformed hash.");
+            }
+
+            header.height = row[1].as<uint64_t>();
+            header.timestamp = row[2].as<uint32_t>();
+            header.size = row[3].as<uint32_t>();
+            header.difficulty = row[4].as<double>();
+            header.tx_count = row[5].as<uint32_t>();
+            out.push_back(header);
+        }
+    }
+    catch (const std::exception &e)
+    {
+        throw;
+    }
+}
+
+void Database::fetchHashIndexEntries(uint64_t fromHeight, uint64_t toHeight, std::vector<HashIndexEntry> &out)
+{
+    try
+    {
+        ManagedConnection conn(*this);
+        auto blocks = tracedRead(conn, "fetch_block_hashes", [&](transaction &tx)
+            { return tx.exec_params("SELECT hash, CAST(height AS INTEGER) FROM blocks"
+                                    " WHERE CAST(height AS INTEGER) >= $1 AND CAST(height AS INTEGER) < $2",
+                                    fromHeight, toHeight); });
+        auto transactions = tracedRead(conn, "fetch_transaction_ids", [&](transaction &tx)
+            { return tx.exec_params("SELECT tx_id, CAST(height AS INTEGER) FROM transactions"
+                                    " WHERE CAST(height AS INTEGER) >= $1 AND CAST(height AS INTEGER) < $2"
+                                    " ORDER BY CAST(height AS INTEGER), tx_id",
+                                    fromHeight, toHeight); });
+
+        out.clear();
+        out.reserve(blocks.size() + transactions.size());
+
+        auto append = [&](const pqxx::row &row, uint32_t txIndex)
+        {
+            HashIndexEntry entry{};
+            if (!decodeSHA256Hash(row[0].c_str(), entry.hash))
+            {
+                throw std::runtime_error("Malformed hash " + std::string(row[0].c_str()) + " at height " + row[1].c_str() + ".");
+            }
+
+            entry.height = row[1].as<uint32_t>();
+            entry.tx_index = txIndex;
+            out.push_back(entry);
+        };
+
+        for (const pqxx::row &row : blocks)
+        {
+            append(row, HashIndexEntry::block_marker);
+        }
+
+        // Transactions arrive grouped by height, so their position restarts at each new height.
+        uint32_t txIndex = 0;
+        uint32_t lastHeight = 0;
+        for (const pqxx::row &row : transactions)
+        {
+            const uint32_t height = row[1].as<uint32_t>();
+            txIndex = out.size() > blocks.size() && height == lastHeight ? txIndex + 1 : 0;
+            lastHeight = height;
+            append(row, txIndex);
+        }
+    }
+    catch (const std::exception &e)
+    {
+        throw;
+    }
+}
+
+std::optional<uint64_t> Database::fetchBlockHeightAtTime(uint64_t timestamp)
+{
+    try
+    {
+        ManagedConnection conn(*this);
+        auto result = tracedRead(conn, "fetch_block_height_at_time", [&](transaction &tx)
+            { return tx.exec_params("SELECT MIN(CAST(height AS INTEGER)) FILTER (WHERE timestamp > $1), MAX(CAST(height AS INTEGER)) FROM blocks",
+                                    timestamp); });
+
+        if (result.empty() || result[0][1].is_null())
+        {
+            return std::nullopt;
+        }
+
+        if (result[0][0].is_null())
+        {
+            return result[0][1].as<uint64_t>();
+        }
+
+        const uint64_t later = result[0][0].as<uint64_t>();
+        return later > 0 ? std::optional<uint64_t>(later - 1) : std::nullopt;
+    }
+    catch (const std::exception &e)
+    {
+        throw;
+    }
+}
+
+json Database::fetchBlocksInRange(uint64_t fromHeight, uint64_t toHeight)
+{
+    const std::string preparedStmt{"fetch_blocks_in_range"};
+
+    try
+    {
+        ManagedConnection conn(*this);
+        auto result = tracedRead(conn, "fetch_blocks_in_range", [&](transaction &tx)
+            {
+                // Matches the expression index on CAST(height AS INTEGER), so the range is an index scan.
+                tx.conn().prepare(preparedStmt, "SELECT * FROM blocks WHERE CAST(height AS INTEGER) BETWEEN $1 AND $2 ORDER BY CAST(height AS INTEGER)");
+                return tx.exec_prepared(preparedStmt, fromHeight, toHeight); });
+
+        json blocks = json::array();
+        for (const pqxx::row &row : result)
+        {
+            blocks.push_back(Parser::row_to_json(row));
+        }
+
+        return blocks;
+    }
+    catch (const std::exception &e)
+    {
+        throw;
     }
 }
 
@@ -3,19 +3,52 @@
 #include <string>
 #include <pqxx/pqxx>
 #include <mutex>
-#include <queue>
 #include "nlohmann/json.hpp"
 #include <memory>
 #include <fstream>
 #include "config.h"
+#include "trace.hpp"
+#include "connection_pool.hpp"
+#include "replica_set.hpp"
+#include "hedging.hpp"
+#include "query_context.hpp"
+#include "circuit_breaker.hpp"
+#include "block_header_store.hpp"
+#include "hash_index.hpp"
 #include <cstdint>
 #include <optional>
+#include <functional>
+#include <chrono>
 #include "../include/crow_all.h"
 
 using json = nlohmann::json;
 using transaction = pqxx::work;
 
 struct ManagedConnection;
+struct HedgeState;
+class ExportCursor;
+class CsvCopyCursor;
+
+/**
+ * @brief Where a read may be served from.
+ */
+enum class ReadTarget
+{
+    Primary,      ///< Always the primary.
+    AnyReplica,   ///< Any healthy replica regardless of lag, falling back to the primary.
+    FreshReplica  ///< A healthy replica close enough to the tip, falling back to the primary.
+};
+
+/**
+ * @brief Pooled connection usage accumulated by the current thread since the last reset.
+ */
+struct ConnectionUsage
+{
+    std::chrono::microseconds pool_wait{0}; ///< Time spent waiting to check out connections.
+    std::chrono::microseconds held{0};      ///< Time connections were checked out.
+    uint32_t checkouts{0};                  ///< Number of connections checked out.
+    bool circuit_open{false};               ///< Whether a checkout was failed fast by the primary's open circuit.
+};
 
 /**
  * @brief Database class for handling interactions with a PostgreSQL database.
@@ -24,8 +57,6 @@ class Database
 {
     friend struct ManagedConnection;
 
-    const static uint8_t connection_pool_size;
-
 public:
     /**
      * @brief Constructor for the Database class.
@@ -35,7 +66,7 @@ public:
     /**
      * @brief Destructor for the Database class.
      */
-    ~Database() noexcept = default;
+    ~Database() noexcept;
 
     /**
      * @brief Connect to the PostgreSQL database.
@@ -97,16 +128,28 @@ public:
     /**
      * @brief Fetch a block by its hash from the database.
      * @param block_hash Hash of the block to fetch.
+     * @param height Height of the block if already known, narrowing the query to that height.
      * @return JSON object containing information about the specified block.
      */
-    std::optional<json> fetchBlockByHash(const std::string &block_hash);
+    std::optional<json> fetchBlockByHash(const std::string &block_hash, std::optional<uint64_t> height = std::nullopt);
 
     /**
      * @brief Fetch a transaction by its hash from the database.
      * @param transaction_hash Hash of the transaction to fetch.
+     * @param height Height of the transaction's block if already known, narrowing the query to that height.
      * @return JSON object containing information about the specified transaction.
      */
-    std::optional<json> fetchTransactionByHash(const std::string &transaction_hash);
+    std::optional<json> fetchTransactionByHash(const std::string &transaction_hash, std::optional<uint64_t> height = std::nullopt);
+
+    /**
+     * @brief Fetch a transaction along with its transparent inputs and/or outputs in a single query.
+     * @param transaction_hash Hash of the transaction to fetch.
+     * @param height Height of the transaction's block if already known, narrowing the query to that height.
+     * @param inputs Add the transaction's transparent inputs as `transparent_inputs`.
+     * @param outputs Add the transaction's transparent outputs as `transparent_outputs`.
+     * @return JSON object containing the transaction, or nullopt if there is no such transaction.
+     */
+    std::optional<json> fetchExpandedTransactionByHash(const std::string &transaction_hash, std::optional<uint64_t> height, bool inputs, bool outputs);
 
     /**
      * @brief Fetch details of transactions from a list of transaction IDs.
@@ -129,6 +172,14 @@ public:
      */
     std::optional<json> fetchTransparentOutputsRelatedToTransactionId(const std::string &transaction_id);
 
+    /**
+     * @brief Fetch the transparent outputs paid to an address, newest first.
+     * @param address Transparent address.
+     * @param limit Maximum number of outputs to return.
+     * @return JSON array of transparent outputs, each with the height of its transaction.
+     */
+    json fetchTransparentOutputsForAddress(const std::string &address, uint64_t limit);
+
     /**
      * @brief Fetch information about connected peers.
      * @return JSON object containing information about connected peers.
@@ -159,10 +210,137 @@ public:
 
     std::optional<json> directSearch(const std::string &);
 
+    /**
+     * @brief Check whether a transparent address has ever received an output.
+     * @param address Transparent address.
+     * @return True if the address appears in the chain.
+     */
+    bool transparentAddressExists(const std::string &address);
+
+    /**
+     * @brief Start exporting blocks in ascending height order, one range of heights per query.
+     * @param fromHeight First block height to export.
+     * @param batchHeights Number of heights covered by each query.
+     * @return Cursor reading the export a batch at a time.
+     */
+    std::unique_ptr<ExportCursor> exportBlocks(uint64_t fromHeight, uint64_t batchHeights);
+
+    /**
+     * @brief Start exporting transactions in ascending height order, one range of heights per query.
+     * @param fromHeight First block height to export.
+     * @param batchHeights Number of heights covered by each query.
+     * @return Cursor reading the export a batch at a time.
+     */
+    std::unique_ptr<ExportCursor> exportTransactions(uint64_t fromHeight, uint64_t batchHeights);
+
+    /**
+     * @brief Get the connection usage recorded on the calling thread.
+     * Route dispatch resets this before a handler runs and reads it afterwards to observe per request DB cost.
+     * @return Usage accumulated since the last reset.
+     */
+    static ConnectionUsage &threadConnectionUsage();
+
+    /**
+     * @brief Fetch the height of the highest block in the database.
+     * @return Tip height, or std::nullopt if there are no blocks.
+     */
+    std::optional<uint64_t> fetchTipHeight();
+
+    /**
+     * @brief Fetch the headers of a range of blocks.
+     * @param fromHeight First height.
+     * @param toHeight Height after the last one, the range is [fromHeight, toHeight).
+     * @param out Destination vector, replaced with the headers in ascending height order. Missing heights are skipped.
+     */
+    void fetchBlockHeaders(uint64_t fromHeight, uint64_t toHeight, std::vector<BlockHeader> &out);
+
+    /**
+     * @brief Fetch hash index entries for every block hash and txid in a range of heights.
+     * @param fromHeight First height.
+     * @param toHeight Height after the last one, the range is [fromHeight, toHeight).
+     * @param out Destination vector, replaced with the entries.
+     */
+    void fetchHashIndexEntries(uint64_t fromHeight, uint64_t toHeight, std::vector<HashIndexEntry> &out);
+
+    /**
+     * @brief Find the chain's height at a point in time, the last block before any block was stamped later than the time.
+     * @param timestamp Seconds since the Unix epoch.
+     * @return Height, or std::nullopt if the time is before genesis or there are no blocks.
+     */
+    std::optional<uint64_t> fetchBlockHeightAtTime(uint64_t timestamp);
+
+    /**
+     * @brief Fetch the blocks in a range of heights with a prepared range query on the integer height expression.
+     * @param fromHeight First height.
+     * @param toHeight Last height, the range is [fromHeight, toHeight].
+     * @return Blocks in ascending height order, missing any heights the database doesn't have.
+     */
+    json fetchBlocksInRange(uint64_t fromHeight, uint64_t toHeight);
+
+    /**
+     * @brief Take a snapshot of the connection pool's state without using a connection.
+     * @return Pool statistics.
+     */
+    PoolStats poolStats() const;
+
+    /**
+     * @brief Take a snapshot of every read replica's routing state without using a connection.
+     * @return Replica statistics, empty if no replicas are configured.
+     */
+    std::vector<ReplicaStats> replicaStats() const;
+
+    /**
+     * @brief Get the state of the circuit breaker guarding the primary.
+     * @return Circuit state, closed before connect().
+     */
+    CircuitState circuitState() const;
+
+    /**
+     * @brief Get how long until the primary's circuit next lets a probe through.
+     * @return Time left in the open period, zero unless the circuit is open.
+     */
+    std::chrono::milliseconds circuitRetryAfter() const;
+
+    /**
+     * @brief Measure how far each read replica lags behind the primary's tip.
+     * @param tipHeight Height of the primary's tip.
+     */
+    void refreshReplicaLag(uint64_t tipHeight);
+
+    /**
+     * @brief Tables that can be exported as CSV with copyTableToCsv.
+     */
+    static const std::vector<std::string> csv_export_tables;
+
+    /**
+     * @brief Start exporting a table as CSV using COPY ... TO STDOUT, read as raw COPY data without per row parsing.
+     * The copy runs on a connection from a small dedicated pool, bounded by EXPORT_MAX_CONNECTIONS, so long exports never
+     * hold a connection point lookups need. Copies on the primary go through its circuit breaker.
+     * @param table One of csv_export_tables.
+     * @param fromHeight Optional first block height to include.
+     * @param toHeight Optional last block height to include.
+     * @return Cursor reading the CSV, holding the connection until it is read to the end or destroyed.
+     */
+    std::unique_ptr<CsvCopyCursor> copyTableToCsv(const std::string &table, std::optional<uint64_t> fromHeight, std::optional<uint64_t> toHeight);
+
 private:
+    /**
+     * @brief Start a COPY ... TO STDOUT on a raw connection.
+     * @param conn Connection to copy over.
+     * @param query Query whose rows are copied.
+     */
+    void startCopy(PGconn *conn, const std::string &query);
+
     bool is_connected;                                            ///< Flag indicating whether the database is connected.
-    std::queue<std::unique_ptr<pqxx::connection>> connectionPool; ///< Connection pool for managing database connections.
-    std::mutex cs_pool_mutex;
+    std::string connection_string;                                ///< libpq connection string used by connect().
+    std::unique_ptr<ConnectionPool> connectionPool;               ///< Connection pool for managing database connections.
+    std::unique_ptr<ReplicaSet> replicas;                         ///< Read replicas, or nullptr if none are configured.
+    std::unique_ptr<CopyConnectionPool> copyPool;                 ///< Raw connections CSV exports copy over.
+    std::unique_ptr<Hedger> hedger;                               ///< Decides when point lookups are hedged.
+    std::unique_ptr<HedgeExecutor> hedgeExecutor;                 ///< Threads hedged read attempts run on.
+    std::unique_ptr<QueryWatchdog> queryWatchdog;                 ///< Cancels queries whose client disconnected.
+    std::unique_ptr<CircuitBreaker> breaker;                      ///< Fails primary checkouts fast while the primary is down.
+    uint32_t read_retry_attempts{1};                              ///< Attempts made by tracedRead when a connection breaks.
     const std::string prepared_direct_search_statement = "direct_search_query"; ///< Mutex for thread-safe access to the connection pool.
 
     /**
@@ -173,15 +351,24 @@ private:
     /**
      * @brief Release a database connection back to the pool.
      * @param conn Database connection to release.
+     * @param broken True if the connection failed and must be replaced rather than reused.
      * @return True if the connection was successfully released, false otherwise.
      */
-    bool ReleaseConnection(std::unique_ptr<pqxx::connection> conn);
+    bool ReleaseConnection(std::unique_ptr<PooledConnection> conn, bool broken = false);
 
     /**
      * @brief Get a database connection from the pool.
+     * @param target Where the connection's reads may be served from.
      * @return A unique pointer to a database connection.
      */
-    std::unique_ptr<pqxx::connection> GetConnection();
+    std::unique_ptr<PooledConnection> GetConnection(ReadTarget target = ReadTarget::Primary);
+
+    /**
+     * @brief Check out a primary connection through the circuit breaker.
+     * @return A primary connection.
+     * @throws std::runtime_error straight away while the circuit is open, or if the checkout fails.
+     */
+    std::unique_ptr<PooledConnection> acquirePrimary();
 
     /**
      * @brief Convert a Unix timestamp to a date string. ( "YYYY-MM-DD" )
@@ -189,28 +376,211 @@ private:
      * @return Date string in a specific format.
      */
     std::string unixTimestampToDateString(uint64_t timestamp);
+
+    /**
+     * @brief Start exporting rows of a height keyed table in ascending height order.
+     * @param table Table name. Must be a trusted identifier, it is not quoted.
+     * @param orderBy ORDER BY clause used within each height range.
+     * @param fromHeight First block height to export.
+     * @param batchHeights Number of heights covered by each query.
+     * @return Cursor reading the export a batch at a time.
+     */
+    std::unique_ptr<ExportCursor> exportByHeight(const std::string &table, const std::string &orderBy, uint64_t fromHeight, uint64_t batchHeights);
+
+    /**
+     * @brief Run an idempotent read in its own transaction, tracing it like any other statement.
+     * If the connection breaks, it is swapped for a fresh one and the read is retried, up to
+     * read_retry_attempts attempts in total. Within a request, each attempt is bounded by the request's deadline
+     * and cancelled if the client disconnects.
+     * @param conn Connection held by the caller. May be replaced.
+     * @param statement Statement name recorded on the request's trace.
+     * @param run Callable taking a transaction and returning its pqxx::result.
+     * @return Result of the read.
+     */
+    template <typename Run>
+    pqxx::result tracedRead(ManagedConnection &conn, const char *statement, Run &&run);
+
+    /**
+     * @brief Run an idempotent point lookup, hedging it on a second pool if it is slower than the statement's p95.
+     * The first answer wins and the other attempt is cancelled. Without hedging or replicas this is a tracedRead.
+     * @param statement Statement name, used for tracing and per statement latency tracking.
+     * @param run Callable taking a transaction and returning its pqxx::result. It must own everything it captures,
+     * since a losing attempt can still be running after the request finishes.
+     * @return Result of the first attempt to answer.
+     */
+    pqxx::result hedgedRead(const char *statement, std::function<pqxx::result(transaction &)> run);
+
+    /**
+     * @brief The hedge of a slow read, run on the hedge executor once the read has outlasted its delay.
+     * Does nothing if the read has already returned.
+     * @param state State shared with the read.
+     * @param statement Statement name.
+     */
+    void runHedge(std::shared_ptr<HedgeState> state, const char *statement);
 };
 
 struct ManagedConnection
 {
 public:
-    ManagedConnection(Database &db_) : db(db_), conn(db_.GetConnection()) {
-         std::lock_guard<std::mutex> lock(db_.cs_pool_mutex);
+    ManagedConnection(Database &db_, ReadTarget target_ = ReadTarget::FreshReplica)
+        : ManagedConnection(db_, [&db_, target_]
+                            { return db_.GetConnection(target_); }) {}
+
+    /**
+     * @brief Check out a connection chosen by the caller, e.g. one on a specific pool for a hedged read.
+     * @param db_ Database the connection belongs to.
+     * @param acquire_ Checks out a connection. Also called by replace().
+     */
+    ManagedConnection(Database &db_, std::function<std::unique_ptr<PooledConnection>()> acquire_) : db(db_), acquire(std::move(acquire_)), requested(std::chrono::steady_clock::now()), conn(acquire()) {
+         acquired = std::chrono::steady_clock::now();
+
+         if (RequestTrace *trace = RequestTrace::current())
+         {
+             RequestTrace::record(TracePhase::PoolWait, acquired - requested);
+             query_time_at_checkout = trace->total(TracePhase::Query);
+         }
     }
     ~ManagedConnection()
     {
         db.ReleaseConnection(std::move(conn));
+        const auto released = std::chrono::steady_clock::now();
+
+        // Time held but not spent executing statements went to converting rows.
+        if (RequestTrace *trace = RequestTrace::current())
+        {
+            const auto querying = trace->total(TracePhase::Query) - query_time_at_checkout;
+            RequestTrace::record(TracePhase::RowConversion, (released - acquired) - querying);
+        }
+
+        ConnectionUsage &usage = Database::threadConnectionUsage();
+        usage.pool_wait += std::chrono::duration_cast<std::chrono::microseconds>((acquired - requested) + replacement_wait);
+        usage.held += std::chrono::duration_cast<std::chrono::microseconds>(released - acquired);
+        ++usage.checkouts;
+    }
+
+    /**
+     * @brief Swap a connection that broke mid-query for a fresh one from the pool.
+     */
+    void replace()
+    {
+        db.ReleaseConnection(std::move(conn), true);
+        const auto start = std::chrono::steady_clock::now();
+        conn = acquire();
+        const auto waited = std::chrono::steady_clock::now() - start;
+
+        RequestTrace::record(TracePhase::PoolWait, waited);
+        replacement_wait += waited;
     }
 
     pqxx::connection& operator*() {
-        return *conn;
+        return *conn->connection;
     }
 
     pqxx::connection* operator->() {
-        return conn.get();
+        return conn->connection.get();
+    }
+
+    /**
+     * @brief Get the pool the connection was checked out from.
+     */
+    const ConnectionPool *pool() const {
+        return conn->pool;
     }
 
 private:
     Database &db;
-    std::unique_ptr<pqxx::connection> conn;
-};
\ No newline at end of file
+    std::function<std::unique_ptr<PooledConnection>()> acquire;
+    std::chrono::steady_clock::time_point requested;
+    std::chrono::steady_clock::time_point acquired;
+    std::chrono::steady_clock::duration query_time_at_checkout{};
+    std::chrono::steady_clock::duration replacement_wait{};
+    std::unique_ptr<PooledConnection> conn;
+};
+
+/**
+ * @brief Reads a height keyed table in ascending height order, one batch of heights per call.
+ *
+ * Keeps a pooled connection and a single transaction open until it is destroyed, so a streamed response can read it
+ * a batch at a time between writes. The export is bounded by the tip when the cursor was created, so a growing chain
+ * can't keep it running forever.
+ */
+class ExportCursor
+{
+public:
+    /**
+     * @brief Constructor for the ExportCursor class. Checks out a connection and reads the tip.
+     * @param db Database to export from.
+     * @param table Table name. Must be a trusted identifier, it is not quoted.
+     * @param orderBy ORDER BY clause used within each height range.
+     * @param fromHeight First block height to export.
+     * @param batchHeights Number of heights covered by each query.
+     */
+    ExportCursor(Database &db, const std::string &table, const std::string &orderBy, uint64_t fromHeight, uint64_t batchHeights);
+
+    ExportCursor(const ExportCursor &) = delete;
+    ExportCursor &operator=(const ExportCursor &) = delete;
+
+    /**
+     * @brief Read the next batch of heights.
+     * @param batch Receives the batch's rows, which may be none.
+     * @return False once every height up to the tip has been read.
+     */
+    bool next(std::vector<json> &batch);
+
+private:
+    ManagedConnection conn;
+    transaction tx;
+    std::string query;
+    std::optional<std::chrono::milliseconds> timeout; ///< Route timeout applied to each batch, if created within a request.
+    uint64_t next_height;
+    uint64_t tip_height{0};
+    uint64_t batch_heights;
+    bool exhausted{false};
+};
+
+/**
+ * @brief Reads the output of a COPY ... TO STDOUT started by Database::copyTableToCsv.
+ *
+ * Holds its export pool connection until the copy is read to the end, so a streamed response can read it between
+ * writes. A cursor destroyed early cancels the copy and returns the connection as broken, as the cancel may reach the
+ * server late.
+ */
+class CsvCopyCursor
+{
+public:
+    /**
+     * @brief Constructor for the CsvCopyCursor class.
+     * @param pool Pool the connection was acquired from.
+     * @param target Connection string it was acquired for.
+     * @param conn Connection in COPY OUT state.
+     */
+    CsvCopyCursor(CopyConnectionPool &pool, std::string target, CopyConnectionPool::Handle conn);
+
+    /**
+     * @brief Destructor for the CsvCopyCursor class. Cancels an unfinished copy.
+     */
+    ~CsvCopyCursor();
+
+    CsvCopyCursor(const CsvCopyCursor &) = delete;
+    CsvCopyCursor &operator=(const CsvCopyCursor &) = delete;
+
+    /**
+     * @brief Read COPY data until at least maxBytes have been appended or the copy ends.
+     * COPY hands over a row at a time, rows are gathered so writes stay few.
+     * @param part Receives the CSV data.
+     * @param maxBytes Size after which reading stops.
+     * @return False once the copy has been read to the end.
+     */
+    bool next(std::string &part, size_t maxBytes);
+
+private:
+    /**
+     * @brief Check the copy's final status and hand the connection back to the pool.
+     * @param failed Whether reading the COPY data already failed.
+     */
+    void finish(bool failed);
+
+    CopyConnectionPool &pool;
+    std::string target;
+    CopyConnectionPool::Handle conn;
+};
@@ -0,0 +1,222 @@
+#include "encoding.hpp"
+#include "chain_utils.hpp"
+#include <algorithm>
+#include <optional>
+#include <sstream>
+
+#ifndef ENCODING_CPP
+#define ENCODING_CPP
+
+namespace {
+
+struct MediaRange
+{
+    std::string type;
+    double quality;
+};
+
+std::string trim(const std::string &str)
+{
+    const auto begin = str.find_first_not_of(" \t");
+    if (begin == std::string::npos)
+    {
+        return "";
+    }
+
+    const auto end = str.find_last_not_of(" \t");
+    return str.substr(begin, end - begin + 1);
+}
+
+/**
+ * Splits an Accept header into media ranges with their q weights.
+ */
+std::vector<MediaRange> parseAcceptHeader(const std::string &accept)
+{
+    std::vector<MediaRange> ranges;
+    std::stringstream stream(accept);
+    std::string item;
+
+    while (std::getline(stream, item, ','))
+    {
+        std::stringstream params(item);
+        std::string param;
+        MediaRange range{"", 1.0};
+
+        std::getline(params, param, ';');
+        range.type = trim(param);
+        std::transform(range.type.begin(), range.type.end(), range.type.begin(), ::tolower);
+
+        while (std::getline(params, param, ';'))
+        {
+            param = trim(param);
+            if (param.rfind("q=", 0) == 0)
+            {
+                range.quality = std::strtod(param.c_str() + 2, nullptr);
+            }
+        }
+
+        if (!range.type.empty())
+        {
+            ranges.push_back(range);
+        }
+    }
+
+    return ranges;
+}
+
+}
+
+ResponseEncoding Encoding::negotiate(const crow::request &req)
+{
+    const std::string &accept = req.get_header_value("Accept");
+    if (accept.empty())
+    {
+        return ResponseEncoding::Json;
+    }
+
+    ResponseEncoding selected = ResponseEncoding::Json;
+    double selectedQuality = 0.0;
+    int selectedSpecificity = -1;
+
+    for (const MediaRange &range : parseAcceptHeader(accept))
+    {
+        // Wildcards stand for JSON, but an exact type at the same q is more specific and wins over them.
+        std::optional<ResponseEncoding> candidate;
+        int specificity = 2;
+        if (range.type == "*/*" || range.type == "application/*")
+        {
+            candidate = ResponseEncoding::Json;
+            specificity = range.type == "*/*" ? 0 : 1;
+        }
+        else if (range.type == "application/json")
+        {
+            candidate = ResponseEncoding::Json;
+        }
+        else if (range.type == "application/msgpack" || range.type == "application/x-msgpack" || range.type == "application/vnd.msgpack")
+        {
+            candidate = ResponseEncoding::MsgPack;
+        }
+        else if (range.type == "application/cbor")
+        {
+            candidate = ResponseEncoding::Cbor;
+        }
+
+        // Rank by q, then by specificity. Earlier entries win remaining ties, matching the order the client listed them in.
+        if (!candidate.has_value() || range.quality <= 0.0)
+        {
+            continue;
+        }
+        if (range.quality > selectedQuality || (range.quality == selectedQuality && specificity > selectedSpecificity))
+        {
+            selected = candidate.value();
+            selectedQuality = range.quality;
+            selectedSpecificity = specificity;
+        }
+    }
+
+    return selected;
+}
+
+bool Encoding::wantsNdjson(const crow::request &req)
+{
+    const char *format = req.url_params.get("format");
+    if (format != nullptr)
+    {
+        return std::string(format) == "ndjson";
+    }
+
+    for (const MediaRange &range : parseAcceptHeader(req.get_header_value("Accept")))
+    {
+        if ((range.type == "application/x-ndjson" || range.type == "application/ndjson") && range.quality > 0.0)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+std::string Encoding::contentType(ResponseEncoding encoding)
+{
+    switch (encoding)
+    {
+    case ResponseEncoding::MsgPack:
+        return "application/msgpack";
+    case ResponseEncoding::Cbor:
+        return "application/cbor";
+    case ResponseEncoding::Json:
+    default:
+        return "application/json";
+    }
+}
+
+std::string Encoding::encode(const json &body, ResponseEncoding encoding)
+{
+    if (encoding == ResponseEncoding::Json)
+    {
+        return body.dump();
+    }
+
+    // Single row lookups in the Database layer hand back the row already dumped to a string,
+    // so unwrap those into documents before producing a binary encoding.
+    json document = body;
+    if (body.is_string())
+    {
+        const std::string &text = body.get_ref<const std::string &>();
+        if (!text.empty() && (text.front() == '{' || text.front() == '['))
+        {
+            json parsed = json::parse(text, nullptr, false);
+            if (!parsed.is_discarded())
+            {
+                document = std::move(parsed);
+            }
+        }
+    }
+
+    document = compactHashes(document);
+
+    std::vector<uint8_t> bytes = encoding == ResponseEncoding::MsgPack
+                                     ? json::to_msgpack(document)
+                                     : json::to_cbor(document);
+
+    return std::string(bytes.begin(), bytes.end());
+}
+
+json Encoding::compactHashes(const json &value)
+{
+    if (value.is_string())
+    {
+        const std::string &text = value.get_ref<const std::string &>();
+        std::array<uint8_t, ZCASH_SHA256_HASH_BYTES> bytes;
+        if (decodeSHA256Hash(text, bytes))
+        {
+            return json::binary(std::vector<uint8_t>(bytes.begin(), bytes.end()));
+        }
+
+        return value;
+    }
+
+    if (value.is_object())
+    {
+        json converted = json::object();
+        for (auto it = value.begin(); it != value.end(); ++it)
+        {
+            converted[it.key()] = compactHashes(it.value());
+        }
+        return converted;
+    }
+
+    if (value.is_array())
+    {
+        json converted = json::array();
+        for (const auto &element : value)
+        {
+            converted.push_back(compactHashes(element));
+        }
+        return converted;
+    }
+
+    return value;
+}
+
+#endif // ENCODING_CPP
@@ -0,0 +1,69 @@
+#ifndef ENCODING_HPP
+#define ENCODING_HPP
+
+#include <string>
+#include "nlohmann/json.hpp"
+#include "../include/crow_all.h"
+
+using json = nlohmann::json;
+
+/**
+ * @brief Wire formats a response body can be serialized into.
+ */
+enum class ResponseEncoding
+{
+    Json,
+    MsgPack,
+    Cbor
+};
+
+/**
+ * @brief The Encoding class provides static helpers for Accept header negotiation and response serialization.
+ */
+class Encoding
+{
+public:
+    Encoding() = default;
+    ~Encoding() noexcept = default;
+
+    /**
+     * @brief Pick the response encoding from the request's Accept header.
+     * @param req Crow request object.
+     * @return The highest weighted supported encoding, or JSON if none of the binary types are acceptable.
+     */
+    static ResponseEncoding negotiate(const crow::request &req);
+
+    /**
+     * @brief Check whether the client asked for newline delimited JSON.
+     * Bulk routes honour either an `Accept: application/x-ndjson` header or a `?format=ndjson` query parameter.
+     * @param req Crow request object.
+     * @return True if NDJSON was requested.
+     */
+    static bool wantsNdjson(const crow::request &req);
+
+    /**
+     * @brief Get the Content-Type header value for an encoding.
+     * @param encoding Response encoding.
+     * @return MIME type string.
+     */
+    static std::string contentType(ResponseEncoding encoding);
+
+    /**
+     * @brief Serialize a JSON document with the given encoding.
+     * Binary encodings replace 64 character hex hashes with their 32 byte binary form.
+     * @param body JSON document to serialize.
+     * @param encoding Response encoding.
+     * @return Serialized response body.
+     */
+    static std::string encode(const json &body, ResponseEncoding encoding);
+
+private:
+    /**
+     * @brief Recursively convert hex encoded hashes within a document to binary values.
+     * @param value JSON value to convert.
+     * @return Converted copy of the value.
+     */
+    static json compactHashes(const json &value);
+};
+
+#endif // ENCODING_HPP
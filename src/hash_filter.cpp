@@ -0,0 +1,290 @@
+#include "hash_filter.hpp"
+#include "chain_snapshot.hpp"
+#include "hash_index.hpp"
+#include "db.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#ifndef HASH_FILTER_CPP
+#define HASH_FILTER_CPP
+
+namespace {
+
+constexpr uint64_t block_bits = 512;
+
+/**
+ * Reads 8 bytes of a hash. Block hashes lead with zero bytes in hex order, so only bytes from the 8th on are used.
+ */
+uint64_t hashWord(const std::array<uint8_t, 32> &hash, size_t word)
+{
+    uint64_t value = 0;
+    std::memcpy(&value, hash.data() + 8 * (word + 1), sizeof(value));
+    return value;
+}
+
+/**
+ * High 64 bits of the 128 bit product a * b.
+ */
+uint64_t mulHigh64(uint64_t a, uint64_t b)
+{
+#ifdef __SIZEOF_INT128__
+    __extension__ typedef unsigned __int128 uint128;
+    return static_cast<uint64_t>((static_cast<uint128>(a) * b) >> 64);
+#else
+    const uint64_t aLow = a & 0xffffffff, aHigh = a >> 32;
+    const uint64_t bLow = b & 0xffffffff, bHigh = b >> 32;
+    const uint64_t lowLow = aLow * bLow;
+    const uint64_t highLow = aHigh * bLow;
+    const uint64_t lowHigh = aLow * bHigh;
+    const uint64_t middle = (lowLow >> 32) + (highLow & 0xffffffff) + lowHigh;
+    return aHigh * bHigh + (highLow >> 32) + (middle >> 32);
+#endif
+}
+
+/**
+ * Calls probe(word, mask) for each of a hash's bits within its block, using double hashing.
+ */
+template <typename Probe>
+bool forEachBit(const std::array<uint8_t, 32> &hash, uint32_t hashCount, Probe probe)
+{
+    const uint64_t first = hashWord(hash, 1);
+    const uint64_t step = hashWord(hash, 2) | 1;
+    for (uint32_t i = 0; i < hashCount; ++i)
+    {
+        const uint64_t bit = (first + i * step) >> 55;
+        if (!probe(bit / 64, uint64_t(1) << (bit % 64)))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+}
+
+BloomFilter::BloomFilter(uint64_t capacity, uint32_t bitsPerEntry)
+    : block_count(std::max<uint64_t>(1, (capacity * bitsPerEntry + block_bits - 1) / block_bits)),
+      hash_count(std::clamp<uint32_t>(static_cast<uint32_t>(std::lround(bitsPerEntry * std::log(2.0))), 1, 16)),
+      blocks(new Block[block_count]())
+{
+}
+
+uint64_t BloomFilter::blockIndex(const std::array<uint8_t, 32> &hash) const noexcept
+{
+    // Maps the word onto [0, block_count) with a multiply rather than a division.
+    return mulHigh64(hashWord(hash, 0), block_count);
+}
+
+void BloomFilter::insert(const std::array<uint8_t, 32> &hash) noexcept
+{
+    Block &block = blocks[blockIndex(hash)];
+    uint64_t added = 0;
+    forEachBit(hash, hash_count, [&](uint64_t word, uint64_t mask)
+               {
+        if ((block.words[word].fetch_or(mask, std::memory_order_relaxed) & mask) == 0)
+        {
+            ++added;
+        }
+        return true; });
+
+    if (added > 0)
+    {
+        set_bits.fetch_add(added, std::memory_order_relaxed);
+    }
+}
+
+bool BloomFilter::mayContain(const std::array<uint8_t, 32> &hash) const noexcept
+{
+    const Block &block = blocks[blockIndex(hash)];
+    return forEachBit(hash, hash_count, [&](uint64_t word, uint64_t mask)
+                      { return (block.words[word].load(std::memory_order_relaxed) & mask) != 0; });
+}
+
+double BloomFilter::estimatedFalsePositiveRate() const noexcept
+{
+    const double fill = static_cast<double>(set_bits.load(std::memory_order_relaxed)) / static_cast<double>(block_count * block_bits);
+    return std::pow(fill, hash_count);
+}
+
+HashFilter::HashFilter(Database &database, Options options_)
+    : db(database), options(options_),
+      block_filter(options_.block_capacity, options_.bits_per_entry),
+      transaction_filter(options_.transaction_capacity, options_.bits_per_entry),
+      block_rate_gauge(Metrics::instance().gauge("zcash_api_hash_filter_estimated_false_positive_rate", "False positive rate of the hash filters estimated from their fill.", "filter=\"block\"")),
+      transaction_rate_gauge(Metrics::instance().gauge("zcash_api_hash_filter_estimated_false_positive_rate", "False positive rate of the hash filters estimated from their fill.", "filter=\"transaction\""))
+{
+    const char *kinds[] = {"block", "transaction", "any"};
+    for (size_t kind = 0; kind < 3; ++kind)
+    {
+        const std::string label = std::string("kind=\"") + kinds[kind] + "\",result=";
+        rejected[kind] = &Metrics::instance().counter("zcash_api_hash_filter_lookups_total", "Hash lookups checked against the hash filters.", label + "\"rejected\"");
+        passed[kind] = &Metrics::instance().counter("zcash_api_hash_filter_lookups_total", "Hash lookups checked against the hash filters.", label + "\"passed\"");
+        false_positives[kind] = &Metrics::instance().counter("zcash_api_hash_filter_lookups_total", "Hash lookups checked against the hash filters.", label + "\"false_positive\"");
+    }
+}
+
+HashFilter::~HashFilter() noexcept
+{
+    stop();
+}
+
+void HashFilter::attach(const ChainSnapshot &snapshot_)
+{
+    snapshot = &snapshot_;
+}
+
+void HashFilter::start()
+{
+    if (loader.joinable())
+    {
+        return;
+    }
+
+    loader = std::thread([this]
+                         {
+        std::unique_lock<std::mutex> lock(signal_mutex);
+        while (true)
+        {
+            signal.wait(lock, [this] { return stopping || wanted_tip.has_value(); });
+            if (stopping)
+            {
+                return;
+            }
+
+            const uint64_t tip = wanted_tip.value();
+            wanted_tip.reset();
+
+            lock.unlock();
+            load(tip);
+            lock.lock();
+        } });
+}
+
+void HashFilter::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(signal_mutex);
+        stopping = true;
+    }
+    signal.notify_all();
+
+    if (loader.joinable())
+    {
+        loader.join();
+    }
+}
+
+void HashFilter::extend(uint64_t tipHeight)
+{
+    {
+        std::lock_guard<std::mutex> lock(signal_mutex);
+        wanted_tip = std::max(wanted_tip.value_or(0), tipHeight);
+    }
+    caught_up.store(false, std::memory_order_release);
+    signal.notify_all();
+}
+
+bool HashFilter::stopRequested()
+{
+    std::lock_guard<std::mutex> lock(signal_mutex);
+    return stopping;
+}
+
+bool HashFilter::passes(const std::array<uint8_t, 32> &hash, Kind kind) const noexcept
+{
+    switch (kind)
+    {
+    case Kind::Block:
+        return block_filter.mayContain(hash);
+    case Kind::Transaction:
+        return transaction_filter.mayContain(hash);
+    default:
+        return block_filter.mayContain(hash) || transaction_filter.mayContain(hash);
+    }
+}
+
+bool HashFilter::mayContain(const std::array<uint8_t, 32> &hash, Kind kind) const noexcept
+{
+    const bool result = passes(hash, kind);
+    (result ? passed : rejected)[static_cast<size_t>(kind)]->increment();
+    return result;
+}
+
+void HashFilter::recordAbsent(const std::array<uint8_t, 32> &hash, Kind kind) const noexcept
+{
+    if (caughtUp() && passes(hash, kind))
+    {
+        false_positives[static_cast<size_t>(kind)]->increment();
+    }
+}
+
+bool HashFilter::caughtUp() const noexcept
+{
+    return caught_up.load(std::memory_order_acquire);
+}
+
+uint64_t HashFilter::size() const noexcept
+{
+    return covered.load(std::memory_order_acquire);
+}
+
+void HashFilter::load(uint64_t tipHeight)
+{
+    try
+    {
+        if (snapshot != nullptr && !seeded)
+        {
+            const HashIndexEntry *entries = snapshot->entries();
+            for (uint64_t i = 0; i < snapshot->entryCount(); ++i)
+            {
+                (entries[i].isBlock() ? block_filter : transaction_filter).insert(entries[i].hash);
+            }
+            seeded = true;
+            covered.store(snapshot->height(), std::memory_order_release);
+            updateGauges();
+        }
+
+        // Blocks near the top may have been replaced by a reorg since they were added.
+        const uint64_t top = size();
+        const uint64_t floor = snapshot != nullptr ? snapshot->height() : 0;
+        uint64_t from = std::max(top > options.reorg_depth ? top - options.reorg_depth : 0, floor);
+
+        std::vector<HashIndexEntry> batch;
+        while (from <= tipHeight)
+        {
+            if (stopRequested())
+            {
+                return;
+            }
+
+            const uint64_t to = std::min(from + options.load_batch, tipHeight + 1);
+            db.fetchHashIndexEntries(from, to, batch);
+            for (const HashIndexEntry &entry : batch)
+            {
+                (entry.isBlock() ? block_filter : transaction_filter).insert(entry.hash);
+            }
+
+            covered.store(std::max(size(), to), std::memory_order_release);
+            updateGauges();
+            from = to;
+        }
+
+        // A newer tip arrived during the load, rejections aren't definitive until that one is added too.
+        std::lock_guard<std::mutex> lock(signal_mutex);
+        caught_up.store(!wanted_tip.has_value(), std::memory_order_release);
+    }
+    catch (const std::exception &e)
+    {
+        CROW_LOG_ERROR << "Hash filter load failed at height " << size() << ": " << e.what();
+    }
+}
+
+void HashFilter::updateGauges() noexcept
+{
+    block_rate_gauge.set(block_filter.estimatedFalsePositiveRate());
+    transaction_rate_gauge.set(transaction_filter.estimatedFalsePositiveRate());
+}
+
+#endif // HASH_FILTER_CPP
@@ -0,0 +1,207 @@
+#ifndef HASH_FILTER_HPP
+#define HASH_FILTER_HPP
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include "metrics.hpp"
+
+class Database;
+class ChainSnapshot;
+
+/**
+ * @brief Blocked Bloom filter over 32 byte hashes. Safe to query while another thread inserts.
+ *
+ * Every hash maps to one 512 bit block, a single cache line, and sets its bits within it, so a lookup touches one
+ * line of memory. Hashes are uniformly distributed already and are used as their own hash functions.
+ */
+class BloomFilter
+{
+public:
+    /**
+     * @brief Constructor for the BloomFilter class.
+     * @param capacity Hashes the filter is sized for. More can be inserted at a higher false positive rate.
+     * @param bitsPerEntry Bits allocated per hash, about 10 for a 1% false positive rate.
+     */
+    BloomFilter(uint64_t capacity, uint32_t bitsPerEntry);
+
+    /**
+     * @brief Add a hash.
+     * @param hash 32 byte hash.
+     */
+    void insert(const std::array<uint8_t, 32> &hash) noexcept;
+
+    /**
+     * @brief Check a hash.
+     * @param hash 32 byte hash.
+     * @return False if the hash was never inserted, true if it probably was.
+     */
+    bool mayContain(const std::array<uint8_t, 32> &hash) const noexcept;
+
+    /**
+     * @brief Estimate the false positive rate from the share of bits set.
+     * @return Probability that a hash never inserted passes the filter.
+     */
+    double estimatedFalsePositiveRate() const noexcept;
+
+private:
+    struct alignas(64) Block
+    {
+        std::atomic<uint64_t> words[8];
+    };
+
+    uint64_t block_count;
+    uint32_t hash_count;
+    std::unique_ptr<Block[]> blocks;
+    std::atomic<uint64_t> set_bits{0};
+
+    uint64_t blockIndex(const std::array<uint8_t, 32> &hash) const noexcept;
+};
+
+/**
+ * @brief Bloom filters over every block hash and txid, so lookups for hashes that don't exist can be answered
+ * without a database query, at about a tenth of the hash index's memory.
+ *
+ * The filters are seeded from the chain snapshot, if one is attached, and the database on a background thread,
+ * then extended as the tip advances, re-reading the top heights to pick up reorged blocks. Bloom filters can't
+ * forget, so hashes reorged away stay in them; that only costs a query.
+ */
+class HashFilter
+{
+public:
+    /**
+     * @brief Which hashes a lookup accepts.
+     */
+    enum class Kind
+    {
+        Block,
+        Transaction,
+        Any
+    };
+
+    struct Options
+    {
+        uint64_t block_capacity;       ///< Block hashes the block filter is sized for.
+        uint64_t transaction_capacity; ///< Txids the transaction filter is sized for.
+        uint32_t bits_per_entry;       ///< Bits per hash in both filters.
+        uint64_t load_batch;           ///< Heights fetched per query.
+        uint64_t reorg_depth;          ///< Heights below the top re-read on every extension.
+    };
+
+    /**
+     * @brief Constructor for the HashFilter class. Allocates both filters.
+     * @param database Database to load hashes from.
+     * @param options Filter sizes and loading parameters.
+     */
+    HashFilter(Database &database, Options options);
+
+    /**
+     * @brief Destructor for the HashFilter class. Stops loading.
+     */
+    ~HashFilter() noexcept;
+
+    HashFilter(const HashFilter &) = delete;
+    HashFilter &operator=(const HashFilter &) = delete;
+
+    /**
+     * @brief Seed the filters from a chain snapshot rather than the database. Must be called before start().
+     * @param snapshot Snapshot outliving the filter.
+     */
+    void attach(const ChainSnapshot &snapshot);
+
+    /**
+     * @brief Start seeding and following the tip on a background thread.
+     */
+    void start();
+
+    /**
+     * @brief Stop loading and join the loader thread.
+     */
+    void stop();
+
+    /**
+     * @brief Ask the loader thread to add blocks up to a new tip. Doesn't wait for the load.
+     * @param tipHeight Height of the primary's tip.
+     */
+    void extend(uint64_t tipHeight);
+
+    /**
+     * @brief Check whether a hash may exist. Only meaningful once caughtUp().
+     * @param hash 32 byte hash.
+     * @param kind Filters to check.
+     * @return False if no hash of that kind exists, true if one probably does.
+     */
+    bool mayContain(const std::array<uint8_t, 32> &hash, Kind kind) const noexcept;
+
+    /**
+     * @brief Report a hash that turned out not to exist, counting it as a false positive if the filters passed it.
+     * @param hash 32 byte hash.
+     * @param kind Filters the lookup checked.
+     */
+    void recordAbsent(const std::array<uint8_t, 32> &hash, Kind kind) const noexcept;
+
+    /**
+     * @brief Check whether every block up to the latest tip the filter was asked for is in it, so a rejection is definitive.
+     * @return True if rejections are definitive.
+     */
+    bool caughtUp() const noexcept;
+
+    /**
+     * @brief Get the number of heights added.
+     * @return Heights covered, the filters hold [0, size()).
+     */
+    uint64_t size() const noexcept;
+
+private:
+    Database &db;
+    Options options;
+
+    const ChainSnapshot *snapshot{nullptr};
+    bool seeded{false};
+
+    BloomFilter block_filter;
+    BloomFilter transaction_filter;
+    std::atomic<uint64_t> covered{0};
+    std::atomic<bool> caught_up{false};
+
+    std::mutex signal_mutex;
+    std::condition_variable signal;
+    bool stopping{false};
+    std::optional<uint64_t> wanted_tip; ///< Tip the loader should catch up with next.
+    std::thread loader;
+
+    std::array<Counter *, 3> rejected;
+    std::array<Counter *, 3> passed;
+    std::array<Counter *, 3> false_positives;
+    Gauge &block_rate_gauge;
+    Gauge &transaction_rate_gauge;
+
+    /**
+     * @brief Check a hash without counting the lookup.
+     */
+    bool passes(const std::array<uint8_t, 32> &hash, Kind kind) const noexcept;
+
+    /**
+     * @brief Fetch and add blocks up to a tip. Runs on the loader thread.
+     * @param tipHeight Height to add up to, inclusive.
+     */
+    void load(uint64_t tipHeight);
+
+    /**
+     * @brief Check whether stop() was called.
+     * @return True once stopping.
+     */
+    bool stopRequested();
+
+    /**
+     * @brief Publish the filters' estimated false positive rates.
+     */
+    void updateGauges() noexcept;
+};
+
+#endif // HASH_FILTER_HPP
@@ -0,0 +1,452 @@
+#include "hash_index.hpp"
+#include "chain_snapshot.hpp"
+#include "db.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#ifndef HASH_INDEX_CPP
+#define HASH_INDEX_CPP
+
+namespace {
+
+static_assert(sizeof(HashIndexEntry) == 40, "Snapshot files store entries as laid out in memory.");
+
+constexpr char snapshot_magic[8] = {'Z', 'H', 'A', 'S', 'H', 'I', 'D', 'X'};
+constexpr uint32_t snapshot_version = 1;
+
+/**
+ * Header of a hash index snapshot file, followed by the sorted entries. Fields are in host byte order.
+ */
+struct SnapshotHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t entry_size;
+    uint64_t covered;
+    uint64_t count;
+};
+
+bool hashLess(const HashIndexEntry &a, const HashIndexEntry &b)
+{
+    return std::memcmp(a.hash.data(), b.hash.data(), a.hash.size()) < 0;
+}
+
+/**
+ * Reads the leading 8 bytes of a hash as a big endian integer, preserving the hashes' sort order.
+ */
+uint64_t leadingKey(const std::array<uint8_t, 32> &hash)
+{
+    uint64_t key = 0;
+    for (size_t i = 0; i < 8; ++i)
+    {
+        key = (key << 8) | hash[i];
+    }
+    return key;
+}
+
+/**
+ * Interpolation search over entries sorted by hash. Finishes with a binary search if the keys turn out to be skewed.
+ */
+const HashIndexEntry *interpolationFind(const HashIndexEntry *entries, size_t count, const std::array<uint8_t, 32> &hash)
+{
+    if (count == 0)
+    {
+        return nullptr;
+    }
+
+    const uint64_t target = leadingKey(hash);
+    size_t lo = 0;
+    size_t hi = count - 1;
+
+    for (int probes = 0; probes < 16 && lo <= hi; ++probes)
+    {
+        const uint64_t low = leadingKey(entries[lo].hash);
+        const uint64_t high = leadingKey(entries[hi].hash);
+        if (target < low || target > high)
+        {
+            return nullptr;
+        }
+
+        size_t pos = lo;
+        if (high != low)
+        {
+            pos += static_cast<size_t>(static_cast<long double>(target - low) / static_cast<long double>(high - low) * (hi - lo));
+        }
+
+        const int order = std::memcmp(entries[pos].hash.data(), hash.data(), hash.size());
+        if (order == 0)
+        {
+            return &entries[pos];
+        }
+        if (order < 0)
+        {
+            lo = pos + 1;
+        }
+        else if (pos == 0)
+        {
+            return nullptr;
+        }
+        else
+        {
+            hi = pos - 1;
+        }
+    }
+
+    if (lo > hi)
+    {
+        return nullptr;
+    }
+
+    HashIndexEntry probe{};
+    probe.hash = hash;
+    const HashIndexEntry *found = std::lower_bound(entries + lo, entries + hi + 1, probe, hashLess);
+    return found != entries + hi + 1 && found->hash == hash ? found : nullptr;
+}
+
+/**
+ * Checks whether an entry's hash starts with the first digits of a prefix.
+ */
+bool hasPrefix(const HashIndexEntry &entry, const std::array<uint8_t, 32> &prefix, size_t digits)
+{
+    const size_t whole = digits / 2;
+    if (std::memcmp(entry.hash.data(), prefix.data(), whole) != 0)
+    {
+        return false;
+    }
+    return digits % 2 == 0 || (entry.hash[whole] >> 4) == (prefix[whole] >> 4);
+}
+
+/**
+ * Appends the entries starting with a prefix, up to a limit, from entries sorted by hash. The zero padded prefix
+ * sorts no later than any hash it starts, so the matches begin at its lower bound.
+ */
+void collectPrefix(const HashIndexEntry *entries, size_t count, const std::array<uint8_t, 32> &prefix, size_t digits, size_t limit,
+                   std::vector<HashIndexEntry> &out)
+{
+    HashIndexEntry probe{};
+    probe.hash = prefix;
+    size_t taken = 0;
+    for (const HashIndexEntry *entry = std::lower_bound(entries, entries + count, probe, hashLess);
+         entry != entries + count && taken < limit && hasPrefix(*entry, prefix, digits); ++entry, ++taken)
+    {
+        out.push_back(*entry);
+    }
+}
+
+}
+
+HashIndex::HashIndex(Database &database, Options options_)
+    : db(database), options(std::move(options_)),
+      entries_gauge(Metrics::instance().gauge("zcash_api_hash_index_entries", "Block hashes and txids held by the in-memory hash index."))
+{
+}
+
+HashIndex::~HashIndex() noexcept
+{
+    stop();
+}
+
+void HashIndex::attach(const ChainSnapshot &snapshot_)
+{
+    std::unique_lock<std::shared_mutex> lock(index_mutex);
+    snapshot = &snapshot_;
+    covered.store(snapshot_.height(), std::memory_order_release);
+    entries_gauge.set(static_cast<double>(snapshot_.entryCount()));
+}
+
+void HashIndex::start()
+{
+    if (loader.joinable())
+    {
+        return;
+    }
+
+    // A chain snapshot already holds the bulk of the index, its own snapshot would duplicate it.
+    if (snapshot == nullptr && !options.snapshot_path.empty() && std::ifstream(options.snapshot_path).good())
+    {
+        try
+        {
+            loadSnapshot(options.snapshot_path);
+            CROW_LOG_INFO << "Hash index loaded " << size() << " heights from " << options.snapshot_path << ".";
+        }
+        catch (const std::exception &e)
+        {
+            CROW_LOG_ERROR << "Ignoring hash index snapshot " << options.snapshot_path << ": " << e.what();
+        }
+    }
+
+    loader = std::thread([this]
+                         {
+        std::unique_lock<std::mutex> lock(signal_mutex);
+        while (true)
+        {
+            signal.wait(lock, [this] { return stopping || wanted_tip.has_value(); });
+            if (stopping)
+            {
+                return;
+            }
+
+            const uint64_t tip = wanted_tip.value();
+            wanted_tip.reset();
+
+            lock.unlock();
+            load(tip);
+            lock.lock();
+        } });
+}
+
+void HashIndex::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(signal_mutex);
+        stopping = true;
+    }
+    signal.notify_all();
+
+    if (loader.joinable())
+    {
+        loader.join();
+    }
+}
+
+void HashIndex::extend(uint64_t tipHeight)
+{
+    {
+        std::lock_guard<std::mutex> lock(signal_mutex);
+        wanted_tip = std::max(wanted_tip.value_or(0), tipHeight);
+    }
+    caught_up.store(false, std::memory_order_release);
+    signal.notify_all();
+}
+
+bool HashIndex::stopRequested()
+{
+    std::lock_guard<std::mutex> lock(signal_mutex);
+    return stopping;
+}
+
+std::optional<HashIndexEntry> HashIndex::find(const std::array<uint8_t, 32> &hash) const
+{
+    std::shared_lock<std::shared_mutex> lock(index_mutex);
+
+    if (snapshot != nullptr)
+    {
+        if (const HashIndexEntry *entry = interpolationFind(snapshot->entries(), snapshot->entryCount(), hash))
+        {
+            return *entry;
+        }
+    }
+
+    if (const HashIndexEntry *entry = findOwnLocked(hash))
+    {
+        return *entry;
+    }
+
+    return std::nullopt;
+}
+
+std::vector<HashIndexEntry> HashIndex::findPrefix(const std::array<uint8_t, 32> &prefix, size_t digits, size_t limit) const
+{
+    std::vector<HashIndexEntry> matches;
+    {
+        std::shared_lock<std::shared_mutex> lock(index_mutex);
+        if (snapshot != nullptr)
+        {
+            collectPrefix(snapshot->entries(), snapshot->entryCount(), prefix, digits, limit, matches);
+        }
+        collectPrefix(sorted.data(), sorted.size(), prefix, digits, limit, matches);
+        collectPrefix(delta.data(), delta.size(), prefix, digits, limit, matches);
+    }
+
+    // Each source contributed its first matches, the overall first ones are among them.
+    std::sort(matches.begin(), matches.end(), hashLess);
+    if (matches.size() > limit)
+    {
+        matches.resize(limit);
+    }
+    return matches;
+}
+
+const HashIndexEntry *HashIndex::findOwnLocked(const std::array<uint8_t, 32> &hash) const
+{
+    if (const HashIndexEntry *entry = interpolationFind(sorted.data(), sorted.size(), hash))
+    {
+        return entry;
+    }
+
+    HashIndexEntry probe{};
+    probe.hash = hash;
+    const auto found = std::lower_bound(delta.begin(), delta.end(), probe, hashLess);
+    return found != delta.end() && found->hash == hash ? &*found : nullptr;
+}
+
+bool HashIndex::caughtUp() const noexcept
+{
+    return caught_up.load(std::memory_order_acquire);
+}
+
+uint64_t HashIndex::size() const noexcept
+{
+    return covered.load(std::memory_order_acquire);
+}
+
+void HashIndex::load(uint64_t tipHeight)
+{
+    try
+    {
+        // An empty index is built in one go, so it can be sorted once rather than merged batch by batch.
+        bool bulk = false;
+        {
+            std::shared_lock<std::shared_mutex> lock(index_mutex);
+            bulk = sorted.empty() && delta.empty();
+        }
+        std::vector<HashIndexEntry> pending;
+        std::vector<HashIndexEntry> batch;
+
+        // Blocks near the top may have been replaced by a reorg since they were indexed.
+        const uint64_t top = size();
+        const uint64_t floor = snapshot != nullptr ? snapshot->height() : 0;
+        uint64_t from = bulk ? top : std::max(top > options.reorg_depth ? top - options.reorg_depth : 0, floor);
+
+        while (from <= tipHeight)
+        {
+            if (stopRequested())
+            {
+                return;
+            }
+
+            const uint64_t to = std::min(from + options.load_batch, tipHeight + 1);
+            db.fetchHashIndexEntries(from, to, batch);
+
+            if (bulk)
+            {
+                pending.insert(pending.end(), batch.begin(), batch.end());
+            }
+            else
+            {
+                add(batch, to);
+            }
+
+            from = to;
+        }
+
+        if (bulk && !pending.empty())
+        {
+            add(pending, tipHeight + 1);
+            CROW_LOG_INFO << "Hash index built up to height " << tipHeight << ".";
+
+            if (snapshot == nullptr && !options.snapshot_path.empty())
+            {
+                writeSnapshot(options.snapshot_path);
+            }
+        }
+
+        // A newer tip arrived during the load, misses aren't definitive until that one is indexed too.
+        std::lock_guard<std::mutex> lock(signal_mutex);
+        caught_up.store(!wanted_tip.has_value(), std::memory_order_release);
+    }
+    catch (const std::exception &e)
+    {
+        CROW_LOG_ERROR << "Hash index load failed at height " << size() << ": " << e.what();
+    }
+}
+
+void HashIndex::add(std::vector<HashIndexEntry> &entries, uint64_t toHeight)
+{
+    std::sort(entries.begin(), entries.end(), hashLess);
+
+    std::unique_lock<std::shared_mutex> lock(index_mutex);
+
+    entries.erase(std::remove_if(entries.begin(), entries.end(), [this](const HashIndexEntry &entry)
+                                 { return findOwnLocked(entry.hash) != nullptr; }),
+                  entries.end());
+
+    std::vector<HashIndexEntry> &target = sorted.empty() ? sorted : delta;
+    std::vector<HashIndexEntry> merged;
+    merged.reserve(target.size() + entries.size());
+    std::merge(target.begin(), target.end(), entries.begin(), entries.end(), std::back_inserter(merged), hashLess);
+    target.swap(merged);
+
+    if (delta.size() >= options.merge_threshold)
+    {
+        merged.clear();
+        merged.reserve(sorted.size() + delta.size());
+        std::merge(sorted.begin(), sorted.end(), delta.begin(), delta.end(), std::back_inserter(merged), hashLess);
+        sorted.swap(merged);
+        delta.clear();
+    }
+
+    covered.store(std::max(covered.load(std::memory_order_relaxed), toHeight), std::memory_order_release);
+    entries_gauge.set(static_cast<double>(sorted.size() + delta.size() + (snapshot != nullptr ? snapshot->entryCount() : 0)));
+}
+
+void HashIndex::writeSnapshot(const std::string &path) const
+{
+    std::vector<HashIndexEntry> entries;
+    SnapshotHeader header{};
+    {
+        std::shared_lock<std::shared_mutex> lock(index_mutex);
+        entries.reserve(sorted.size() + delta.size());
+        std::merge(sorted.begin(), sorted.end(), delta.begin(), delta.end(), std::back_inserter(entries), hashLess);
+        header.covered = covered.load(std::memory_order_acquire);
+    }
+
+    std::memcpy(header.magic, snapshot_magic, sizeof(header.magic));
+    header.version = snapshot_version;
+    header.entry_size = sizeof(HashIndexEntry);
+    header.count = entries.size();
+
+    // Written beside the target and renamed over it, so a crash never leaves a truncated snapshot behind.
+    const std::string temporary = path + ".tmp";
+    {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char *>(entries.data()), static_cast<std::streamsize>(entries.size() * sizeof(HashIndexEntry)));
+        if (!out.flush())
+        {
+            throw std::runtime_error("Unable to write hash index snapshot " + temporary + ".");
+        }
+    }
+
+    if (std::rename(temporary.c_str(), path.c_str()) != 0)
+    {
+        throw std::runtime_error("Unable to replace hash index snapshot " + path + ".");
+    }
+}
+
+void HashIndex::loadSnapshot(const std::string &path)
+{
+    std::ifstream in(path, std::ios::binary);
+    SnapshotHeader header{};
+    if (!in.read(reinterpret_cast<char *>(&header), sizeof(header)))
+    {
+        throw std::runtime_error("Unable to read hash index snapshot " + path + ".");
+    }
+
+    if (std::memcmp(header.magic, snapshot_magic, sizeof(header.magic)) != 0 || header.version != snapshot_version ||
+        header.entry_size != sizeof(HashIndexEntry))
+    {
+        throw std::runtime_error(path + " is not a version " + std::to_string(snapshot_version) + " hash index snapshot.");
+    }
+
+    std::vector<HashIndexEntry> entries(header.count);
+    if (!in.read(reinterpret_cast<char *>(entries.data()), static_cast<std::streamsize>(entries.size() * sizeof(HashIndexEntry))))
+    {
+        throw std::runtime_error("Hash index snapshot " + path + " is truncated.");
+    }
+
+    if (!std::is_sorted(entries.begin(), entries.end(), hashLess))
+    {
+        throw std::runtime_error("Hash index snapshot " + path + " is not sorted.");
+    }
+
+    std::unique_lock<std::shared_mutex> lock(index_mutex);
+    sorted.swap(entries);
+    delta.clear();
+    covered.store(header.covered, std::memory_order_release);
+    entries_gauge.set(static_cast<double>(sorted.size()));
+}
+
+#endif // HASH_INDEX_CPP
@@ -0,0 +1,184 @@
+#ifndef HASH_INDEX_HPP
+#define HASH_INDEX_HPP
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "metrics.hpp"
+
+class Database;
+class ChainSnapshot;
+
+/**
+ * @brief One block hash or txid and where it lives in the chain. Written to snapshot files as is.
+ */
+struct HashIndexEntry
+{
+    static constexpr uint32_t block_marker = UINT32_MAX; ///< tx_index of a block hash.
+
+    std::array<uint8_t, 32> hash; ///< Hash in the byte order of its hex encoding.
+    uint32_t height;              ///< Height of the block, or of the block containing the transaction.
+    uint32_t tx_index;            ///< Position of the transaction within its block in txid order, or block_marker.
+
+    bool isBlock() const noexcept { return tx_index == block_marker; }
+};
+
+/**
+ * @brief Sorted in-memory index from every block hash and txid to its height, so hash lookups can be located,
+ * and misses answered, without a database query.
+ *
+ * Hashes are uniformly distributed, so lookups interpolate on the leading 8 bytes of the key instead of bisecting,
+ * taking a handful of probes over tens of millions of entries. The bulk of the index is one sorted array built by the
+ * initial load; blocks added at the tip go to a small sorted delta that is folded into the array once it grows large.
+ * The index is append-only: blocks reorged away keep their entries, which then point at heights the database no
+ * longer has them at, while their replacements are picked up by re-reading the top heights.
+ * The index is built from the database on a background thread, or from a snapshot file written by an earlier run.
+ * Hashes below an attached chain snapshot are looked up in the snapshot and never loaded.
+ */
+class HashIndex
+{
+public:
+    struct Options
+    {
+        uint64_t load_batch;         ///< Heights fetched per query.
+        uint64_t reorg_depth;        ///< Heights below the top re-read on every extension to pick up reorged blocks.
+        size_t merge_threshold;      ///< Delta entries that trigger folding the delta into the sorted array.
+        std::string snapshot_path;   ///< File loaded at startup if present and written after a full load. Empty disables.
+                                     ///< Unused when a chain snapshot is attached.
+    };
+
+    /**
+     * @brief Constructor for the HashIndex class.
+     * @param database Database to load hashes from.
+     * @param options Batch size, delta size and snapshot file.
+     */
+    HashIndex(Database &database, Options options);
+
+    /**
+     * @brief Destructor for the HashIndex class. Stops loading.
+     */
+    ~HashIndex() noexcept;
+
+    HashIndex(const HashIndex &) = delete;
+    HashIndex &operator=(const HashIndex &) = delete;
+
+    /**
+     * @brief Look up the hashes a chain snapshot covers in it. Must be called before start().
+     * @param snapshot Snapshot outliving the index.
+     */
+    void attach(const ChainSnapshot &snapshot);
+
+    /**
+     * @brief Load the snapshot file if there is one, then start following the tip on a background thread.
+     */
+    void start();
+
+    /**
+     * @brief Stop loading and join the loader thread.
+     */
+    void stop();
+
+    /**
+     * @brief Ask the loader thread to index blocks up to a new tip. Doesn't wait for the load.
+     * @param tipHeight Height of the primary's tip.
+     */
+    void extend(uint64_t tipHeight);
+
+    /**
+     * @brief Look a hash up.
+     * @param hash 32 byte hash.
+     * @return Where the hash lives, or std::nullopt if it isn't indexed.
+     */
+    std::optional<HashIndexEntry> find(const std::array<uint8_t, 32> &hash) const;
+
+    /**
+     * @brief List the hashes starting with a hex prefix, in hash order.
+     * @param prefix Prefix decoded into bytes, an odd last digit in the high half of its byte, padded with zeros.
+     * @param digits Number of hex digits in the prefix.
+     * @param limit Most hashes returned.
+     * @return The first matching entries.
+     */
+    std::vector<HashIndexEntry> findPrefix(const std::array<uint8_t, 32> &prefix, size_t digits, size_t limit) const;
+
+    /**
+     * @brief Check whether every block up to the latest tip the index was asked for is indexed,
+     * so a hash that isn't found doesn't exist.
+     * @return True if misses are definitive.
+     */
+    bool caughtUp() const noexcept;
+
+    /**
+     * @brief Get the number of heights indexed.
+     * @return Heights covered, the index holds [0, size()).
+     */
+    uint64_t size() const noexcept;
+
+    /**
+     * @brief Write the index to a snapshot file, replacing it atomically.
+     * @param path File to write.
+     * @throws std::runtime_error if the file can't be written.
+     */
+    void writeSnapshot(const std::string &path) const;
+
+    /**
+     * @brief Replace the index with the contents of a snapshot file.
+     * @param path File to read.
+     * @throws std::runtime_error if the file can't be read or isn't a hash index snapshot.
+     */
+    void loadSnapshot(const std::string &path);
+
+private:
+    Database &db;
+    Options options;
+
+    const ChainSnapshot *snapshot{nullptr};
+
+    mutable std::shared_mutex index_mutex;
+    std::vector<HashIndexEntry> sorted;  ///< Bulk of the index, sorted by hash.
+    std::vector<HashIndexEntry> delta;   ///< Entries added at the tip since the last fold, sorted by hash.
+    std::atomic<uint64_t> covered{0};
+    std::atomic<bool> caught_up{false};
+
+    std::mutex signal_mutex;
+    std::condition_variable signal;
+    bool stopping{false};
+    std::optional<uint64_t> wanted_tip; ///< Tip the loader should catch up with next.
+    std::thread loader;
+
+    Gauge &entries_gauge;
+
+    /**
+     * @brief Fetch and index blocks up to a tip. Runs on the loader thread.
+     * @param tipHeight Height to index up to, inclusive.
+     */
+    void load(uint64_t tipHeight);
+
+    /**
+     * @brief Check whether stop() was called.
+     * @return True once stopping.
+     */
+    bool stopRequested();
+
+    /**
+     * @brief Add entries for newly indexed heights. Entries whose hash is already indexed are skipped.
+     * @param entries Entries in any order.
+     * @param toHeight Height after the last one the entries cover.
+     */
+    void add(std::vector<HashIndexEntry> &entries, uint64_t toHeight);
+
+    /**
+     * @brief Look a hash up in the index's own entries. The index lock must be held.
+     * @param hash 32 byte hash.
+     * @return The entry, or nullptr if the hash isn't in the sorted array or the delta.
+     */
+    const HashIndexEntry *findOwnLocked(const std::array<uint8_t, 32> &hash) const;
+};
+
+#endif // HASH_INDEX_HPP
@@ -0,0 +1,163 @@
+#include "hedging.hpp"
+#include <algorithm>
+#include <vector>
+
+#ifndef HEDGING_CPP
+#define HEDGING_CPP
+
+namespace {
+
+/**
+ * Most unspent hedges carried over, so a quiet period can't bank a burst of hedges.
+ */
+constexpr double max_budget_tokens = 10.0;
+
+/**
+ * Samples recorded between p95 refreshes.
+ */
+constexpr uint32_t refresh_every = 32;
+
+}
+
+Hedger::Hedger(Options options_)
+    : options(options_),
+      hedges_sent(Metrics::instance().counter("zcash_api_hedged_reads_total", "Hedged point lookups by outcome.", "outcome=\"sent\"")),
+      hedges_won(Metrics::instance().counter("zcash_api_hedged_reads_total", "Hedged point lookups by outcome.", "outcome=\"won\"")),
+      budget_exhausted(Metrics::instance().counter("zcash_api_hedged_reads_total", "Hedged point lookups by outcome.", "outcome=\"budget_exhausted\""))
+{
+}
+
+std::optional<std::chrono::microseconds> Hedger::begin(const std::string &statement)
+{
+    std::lock_guard<std::mutex> lock(hedger_mutex);
+
+    budget_tokens = std::min(budget_tokens + options.budget_ratio, max_budget_tokens);
+
+    auto it = windows.find(statement);
+    if (it == windows.end() || it->second->count < options.min_samples)
+    {
+        return std::nullopt;
+    }
+
+    return std::max(std::chrono::microseconds(it->second->p95), options.min_delay);
+}
+
+void Hedger::record(const std::string &statement, std::chrono::microseconds latency)
+{
+    std::lock_guard<std::mutex> lock(hedger_mutex);
+
+    std::unique_ptr<LatencyWindow> &window = windows[statement];
+    if (!window)
+    {
+        window = std::make_unique<LatencyWindow>();
+    }
+
+    window->samples[window->next] = static_cast<uint32_t>(std::min<int64_t>(latency.count(), UINT32_MAX));
+    window->next = (window->next + 1) % LatencyWindow::capacity;
+    window->count = std::min(window->count + 1, LatencyWindow::capacity);
+
+    if (++window->since_refresh < refresh_every && window->p95 != 0)
+    {
+        return;
+    }
+    window->since_refresh = 0;
+
+    std::vector<uint32_t> sorted(window->samples.begin(), window->samples.begin() + window->count);
+    auto p95 = sorted.begin() + (sorted.size() * 95) / 100;
+    std::nth_element(sorted.begin(), p95, sorted.end());
+    window->p95 = *p95;
+}
+
+bool Hedger::tryHedge()
+{
+    std::lock_guard<std::mutex> lock(hedger_mutex);
+
+    if (budget_tokens < 1.0)
+    {
+        budget_exhausted.increment();
+        return false;
+    }
+
+    budget_tokens -= 1.0;
+    hedges_sent.increment();
+    return true;
+}
+
+HedgeExecutor::HedgeExecutor(size_t threads, size_t maxQueued)
+    : max_queued(maxQueued),
+      rejected(Metrics::instance().counter("zcash_api_hedged_reads_total", "Hedged point lookups by outcome.", "outcome=\"executor_full\""))
+{
+    for (size_t i = 0; i < std::max<size_t>(threads, 1); ++i)
+    {
+        workers.emplace_back(&HedgeExecutor::work, this);
+    }
+}
+
+HedgeExecutor::~HedgeExecutor() noexcept
+{
+    stop();
+}
+
+bool HedgeExecutor::submit(std::function<void()> task, clock::time_point due)
+{
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        if (stopping || tasks.size() >= max_queued)
+        {
+            rejected.increment();
+            return false;
+        }
+        tasks.emplace(due, std::move(task));
+    }
+    // Wakes a thread waiting for a later task, so it picks up this one if it is due sooner.
+    queued.notify_one();
+    return true;
+}
+
+void HedgeExecutor::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        stopping = true;
+        // Requests never wait for a hedge that hasn't started, so pending ones can be dropped.
+        tasks.clear();
+    }
+    queued.notify_all();
+
+    for (std::thread &worker : workers)
+    {
+        if (worker.joinable())
+        {
+            worker.join();
+        }
+    }
+}
+
+void HedgeExecutor::work()
+{
+    std::unique_lock<std::mutex> lock(queue_mutex);
+    while (!stopping)
+    {
+        if (tasks.empty())
+        {
+            queued.wait(lock);
+            continue;
+        }
+
+        const clock::time_point due = tasks.begin()->first;
+        if (due > clock::now())
+        {
+            queued.wait_until(lock, due);
+            continue;
+        }
+
+        std::function<void()> task = std::move(tasks.begin()->second);
+        tasks.erase(tasks.begin());
+
+        lock.unlock();
+        task();
+        lock.lock();
+    }
+}
+
+#endif // HEDGING_CPP
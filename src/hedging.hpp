@@ -0,0 +1,160 @@
+#ifndef HEDGING_HPP
+#define HEDGING_HPP
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+#include "metrics.hpp"
+
+/**
+ * @brief Decides when a point lookup should be hedged with a second copy on another replica.
+ *
+ * Tracks recent latencies per statement and hedges once a read has been outstanding for longer than
+ * that statement's p95. A token bucket caps hedges at a fixed share of reads.
+ */
+class Hedger
+{
+public:
+    struct Options
+    {
+        bool enabled;
+        double budget_ratio;                 ///< Hedges allowed per read, e.g. 0.05 for 5% extra load.
+        std::chrono::microseconds min_delay; ///< Shortest wait before hedging, however fast the p95.
+        uint32_t min_samples;                ///< Latency samples a statement needs before it is hedged.
+    };
+
+    /**
+     * @brief Constructor for the Hedger class.
+     * @param options Hedging tuning.
+     */
+    explicit Hedger(Options options);
+
+    /**
+     * @brief Destructor for the Hedger class.
+     */
+    ~Hedger() noexcept = default;
+
+    /**
+     * @brief Check whether hedging is turned on.
+     * @return True if reads may be hedged.
+     */
+    bool enabled() const noexcept { return options.enabled; }
+
+    /**
+     * @brief Count a hedgeable read towards the budget and get how long to wait before hedging it.
+     * @param statement Statement name.
+     * @return Delay before hedging, or std::nullopt if the statement doesn't have enough samples yet.
+     */
+    std::optional<std::chrono::microseconds> begin(const std::string &statement);
+
+    /**
+     * @brief Record how long a read took to answer.
+     * @param statement Statement name.
+     * @param latency Time from starting the read to its first answer.
+     */
+    void record(const std::string &statement, std::chrono::microseconds latency);
+
+    /**
+     * @brief Spend budget on a hedge.
+     * @return True if the budget allows another hedge.
+     */
+    bool tryHedge();
+
+    /**
+     * @brief Record that a hedge answered before the original read.
+     */
+    void hedgeWon() noexcept { hedges_won.increment(); }
+
+private:
+    /**
+     * @brief Ring of recent latencies with a periodically refreshed p95.
+     */
+    struct LatencyWindow
+    {
+        static constexpr size_t capacity = 512;
+
+        std::array<uint32_t, capacity> samples{};
+        size_t count{0};
+        size_t next{0};
+        uint32_t since_refresh{0};
+        uint32_t p95{0};
+    };
+
+    Options options;
+
+    std::mutex hedger_mutex;
+    std::map<std::string, std::unique_ptr<LatencyWindow>> windows;
+    double budget_tokens{0.0};
+
+    Counter &hedges_sent;
+    Counter &hedges_won;
+    Counter &budget_exhausted;
+};
+
+/**
+ * @brief Fixed set of threads the hedges of slow reads run on.
+ *
+ * A hedge is scheduled when its read starts and runs once the read has been slower than the hedge delay. Hedges can
+ * outlive the request that started them, so they run here rather than on detached threads. The queue is bounded, so a
+ * stalled database can't pile up hedges, and stop() joins every thread, so no hedge outlives its owner.
+ */
+class HedgeExecutor
+{
+public:
+    /**
+     * @brief Constructor for the HedgeExecutor class. Starts the threads.
+     * @param threads Number of threads, at least one.
+     * @param maxQueued Attempts that may wait for a free thread.
+     */
+    HedgeExecutor(size_t threads, size_t maxQueued);
+
+    /**
+     * @brief Destructor for the HedgeExecutor class. Stops the threads.
+     */
+    ~HedgeExecutor() noexcept;
+
+    HedgeExecutor(const HedgeExecutor &) = delete;
+    HedgeExecutor &operator=(const HedgeExecutor &) = delete;
+
+    using clock = std::chrono::steady_clock;
+
+    /**
+     * @brief Queue a task to run on one of the threads once it is due.
+     * @param task Task to run.
+     * @param due Earliest time the task may run.
+     * @return False if the queue is full or the executor is stopping, in which case the task will not run.
+     */
+    bool submit(std::function<void()> task, clock::time_point due);
+
+    /**
+     * @brief Stop accepting tasks, drop the ones not yet started and join the threads.
+     */
+    void stop();
+
+private:
+    /**
+     * @brief Thread body, running tasks as they fall due until stopped.
+     */
+    void work();
+
+    const size_t max_queued;
+
+    std::mutex queue_mutex;
+    std::condition_variable queued;
+    std::multimap<clock::time_point, std::function<void()>> tasks;
+    bool stopping{false};
+    std::vector<std::thread> workers;
+
+    Counter &rejected;
+};
+
+#endif // HEDGING_HPP
@@ -0,0 +1,94 @@
+#include "chain_utils.hpp"
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+
+/**
+ * Microbenchmark of hash validation and decoding.
+ *
+ * Usage: zcash-api-hex-benchmark [iterations]
+ *
+ * Decodes a set of random mixed case hashes with each hex decoder the CPU supports, checks they all agree, and
+ * reports the time per hash, along with the string and vector based path hashes used to take.
+ */
+int main(int argc, char *argv[])
+{
+    const size_t iterations = argc > 1 ? std::stoul(argv[1]) : 200;
+    const size_t hashCount = 4096;
+
+    std::mt19937_64 random(42);
+    const char digits[] = "0123456789abcdefABCDEF";
+    std::vector<std::string> hashes(hashCount, std::string(ZCASH_SHA256_HASH_LENGTH, '0'));
+    for (std::string &hash : hashes)
+    {
+        for (char &c : hash)
+        {
+            c = digits[random() % (sizeof(digits) - 1)];
+        }
+    }
+
+    std::vector<std::array<uint8_t, ZCASH_SHA256_HASH_BYTES>> expected(hashCount);
+    for (size_t i = 0; i < hashCount; ++i)
+    {
+        hexDecodeWith(HexDecoder::Scalar, hashes[i].data(), ZCASH_SHA256_HASH_BYTES, expected[i].data());
+    }
+
+    auto report = [&](const char *name, auto decodeAll)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        uint64_t sink = 0;
+        for (size_t iteration = 0; iteration < iterations; ++iteration)
+        {
+            sink += decodeAll();
+        }
+        const double nanoseconds = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        std::cout << std::left << std::setw(24) << name << std::fixed << std::setprecision(2)
+                  << nanoseconds / static_cast<double>(iterations * hashCount) << " ns/hash"
+                  << (sink == iterations * hashCount ? "" : "  MISMATCH") << std::endl;
+    };
+
+    const std::pair<HexDecoder, const char *> decoders[] = {{HexDecoder::Scalar, "scalar"}, {HexDecoder::SSE2, "sse2"}, {HexDecoder::AVX2, "avx2"}};
+    for (const auto &[decoder, name] : decoders)
+    {
+        if (!hexDecoderSupported(decoder))
+        {
+            std::cout << std::left << std::setw(24) << name << "unsupported" << std::endl;
+            continue;
+        }
+
+        report(name, [&, decoder = decoder]
+               {
+            uint64_t matches = 0;
+            std::array<uint8_t, ZCASH_SHA256_HASH_BYTES> bytes;
+            for (size_t i = 0; i < hashCount; ++i)
+            {
+                matches += hexDecodeWith(decoder, hashes[i].data(), bytes.size(), bytes.data()) && bytes == expected[i];
+            }
+            return matches; });
+    }
+
+    report("decodeSHA256Hash", [&]
+           {
+        uint64_t matches = 0;
+        std::array<uint8_t, ZCASH_SHA256_HASH_BYTES> bytes;
+        for (size_t i = 0; i < hashCount; ++i)
+        {
+            matches += decodeSHA256Hash(hashes[i], bytes) && bytes == expected[i];
+        }
+        return matches; });
+
+    report("hexToBytes", [&]
+           {
+        uint64_t matches = 0;
+        std::vector<uint8_t> bytes;
+        for (size_t i = 0; i < hashCount; ++i)
+        {
+            matches += isValidSHA256Hash(hashes[i]) && hexToBytes(hashes[i], bytes) &&
+                       std::memcmp(bytes.data(), expected[i].data(), bytes.size()) == 0;
+        }
+        return matches; });
+
+    return 0;
+}
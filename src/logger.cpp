@@ -0,0 +1,196 @@
+#include "logger.hpp"
+#include "nlohmann/json.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <ctime>
+
+#ifndef LOGGER_CPP
+#define LOGGER_CPP
+
+namespace {
+
+const char *severityName(crow::LogLevel level)
+{
+    switch (level)
+    {
+    case crow::LogLevel::Debug:
+        return "DEBUG";
+    case crow::LogLevel::Info:
+        return "INFO";
+    case crow::LogLevel::Warning:
+        return "WARNING";
+    case crow::LogLevel::Error:
+        return "ERROR";
+    case crow::LogLevel::Critical:
+    default:
+        return "CRITICAL";
+    }
+}
+
+/**
+ * Formats a time point as an RFC 3339 UTC timestamp with microsecond precision.
+ */
+std::string rfc3339(std::chrono::system_clock::time_point time)
+{
+    const std::time_t seconds = std::chrono::system_clock::to_time_t(time);
+    const auto micros = std::chrono::duration_cast<std::chrono::microseconds>(time.time_since_epoch()).count() % 1000000;
+
+    std::tm utc;
+    gmtime_r(&seconds, &utc);
+
+    char buffer[40];
+    const size_t length = std::strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%S", &utc);
+    std::snprintf(buffer + length, sizeof(buffer) - length, ".%06lldZ", static_cast<long long>(micros));
+    return buffer;
+}
+
+}
+
+AsyncLogHandler::AsyncLogHandler(std::chrono::milliseconds flushInterval)
+    : flush_interval(flushInterval)
+{
+    flusher = std::thread([this]
+                          {
+        std::unique_lock<std::mutex> lock(flush_mutex);
+        while (!stopping)
+        {
+            flush_signal.wait_for(lock, flush_interval, [this] { return stopping; });
+            lock.unlock();
+            flush();
+            lock.lock();
+        } });
+}
+
+AsyncLogHandler::~AsyncLogHandler() noexcept
+{
+    {
+        std::lock_guard<std::mutex> lock(flush_mutex);
+        stopping = true;
+    }
+    flush_signal.notify_one();
+    flusher.join();
+    flush();
+}
+
+void AsyncLogHandler::log(std::string message, crow::LogLevel level)
+{
+    ThreadBuffer &buffer = threadBuffer();
+    const size_t tail = buffer.tail.load(std::memory_order_relaxed);
+
+    if (tail - buffer.head.load(std::memory_order_acquire) >= ThreadBuffer::capacity)
+    {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    Entry &entry = buffer.entries[tail % ThreadBuffer::capacity];
+    entry.time = std::chrono::system_clock::now();
+    entry.level = level;
+    entry.message = std::move(message);
+    buffer.tail.store(tail + 1, std::memory_order_release);
+}
+
+crow::LogLevel AsyncLogHandler::parseLevel(const std::string &name)
+{
+    std::string lower = name;
+    std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+
+    if (lower == "debug")
+        return crow::LogLevel::Debug;
+    if (lower == "warning")
+        return crow::LogLevel::Warning;
+    if (lower == "error")
+        return crow::LogLevel::Error;
+    if (lower == "critical")
+        return crow::LogLevel::Critical;
+
+    return crow::LogLevel::Info;
+}
+
+AsyncLogHandler::ThreadBuffer &AsyncLogHandler::threadBuffer()
+{
+    // Buffers are shared with the registry so entries logged just before a thread exits still get flushed.
+    thread_local std::shared_ptr<ThreadBuffer> buffer;
+    thread_local AsyncLogHandler *owner = nullptr;
+
+    if (!buffer || owner != this)
+    {
+        buffer = std::make_shared<ThreadBuffer>();
+        owner = this;
+
+        std::lock_guard<std::mutex> lock(buffers_mutex);
+        buffers.push_back(buffer);
+    }
+
+    return *buffer;
+}
+
+void AsyncLogHandler::flush()
+{
+    std::vector<Entry> pending;
+    {
+        std::lock_guard<std::mutex> lock(buffers_mutex);
+        for (const auto &buffer : buffers)
+        {
+            const size_t tail = buffer->tail.load(std::memory_order_acquire);
+            size_t head = buffer->head.load(std::memory_order_relaxed);
+
+            for (; head != tail; ++head)
+            {
+                pending.push_back(std::move(buffer->entries[head % ThreadBuffer::capacity]));
+            }
+            buffer->head.store(head, std::memory_order_release);
+        }
+
+        // Only the registry still references buffers of threads that have exited, and they are drained now.
+        buffers.erase(std::remove_if(buffers.begin(), buffers.end(), [](const std::shared_ptr<ThreadBuffer> &buffer)
+                                     { return buffer.use_count() == 1; }),
+                      buffers.end());
+    }
+
+    const uint64_t droppedCount = dropped.exchange(0, std::memory_order_relaxed);
+    if (droppedCount > 0)
+    {
+        pending.push_back(Entry{std::chrono::system_clock::now(), crow::LogLevel::Warning,
+                                "Dropped " + std::to_string(droppedCount) + " log entries, thread buffers were full."});
+    }
+
+    if (pending.empty())
+    {
+        return;
+    }
+
+    std::stable_sort(pending.begin(), pending.end(), [](const Entry &a, const Entry &b)
+                     { return a.time < b.time; });
+
+    std::string output;
+    for (const Entry &entry : pending)
+    {
+        output += formatEntry(entry);
+        output += '\n';
+    }
+
+    std::fwrite(output.data(), 1, output.size(), stdout);
+    std::fflush(stdout);
+}
+
+std::string AsyncLogHandler::formatEntry(const Entry &entry)
+{
+    // Messages that are already JSON objects, such as the slow request log, become structured payloads.
+    nlohmann::json line;
+    if (!entry.message.empty() && entry.message.front() == '{')
+    {
+        line = nlohmann::json::parse(entry.message, nullptr, false);
+    }
+    if (!line.is_object())
+    {
+        line = nlohmann::json{{"message", entry.message}};
+    }
+
+    line["severity"] = severityName(entry.level);
+    line["time"] = rfc3339(entry.time);
+
+    return line.dump(-1, ' ', false, nlohmann::json::error_handler_t::replace);
+}
+
+#endif // LOGGER_CPP
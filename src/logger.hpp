@@ -0,0 +1,99 @@
+#ifndef LOGGER_HPP
+#define LOGGER_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../include/crow_all.h"
+
+/**
+ * @brief Crow log handler that moves log I/O off request threads.
+ *
+ * Each thread appends entries to its own fixed size ring buffer without taking a lock. A background
+ * thread drains every ring on a fixed interval, formats the entries as JSON lines understood by
+ * Cloud Logging and writes them to stdout in one batch. When a ring is full new entries are
+ * dropped and counted rather than blocking the request thread.
+ */
+class AsyncLogHandler : public crow::ILogHandler
+{
+public:
+    /**
+     * @brief Constructor for the AsyncLogHandler class. Starts the flush thread.
+     * @param flushInterval Time between drains of the thread buffers.
+     */
+    explicit AsyncLogHandler(std::chrono::milliseconds flushInterval);
+
+    /**
+     * @brief Destructor for the AsyncLogHandler class. Stops the flush thread after a final drain.
+     */
+    ~AsyncLogHandler() noexcept override;
+
+    AsyncLogHandler(const AsyncLogHandler &) = delete;
+    AsyncLogHandler &operator=(const AsyncLogHandler &) = delete;
+
+    void log(std::string message, crow::LogLevel level) override;
+
+    /**
+     * @brief Parse a log level name as used by the LOG_LEVEL setting.
+     * @param name Level name, case insensitive (debug, info, warning, error, critical).
+     * @return Parsed level, or Info for unknown names.
+     */
+    static crow::LogLevel parseLevel(const std::string &name);
+
+private:
+    struct Entry
+    {
+        std::chrono::system_clock::time_point time;
+        crow::LogLevel level;
+        std::string message;
+    };
+
+    /**
+     * @brief Single producer, single consumer ring owned by one logging thread.
+     */
+    struct ThreadBuffer
+    {
+        static constexpr size_t capacity = 1024;
+
+        std::array<Entry, capacity> entries;
+        std::atomic<size_t> head{0}; ///< Next slot to read, advanced by the flush thread.
+        std::atomic<size_t> tail{0}; ///< Next slot to write, advanced by the owning thread.
+    };
+
+    std::chrono::milliseconds flush_interval;
+    std::mutex buffers_mutex;
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+    std::atomic<uint64_t> dropped{0};
+
+    std::mutex flush_mutex;
+    std::condition_variable flush_signal;
+    bool stopping{false};
+    std::thread flusher;
+
+    /**
+     * @brief Get the calling thread's buffer, registering it on first use.
+     * @return Thread buffer.
+     */
+    ThreadBuffer &threadBuffer();
+
+    /**
+     * @brief Drain all thread buffers and write the formatted lines to stdout.
+     */
+    void flush();
+
+    /**
+     * @brief Format an entry as a Cloud Logging JSON line.
+     * @param entry Entry to format.
+     * @return JSON line without trailing newline.
+     */
+    static std::string formatEntry(const Entry &entry);
+};
+
+#endif // LOGGER_HPP
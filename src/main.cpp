@@ -1,14 +1,19 @@
 #include "routes.hpp"
 #include "../include/crow_all.h"
 #include "config.h"
+#include "logger.hpp"
 #include <sstream>
 #include <future>
 
 int main() {
+    // Log through a background writer so log I/O stays off request threads.
+    AsyncLogHandler logHandler(std::chrono::milliseconds(std::stoul(Config::getLogFlushIntervalMs())));
+    crow::logger::setHandler(&logHandler);
+
     try {
         Database database;
         ZCashApi api(database);
-        crow::App<crow::CORSHandler> app;
+        ZCashApp app;
 
         // Establish api port
         uint16_t api_port = std::stoi(Config::getApiPort());
@@ -17,12 +22,13 @@ int main() {
         api.init(app, Config::getDatabaseName(), Config::getDatabaseUser(), Config::getDatabasePassword(), Config::getDatabaseHost(), Config::getDatabasePort());
         
         // Set log level
-        app.loglevel(crow::LogLevel::DEBUG);
+        app.loglevel(AsyncLogHandler::parseLevel(Config::getLogLevel()));
 
         // Run api with multithreading
         app.port(api_port).multithreaded().run();
 
     } catch (const std::exception &e) {
+        CROW_LOG_CRITICAL << e.what();
         return 1;
     }
 
@@ -0,0 +1,74 @@
+#include "metrics.hpp"
+#include <sstream>
+
+#ifndef METRICS_CPP
+#define METRICS_CPP
+
+void Gauge::add(double delta) noexcept
+{
+    double expected = current.load(std::memory_order_relaxed);
+    while (!current.compare_exchange_weak(expected, expected + delta, std::memory_order_relaxed))
+    {
+    }
+}
+
+Metrics &Metrics::instance()
+{
+    static Metrics metrics;
+    return metrics;
+}
+
+Counter &Metrics::counter(const std::string &name, const std::string &help, const std::string &labels)
+{
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    Family &family = families[name];
+    family.help = help;
+    family.type = "counter";
+
+    auto &counter = family.counters[labels];
+    if (!counter)
+    {
+        counter = std::make_unique<Counter>();
+    }
+    return *counter;
+}
+
+Gauge &Metrics::gauge(const std::string &name, const std::string &help, const std::string &labels)
+{
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    Family &family = families[name];
+    family.help = help;
+    family.type = "gauge";
+
+    auto &gauge = family.gauges[labels];
+    if (!gauge)
+    {
+        gauge = std::make_unique<Gauge>();
+    }
+    return *gauge;
+}
+
+std::string Metrics::render()
+{
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    std::ostringstream out;
+
+    for (const auto &[name, family] : families)
+    {
+        out << "# HELP " << name << " " << family.help << "\n";
+        out << "# TYPE " << name << " " << family.type << "\n";
+
+        for (const auto &[labels, counter] : family.counters)
+        {
+            out << name << (labels.empty() ? "" : "{" + labels + "}") << " " << counter->value() << "\n";
+        }
+        for (const auto &[labels, gauge] : family.gauges)
+        {
+            out << name << (labels.empty() ? "" : "{" + labels + "}") << " " << gauge->value() << "\n";
+        }
+    }
+
+    return out.str();
+}
+
+#endif // METRICS_CPP
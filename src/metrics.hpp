@@ -0,0 +1,90 @@
+#ifndef METRICS_HPP
+#define METRICS_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+/**
+ * @brief Monotonically increasing metric.
+ */
+class Counter
+{
+public:
+    void increment(uint64_t by = 1) noexcept { count.fetch_add(by, std::memory_order_relaxed); }
+    uint64_t value() const noexcept { return count.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> count{0};
+};
+
+/**
+ * @brief Metric holding a current value that can go up and down.
+ */
+class Gauge
+{
+public:
+    void set(double value) noexcept { current.store(value, std::memory_order_relaxed); }
+    void add(double delta) noexcept;
+    double value() const noexcept { return current.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<double> current{0.0};
+};
+
+/**
+ * @brief Process wide metric registry rendered in the Prometheus text exposition format.
+ * Metrics are registered once and live for the lifetime of the process, so callers may cache the returned references.
+ */
+class Metrics
+{
+public:
+    /**
+     * @brief Get the process wide registry.
+     * @return Metrics registry.
+     */
+    static Metrics &instance();
+
+    /**
+     * @brief Get or register a counter.
+     * @param name Metric name.
+     * @param help Description shown in the exposition output.
+     * @param labels Optional Prometheus label set without braces, e.g. `route="/blocks"`.
+     * @return Counter registered under the name and labels.
+     */
+    Counter &counter(const std::string &name, const std::string &help, const std::string &labels = "");
+
+    /**
+     * @brief Get or register a gauge.
+     * @param name Metric name.
+     * @param help Description shown in the exposition output.
+     * @param labels Optional Prometheus label set without braces.
+     * @return Gauge registered under the name and labels.
+     */
+    Gauge &gauge(const std::string &name, const std::string &help, const std::string &labels = "");
+
+    /**
+     * @brief Render every registered metric in the Prometheus text format.
+     * @return Exposition text.
+     */
+    std::string render();
+
+private:
+    Metrics() = default;
+
+    struct Family
+    {
+        std::string help;
+        std::string type;
+        std::map<std::string, std::unique_ptr<Counter>> counters;
+        std::map<std::string, std::unique_ptr<Gauge>> gauges;
+    };
+
+    std::mutex registry_mutex;
+    std::map<std::string, Family> families;
+};
+
+#endif // METRICS_HPP
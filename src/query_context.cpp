@@ -0,0 +1,128 @@
+#include "query_context.hpp"
+#include "../include/crow_all.h"
+#include <stdexcept>
+#include <string>
+
+#ifndef QUERY_CONTEXT_CPP
+#define QUERY_CONTEXT_CPP
+
+thread_local QueryContext *QueryContext::active = nullptr;
+
+QueryContext::QueryContext(std::chrono::milliseconds timeout, std::function<bool()> clientAlive)
+    : route_timeout(timeout), request_deadline(clock::now() + timeout), client_alive(std::move(clientAlive)), previous(active)
+{
+    active = this;
+}
+
+QueryContext::~QueryContext() noexcept
+{
+    active = previous;
+}
+
+int64_t QueryContext::remainingMs(clock::time_point deadline)
+{
+    const auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - clock::now()).count();
+    if (remaining <= 0)
+    {
+        throw std::runtime_error("Request deadline exceeded before the query could start.");
+    }
+    return remaining;
+}
+
+void QueryContext::applyStatementTimeout(pqxx::transaction_base &tx, clock::time_point deadline)
+{
+    // SET LOCAL only lasts until the transaction ends, so the pooled connection keeps its default afterwards.
+    tx.exec("SET LOCAL statement_timeout = " + std::to_string(remainingMs(deadline)));
+}
+
+QueryWatchdog::Watch::Watch(QueryWatchdog *watchdog_, pqxx::connection &connection)
+    : watchdog(nullptr)
+{
+    const QueryContext *context = QueryContext::current();
+    if (watchdog_ == nullptr || context == nullptr)
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(watchdog_->watch_mutex);
+    entry = watchdog_->watched.insert(watchdog_->watched.end(), WatchedQuery{&connection, context, false});
+    watchdog = watchdog_;
+}
+
+QueryWatchdog::Watch::~Watch() noexcept
+{
+    if (watchdog == nullptr)
+    {
+        return;
+    }
+
+    // Blocks while a cancel is in flight, so the connection can't be released to its next user under it.
+    std::lock_guard<std::mutex> lock(watchdog->watch_mutex);
+    watchdog->watched.erase(entry);
+}
+
+QueryWatchdog::QueryWatchdog()
+    : disconnect_cancels(Metrics::instance().counter("zcash_api_queries_cancelled_total", "Running queries cancelled by the API.", "reason=\"client_disconnect\""))
+{
+}
+
+QueryWatchdog::~QueryWatchdog() noexcept
+{
+    stop();
+}
+
+void QueryWatchdog::start(std::chrono::milliseconds interval)
+{
+    if (checker.joinable())
+    {
+        return;
+    }
+
+    stopping = false;
+    checker = std::thread([this, interval]
+                          {
+        std::unique_lock<std::mutex> lock(watch_mutex);
+        while (!stop_signal.wait_for(lock, interval, [this] { return stopping; }))
+        {
+            checkLocked();
+        } });
+}
+
+void QueryWatchdog::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(watch_mutex);
+        stopping = true;
+    }
+    stop_signal.notify_all();
+
+    if (checker.joinable())
+    {
+        checker.join();
+    }
+}
+
+void QueryWatchdog::checkLocked()
+{
+    for (WatchedQuery &query : watched)
+    {
+        if (query.cancelled || query.context->clientAlive())
+        {
+            continue;
+        }
+
+        query.cancelled = true;
+        try
+        {
+            query.connection->cancel_query();
+            disconnect_cancels.increment();
+            CROW_LOG_INFO << "Cancelled a query whose client disconnected.";
+        }
+        catch (const std::exception &e)
+        {
+            CROW_LOG_WARNING << "Cancelling a query whose client disconnected failed: " << e.what();
+        }
+    }
+}
+
+#endif // QUERY_CONTEXT_CPP
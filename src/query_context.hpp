@@ -0,0 +1,164 @@
+#ifndef QUERY_CONTEXT_HPP
+#define QUERY_CONTEXT_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <pqxx/pqxx>
+#include "metrics.hpp"
+
+/**
+ * @brief Deadline and client liveness of the HTTP request the current thread is querying for.
+ * Installed for the duration of a handler, queries read it to bound and cancel themselves.
+ */
+class QueryContext
+{
+public:
+    using clock = std::chrono::steady_clock;
+
+    /**
+     * @brief Constructor for the QueryContext class. Makes the context current on this thread.
+     * @param timeout Time the request's queries have to finish, counted from now.
+     * @param clientAlive Reports whether the client is still connected. Called from the watchdog thread.
+     */
+    QueryContext(std::chrono::milliseconds timeout, std::function<bool()> clientAlive);
+
+    /**
+     * @brief Destructor for the QueryContext class. Restores the previously current context.
+     */
+    ~QueryContext() noexcept;
+
+    QueryContext(const QueryContext &) = delete;
+    QueryContext &operator=(const QueryContext &) = delete;
+
+    /**
+     * @brief Get the context of the request running on this thread.
+     * @return The context, or nullptr outside a request.
+     */
+    static QueryContext *current() noexcept { return active; }
+
+    /**
+     * @brief Get the request's deadline.
+     * @return Deadline.
+     */
+    clock::time_point deadline() const noexcept { return request_deadline; }
+
+    /**
+     * @brief Get the route's timeout, used to bound each batch of a long running export on its own.
+     * @return Timeout.
+     */
+    std::chrono::milliseconds timeout() const noexcept { return route_timeout; }
+
+    /**
+     * @brief Check whether the client is still connected.
+     * @return False once the client has gone away.
+     */
+    bool clientAlive() const { return !client_alive || client_alive(); }
+
+    /**
+     * @brief Bound the statements of a transaction by the time left before a deadline.
+     * @param tx Transaction to run `SET LOCAL statement_timeout` in.
+     * @param deadline Deadline to bound by.
+     * @throws std::runtime_error if the deadline has already passed.
+     */
+    static void applyStatementTimeout(pqxx::transaction_base &tx, clock::time_point deadline);
+
+    /**
+     * @brief Get the milliseconds left before a deadline, for use as a statement_timeout.
+     * @param deadline Deadline.
+     * @return Milliseconds left, at least 1.
+     * @throws std::runtime_error if the deadline has already passed.
+     */
+    static int64_t remainingMs(clock::time_point deadline);
+
+private:
+    static thread_local QueryContext *active;
+
+    std::chrono::milliseconds route_timeout;
+    clock::time_point request_deadline;
+    std::function<bool()> client_alive;
+    QueryContext *previous;
+};
+
+/**
+ * @brief Background thread cancelling running queries whose client has disconnected,
+ * so abandoned requests hand their connections back to the pool straight away.
+ */
+class QueryWatchdog
+{
+    struct WatchedQuery
+    {
+        pqxx::connection *connection;
+        const QueryContext *context;
+        bool cancelled;
+    };
+
+public:
+    /**
+     * @brief RAII registration of a running query. Once destroyed, the watchdog no longer touches the connection.
+     */
+    class Watch
+    {
+    public:
+        /**
+         * @brief Watch a query running on a connection for the current thread's request.
+         * Does nothing outside a request.
+         * @param watchdog Watchdog to register with, or nullptr to watch nothing.
+         * @param connection Connection the query runs on.
+         */
+        Watch(QueryWatchdog *watchdog, pqxx::connection &connection);
+
+        /**
+         * @brief Destructor for the Watch class. Unregisters the query.
+         */
+        ~Watch() noexcept;
+
+        Watch(const Watch &) = delete;
+        Watch &operator=(const Watch &) = delete;
+
+    private:
+        QueryWatchdog *watchdog;
+        std::list<WatchedQuery>::iterator entry;
+    };
+
+    /**
+     * @brief Constructor for the QueryWatchdog class.
+     */
+    QueryWatchdog();
+
+    /**
+     * @brief Destructor for the QueryWatchdog class. Stops the background thread.
+     */
+    ~QueryWatchdog() noexcept;
+
+    /**
+     * @brief Start checking running queries.
+     * @param interval Time between checks.
+     */
+    void start(std::chrono::milliseconds interval);
+
+    /**
+     * @brief Stop the background thread.
+     */
+    void stop();
+
+private:
+    std::mutex watch_mutex;
+    std::condition_variable stop_signal;
+    std::list<WatchedQuery> watched;
+    bool stopping{false};
+    std::thread checker;
+
+    Counter &disconnect_cancels;
+
+    /**
+     * @brief Cancel watched queries whose client is gone. Called with watch_mutex held.
+     */
+    void checkLocked();
+};
+
+#endif // QUERY_CONTEXT_HPP
@@ -0,0 +1,226 @@
+#include "rate_limiter.hpp"
+#include "config.h"
+#include "metrics.hpp"
+#include "nlohmann/json.hpp"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
+#ifndef RATE_LIMITER_CPP
+#define RATE_LIMITER_CPP
+
+namespace {
+
+int64_t steadyNowSeconds()
+{
+    return std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+std::string trimSpaces(const std::string &value)
+{
+    const auto begin = value.find_first_not_of(' ');
+    const auto end = value.find_last_not_of(' ');
+    return begin == std::string::npos ? std::string() : value.substr(begin, end - begin + 1);
+}
+
+std::unordered_set<std::string> splitList(const std::string &list)
+{
+    std::unordered_set<std::string> items;
+    size_t begin = 0;
+    while (begin <= list.size())
+    {
+        const size_t end = std::min(list.find(',', begin), list.size());
+        const std::string item = trimSpaces(list.substr(begin, end - begin));
+        if (!item.empty())
+        {
+            items.insert(item);
+        }
+        begin = end + 1;
+    }
+    return items;
+}
+
+}
+
+RateLimiter::RateLimiter()
+    : capacity(std::stod(Config::getRateLimitCapacity())),
+      refill_per_second(std::stod(Config::getRateLimitRefillPerSecond())),
+      trust_forwarded_for(Config::getRateLimitTrustForwardedFor() == "true"),
+      trusted_proxies(splitList(Config::getRateLimitTrustedProxies())),
+      api_keys(splitList(Config::getRateLimitApiKeys())),
+      idle_timeout(std::stoul(Config::getRateLimitIdleTimeoutSeconds())),
+      next_sweep(steadyNowSeconds() + idle_timeout.count())
+{
+    // Bulk routes are charged far more than point lookups.
+    const double bulkCost = std::stod(Config::getRateLimitBulkCost());
+    setRouteCost("/blocks/all", bulkCost);
+    setRouteCost("/blocks/range", bulkCost);
+    setRouteCost("/transactions/all", bulkCost);
+    setRouteCost("/transactions/details", bulkCost);
+    setRouteCost("/export/", bulkCost);
+
+    // Load balancer probes must never be throttled.
+    setRouteCost("/healthz", 0.0);
+    setRouteCost("/readyz", 0.0);
+}
+
+void RateLimiter::setRouteCost(const std::string &path, double cost)
+{
+    route_costs.emplace_back(path, cost);
+}
+
+void RateLimiter::before_handle(crow::request &req, crow::response &res, context &ctx)
+{
+    if (req.method == crow::HTTPMethod::OPTIONS || refill_per_second <= 0.0)
+    {
+        return;
+    }
+
+    const int64_t nowSeconds = steadyNowSeconds();
+    int64_t due = next_sweep.load(std::memory_order_relaxed);
+    if (nowSeconds >= due && next_sweep.compare_exchange_strong(due, nowSeconds + idle_timeout.count()))
+    {
+        sweepIdleBuckets();
+    }
+
+    const std::string key = clientKey(req);
+    const double cost = std::min(costOf(req.url), capacity);
+    const auto now = std::chrono::steady_clock::now();
+
+    Shard &shard = shards[std::hash<std::string>{}(key) % shard_count];
+    bool allowed = false;
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto [it, inserted] = shard.buckets.try_emplace(key, Bucket{capacity, now});
+        Bucket &bucket = it->second;
+
+        if (!inserted)
+        {
+            const double elapsed = std::chrono::duration<double>(now - bucket.refilled).count();
+            bucket.tokens = std::min(capacity, bucket.tokens + elapsed * refill_per_second);
+            bucket.refilled = now;
+        }
+
+        if (bucket.tokens >= cost)
+        {
+            bucket.tokens -= cost;
+            allowed = true;
+        }
+        ctx.remaining = bucket.tokens;
+    }
+    ctx.limited = true;
+
+    if (!allowed)
+    {
+        static Counter &rejected = Metrics::instance().counter("zcash_api_rate_limited_requests_total", "Requests rejected with 429 by the per client rate limiter.");
+        rejected.increment();
+
+        const double deficit = cost - ctx.remaining;
+        nlohmann::json jsonResponse;
+        jsonResponse["error"] = "Rate limit exceeded.";
+        res.code = 429;
+        res.set_header("Content-Type", "application/json");
+        res.set_header("Retry-After", std::to_string(static_cast<int64_t>(std::ceil(deficit / refill_per_second))));
+        res.write(jsonResponse.dump());
+        res.end();
+    }
+}
+
+void RateLimiter::after_handle(crow::request & /*req*/, crow::response &res, context &ctx)
+{
+    if (ctx.limited)
+    {
+        setRateLimitHeaders(res, ctx.remaining);
+    }
+}
+
+std::string RateLimiter::clientKey(const crow::request &req) const
+{
+    // Unknown keys are ignored rather than given a bucket each, or every made up key would start full.
+    const std::string &apiKey = req.get_header_value("X-API-Key");
+    if (!apiKey.empty() && api_keys.count(apiKey) > 0)
+    {
+        return "key:" + apiKey;
+    }
+
+    if (trust_forwarded_for)
+    {
+        const std::string client = forwardedClient(req.get_header_value("X-Forwarded-For"));
+        if (!client.empty())
+        {
+            return "ip:" + client;
+        }
+    }
+
+    return "ip:" + req.remote_ip_address;
+}
+
+std::string RateLimiter::forwardedClient(const std::string &forwardedFor) const
+{
+    size_t end = forwardedFor.size();
+    while (end > 0)
+    {
+        const size_t comma = forwardedFor.rfind(',', end - 1);
+        const size_t begin = comma == std::string::npos ? 0 : comma + 1;
+        const std::string hop = trimSpaces(forwardedFor.substr(begin, end - begin));
+        if (!hop.empty() && trusted_proxies.count(hop) == 0)
+        {
+            return hop;
+        }
+
+        if (comma == std::string::npos)
+        {
+            break;
+        }
+        end = comma;
+    }
+
+    return std::string();
+}
+
+double RateLimiter::costOf(const std::string &path) const
+{
+    for (const auto &[route, cost] : route_costs)
+    {
+        const bool isPrefix = !route.empty() && route.back() == '/';
+        if (isPrefix ? path.rfind(route, 0) == 0 : path == route)
+        {
+            return cost;
+        }
+    }
+
+    return 1.0;
+}
+
+void RateLimiter::sweepIdleBuckets()
+{
+    const auto cutoff = std::chrono::steady_clock::now() - idle_timeout;
+
+    for (Shard &shard : shards)
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        for (auto it = shard.buckets.begin(); it != shard.buckets.end();)
+        {
+            // A bucket idle for the timeout is indistinguishable from a fresh one once refilled.
+            const double refilled = it->second.tokens + idle_timeout.count() * refill_per_second;
+            if (it->second.refilled < cutoff && refilled >= capacity)
+            {
+                it = shard.buckets.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    }
+}
+
+void RateLimiter::setRateLimitHeaders(crow::response &res, double remaining) const
+{
+    const double secondsToFull = (capacity - remaining) / refill_per_second;
+    res.set_header("RateLimit-Limit", std::to_string(static_cast<int64_t>(capacity)));
+    res.set_header("RateLimit-Remaining", std::to_string(static_cast<int64_t>(std::max(0.0, remaining))));
+    res.set_header("RateLimit-Reset", std::to_string(static_cast<int64_t>(std::ceil(secondsToFull))));
+}
+
+#endif // RATE_LIMITER_CPP
@@ -0,0 +1,110 @@
+#ifndef RATE_LIMITER_HPP
+#define RATE_LIMITER_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include "../include/crow_all.h"
+
+/**
+ * @brief Crow middleware applying a cost weighted token bucket per client.
+ *
+ * Clients are identified by their peer address. An X-API-Key header only identifies the client when
+ * the key is on the configured allow-list, and X-Forwarded-For is only read when explicitly trusted,
+ * so clients can't mint fresh buckets by varying headers. Buckets live in a sharded table so
+ * concurrent requests from different clients rarely contend, and idle buckets are swept periodically.
+ */
+struct RateLimiter
+{
+    struct context
+    {
+        bool limited{false};       ///< Whether the limiter applied to this request.
+        double remaining{0.0};     ///< Tokens left in the client's bucket after this request.
+    };
+
+    /**
+     * @brief Constructor for the RateLimiter middleware, configured from Config.
+     */
+    RateLimiter();
+
+    void before_handle(crow::request &req, crow::response &res, context &ctx);
+
+    void after_handle(crow::request &req, crow::response &res, context &ctx);
+
+    /**
+     * @brief Set the token cost of a route. Paths ending in '/' match as prefixes, others match exactly.
+     * Must be called before requests are served.
+     * @param path Route path or prefix.
+     * @param cost Tokens charged per request.
+     */
+    void setRouteCost(const std::string &path, double cost);
+
+private:
+    struct Bucket
+    {
+        double tokens;
+        std::chrono::steady_clock::time_point refilled;
+    };
+
+    struct Shard
+    {
+        std::mutex mutex;
+        std::unordered_map<std::string, Bucket> buckets;
+    };
+
+    static constexpr size_t shard_count = 16;
+
+    double capacity;
+    double refill_per_second;
+    bool trust_forwarded_for;
+    std::unordered_set<std::string> trusted_proxies;
+    std::unordered_set<std::string> api_keys;
+    std::chrono::seconds idle_timeout;
+    std::vector<std::pair<std::string, double>> route_costs;
+    std::array<Shard, shard_count> shards;
+    std::atomic<int64_t> next_sweep;
+
+    /**
+     * @brief Identify the client a request is charged to.
+     * @param req Crow request object.
+     * @return Bucket key for the client.
+     */
+    std::string clientKey(const crow::request &req) const;
+
+    /**
+     * @brief Find the client address in an X-Forwarded-For header: the right-most hop that isn't a trusted proxy.
+     * Hops left of it were written by the client and can't be trusted.
+     * @param forwardedFor Header value.
+     * @return Client address, or an empty string if every hop is a trusted proxy.
+     */
+    std::string forwardedClient(const std::string &forwardedFor) const;
+
+    /**
+     * @brief Get the token cost of a request path.
+     * @param path Request path without query string.
+     * @return Tokens charged for the request.
+     */
+    double costOf(const std::string &path) const;
+
+    /**
+     * @brief Drop buckets that have been idle long enough to be full again.
+     * Runs on whichever request thread first notices the sweep is due.
+     */
+    void sweepIdleBuckets();
+
+    /**
+     * @brief Set the standard rate limit headers on a response.
+     * @param res Crow response object.
+     * @param remaining Tokens left in the client's bucket.
+     */
+    void setRateLimitHeaders(crow::response &res, double remaining) const;
+};
+
+#endif // RATE_LIMITER_HPP
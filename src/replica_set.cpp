@@ -0,0 +1,185 @@
+#include "replica_set.hpp"
+#include "../include/crow_all.h"
+#include <limits>
+
+#ifndef REPLICA_SET_CPP
+#define REPLICA_SET_CPP
+
+namespace {
+
+int64_t steadyNowMs()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+}
+
+ReplicaSet::Replica::Replica(std::string name_, std::unique_ptr<ConnectionPool> pool_)
+    : name(std::move(name_)), pool(std::move(pool_)),
+      lag_gauge(Metrics::instance().gauge("zcash_api_db_replica_lag_blocks", "Blocks a read replica is behind the primary's tip.", "replica=\"" + name + "\"")),
+      ejections(Metrics::instance().counter("zcash_api_db_replica_ejections_total", "Times a read replica was ejected after repeated failures.", "replica=\"" + name + "\"")),
+      routed(Metrics::instance().counter("zcash_api_db_reads_total", "Database reads by the pool that served them.", "target=\"" + name + "\""))
+{
+}
+
+ReplicaSet::ReplicaSet(Options options_)
+    : options(options_),
+      primary_fallbacks(Metrics::instance().counter("zcash_api_db_reads_total", "Database reads by the pool that served them.", "target=\"primary\""))
+{
+}
+
+void ReplicaSet::add(const std::string &name, std::unique_ptr<ConnectionPool> pool)
+{
+    replicas.push_back(std::make_unique<Replica>(name, std::move(pool)));
+}
+
+ConnectionPool *ReplicaSet::choose(bool fresh, const ConnectionPool *exclude)
+{
+    const int64_t now = steadyNowMs();
+    const int64_t tip = tip_height.load(std::memory_order_acquire);
+
+    Replica *best = nullptr;
+    uint32_t bestOutstanding = std::numeric_limits<uint32_t>::max();
+
+    for (const auto &replica : replicas)
+    {
+        // A replica whose height was never measured hasn't proven it can serve reads.
+        const int64_t height = replica->height.load(std::memory_order_acquire);
+        if (replica->pool.get() == exclude || height < 0 || replica->ejected_until_ms.load(std::memory_order_acquire) > now)
+        {
+            continue;
+        }
+
+        if (fresh && (tip < 0 || tip - height > static_cast<int64_t>(options.max_lag_blocks)))
+        {
+            continue;
+        }
+
+        const uint32_t outstanding = replica->outstanding.load(std::memory_order_relaxed);
+        if (outstanding < bestOutstanding)
+        {
+            best = replica.get();
+            bestOutstanding = outstanding;
+        }
+    }
+
+    if (best == nullptr)
+    {
+        primary_fallbacks.increment();
+        return nullptr;
+    }
+
+    best->outstanding.fetch_add(1, std::memory_order_relaxed);
+    best->routed.increment();
+    return best->pool.get();
+}
+
+void ReplicaSet::finished(ConnectionPool *pool, bool failed)
+{
+    Replica *replica = find(pool);
+    if (replica == nullptr)
+    {
+        return;
+    }
+
+    replica->outstanding.fetch_sub(1, std::memory_order_relaxed);
+
+    if (failed)
+    {
+        recordFailure(*replica);
+    }
+    else
+    {
+        replica->consecutive_failures.store(0, std::memory_order_relaxed);
+    }
+}
+
+void ReplicaSet::refreshLag(uint64_t tipHeight)
+{
+    tip_height.store(static_cast<int64_t>(tipHeight), std::memory_order_release);
+
+    for (const auto &replica : replicas)
+    {
+        std::unique_ptr<PooledConnection> conn;
+        bool broken = false;
+
+        try
+        {
+            conn = replica->pool->acquire();
+            pqxx::nontransaction tx(*conn->connection);
+            pqxx::result result = tx.exec("SELECT MAX(CAST(height AS INTEGER)) FROM blocks");
+
+            const int64_t height = result.empty() || result[0][0].is_null() ? 0 : result[0][0].as<int64_t>();
+            replica->height.store(height, std::memory_order_release);
+            replica->lag_gauge.set(static_cast<double>(std::max<int64_t>(static_cast<int64_t>(tipHeight) - height, 0)));
+            replica->consecutive_failures.store(0, std::memory_order_relaxed);
+        }
+        catch (const std::exception &e)
+        {
+            broken = dynamic_cast<const pqxx::broken_connection *>(&e) != nullptr;
+            CROW_LOG_WARNING << "Measuring lag of replica " << replica->name << " failed: " << e.what();
+            recordFailure(*replica);
+        }
+
+        if (conn)
+        {
+            replica->pool->release(std::move(conn), broken);
+        }
+    }
+}
+
+std::vector<ReplicaStats> ReplicaSet::stats() const
+{
+    const int64_t now = steadyNowMs();
+    const int64_t tip = tip_height.load(std::memory_order_acquire);
+
+    std::vector<ReplicaStats> result;
+    result.reserve(replicas.size());
+
+    for (const auto &replica : replicas)
+    {
+        const int64_t height = replica->height.load(std::memory_order_acquire);
+
+        ReplicaStats stats;
+        stats.name = replica->name;
+        stats.outstanding = replica->outstanding.load(std::memory_order_relaxed);
+        stats.ejected = replica->ejected_until_ms.load(std::memory_order_acquire) > now;
+        if (height >= 0 && tip >= 0)
+        {
+            stats.lag = static_cast<uint64_t>(std::max<int64_t>(tip - height, 0));
+        }
+        stats.pool = replica->pool->stats();
+        result.push_back(std::move(stats));
+    }
+
+    return result;
+}
+
+ReplicaSet::Replica *ReplicaSet::find(const ConnectionPool *pool) const noexcept
+{
+    for (const auto &replica : replicas)
+    {
+        if (replica->pool.get() == pool)
+        {
+            return replica.get();
+        }
+    }
+    return nullptr;
+}
+
+void ReplicaSet::recordFailure(Replica &replica)
+{
+    const uint32_t failures = replica.consecutive_failures.fetch_add(1, std::memory_order_relaxed) + 1;
+    if (failures < options.eject_after_failures)
+    {
+        return;
+    }
+
+    replica.consecutive_failures.store(0, std::memory_order_relaxed);
+    replica.ejected_until_ms.store(steadyNowMs() + options.ejection_period.count(), std::memory_order_release);
+    replica.ejections.increment();
+
+    CROW_LOG_WARNING << "Ejecting replica " << replica.name << " for " << options.ejection_period.count() << " ms after " << failures << " consecutive failures.";
+}
+
+#endif // REPLICA_SET_CPP
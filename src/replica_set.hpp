@@ -0,0 +1,127 @@
+#ifndef REPLICA_SET_HPP
+#define REPLICA_SET_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+#include "connection_pool.hpp"
+#include "metrics.hpp"
+
+/**
+ * @brief Point in time snapshot of one replica's routing state.
+ */
+struct ReplicaStats
+{
+    std::string name;                 ///< Replica host.
+    uint32_t outstanding;             ///< Checked out connections routed to the replica.
+    bool ejected;                     ///< Whether the replica is ejected after repeated failures.
+    std::optional<uint64_t> lag;      ///< Blocks behind the primary's tip, or std::nullopt if never measured.
+    PoolStats pool;                   ///< State of the replica's connection pool.
+};
+
+/**
+ * @brief Read replicas, each with its own connection pool. Routes reads to the replica with the fewest
+ * outstanding requests, ejects replicas that keep failing and tracks how far each lags behind the primary.
+ */
+class ReplicaSet
+{
+public:
+    struct Options
+    {
+        uint64_t max_lag_blocks;                   ///< Lag above which a replica can't serve tip sensitive reads.
+        uint32_t eject_after_failures;             ///< Consecutive failures that eject a replica.
+        std::chrono::milliseconds ejection_period; ///< How long an ejected replica receives no traffic.
+    };
+
+    /**
+     * @brief Constructor for the ReplicaSet class.
+     * @param options Routing and ejection tuning.
+     */
+    explicit ReplicaSet(Options options);
+
+    /**
+     * @brief Destructor for the ReplicaSet class.
+     */
+    ~ReplicaSet() noexcept = default;
+
+    /**
+     * @brief Add a replica. Must be called before any reads are routed.
+     * @param name Replica host, used in logs and metrics.
+     * @param pool Open connection pool for the replica.
+     */
+    void add(const std::string &name, std::unique_ptr<ConnectionPool> pool);
+
+    /**
+     * @brief Pick the replica with the fewest outstanding requests and count a request against it.
+     * Every non null result must be paired with finished().
+     * @param fresh True if the read needs a replica within max_lag_blocks of the tip.
+     * @param exclude Pool that must not be chosen, e.g. the one a hedged read is already waiting on.
+     * @return The replica's pool, or nullptr if no replica is eligible and the read should use the primary.
+     */
+    ConnectionPool *choose(bool fresh, const ConnectionPool *exclude = nullptr);
+
+    /**
+     * @brief Record the outcome of a request routed by choose().
+     * @param pool Pool returned by choose().
+     * @param failed True if the replica failed the request.
+     */
+    void finished(ConnectionPool *pool, bool failed);
+
+    /**
+     * @brief Measure every replica's height against the primary's tip. Replicas that can't be queried count a failure.
+     * @param tipHeight Height of the primary's tip.
+     */
+    void refreshLag(uint64_t tipHeight);
+
+    /**
+     * @brief Take a snapshot of every replica's routing state.
+     * @return Replica statistics in the order the replicas were added.
+     */
+    std::vector<ReplicaStats> stats() const;
+
+    /**
+     * @brief Check whether any replicas are configured.
+     * @return True if there are none.
+     */
+    bool empty() const noexcept { return replicas.empty(); }
+
+private:
+    struct Replica
+    {
+        Replica(std::string name_, std::unique_ptr<ConnectionPool> pool_);
+
+        std::string name;
+        std::unique_ptr<ConnectionPool> pool;
+        std::atomic<uint32_t> outstanding{0};
+        std::atomic<uint32_t> consecutive_failures{0};
+        std::atomic<int64_t> ejected_until_ms{0};
+        std::atomic<int64_t> height{-1};
+        Gauge &lag_gauge;
+        Counter &ejections;
+        Counter &routed;
+    };
+
+    Options options;
+    std::vector<std::unique_ptr<Replica>> replicas;
+    std::atomic<int64_t> tip_height{-1};
+    Counter &primary_fallbacks;
+
+    /**
+     * @brief Find the replica owning a pool.
+     * @param pool Pool returned by choose().
+     * @return The replica, or nullptr if the pool belongs to no replica.
+     */
+    Replica *find(const ConnectionPool *pool) const noexcept;
+
+    /**
+     * @brief Count a failure against a replica, ejecting it once it fails often enough in a row.
+     * @param replica Replica that failed.
+     */
+    void recordFailure(Replica &replica);
+};
+
+#endif // REPLICA_SET_HPP
@@ -3,16 +3,88 @@
 
 #include "routes.hpp"
 #include "parser.hpp"
+#include "encoding.hpp"
+#include "chain_utils.hpp"
 #include "../include/crow_all.h"
 #include <optional>
+#include <limits>
+#include <sstream>
+#include <thread>
 
-ZCashApi::ZCashApi(Database &database) : db(database) {}
+namespace {
+
+/**
+ * Most requests allowed to wait for admission across every route. Crow runs one worker per core and a waiting
+ * request blocks its worker, so by default half of them are kept for requests that run straight away.
+ */
+uint32_t admissionMaxQueued()
+{
+    const std::string configured = Config::getAdmissionMaxQueued();
+    if (configured != "auto")
+    {
+        return static_cast<uint32_t>(std::stoul(configured));
+    }
+    return std::max(1u, std::thread::hardware_concurrency() / 2);
+}
+
+}
+
+ZCashApi::ZCashApi(Database &database)
+    : db(database),
+      admission(RouteBudget{static_cast<uint32_t>(std::stoul(Config::getAdmissionConcurrency())),
+                            static_cast<uint32_t>(std::stoul(Config::getAdmissionQueueDepth())),
+                            std::chrono::milliseconds(std::stoul(Config::getAdmissionQueueTimeoutMs()))},
+                admissionMaxQueued(),
+                std::chrono::seconds(std::stoul(Config::getAdmissionRetryAfterSeconds()))),
+      limiter(AdaptiveLimiter::Options{static_cast<uint32_t>(std::stoul(Config::getAdaptiveLimitInitial())),
+                                       static_cast<uint32_t>(std::stoul(Config::getAdaptiveLimitMin())),
+                                       static_cast<uint32_t>(std::stoul(Config::getAdaptiveLimitMax())),
+                                       std::stod(Config::getAdaptiveLimitTolerance()),
+                                       std::chrono::milliseconds(std::stoul(Config::getAdaptiveLimitPoolWaitMs())),
+                                       static_cast<uint32_t>(std::stoul(Config::getAdaptiveLimitWindow())),
+                                       0.2}),
+      tipWatcher(database, std::chrono::milliseconds(std::stoul(Config::getTipPollIntervalMs()))),
+      headerStore(database, BlockHeaderStore::Options{std::stoull(Config::getHeaderStoreLoadBatch()),
+                                                      std::stoull(Config::getHeaderStoreReorgDepth())}),
+      hashIndex(database, HashIndex::Options{std::stoull(Config::getHashIndexLoadBatch()),
+                                             std::stoull(Config::getHeaderStoreReorgDepth()),
+                                             std::stoull(Config::getHashIndexMergeThreshold()),
+                                             Config::getHashIndexSnapshotPath()}),
+      hashFilter(database, HashFilter::Options{std::stoull(Config::getHashFilterBlockCapacity()),
+                                               std::stoull(Config::getHashFilterTransactionCapacity()),
+                                               static_cast<uint32_t>(std::stoul(Config::getHashFilterBitsPerEntry())),
+                                               std::stoull(Config::getHashIndexLoadBatch()),
+                                               std::stoull(Config::getHeaderStoreReorgDepth())}),
+      hash_filter_enabled(Parser::StringToBool(Config::getHashFilterEnabled())),
+      default_statement_timeout(std::stoul(Config::getStatementTimeoutMs())),
+      blocks_range_max_span(std::stoull(Config::getBlocksRangeMaxSpan())),
+      blocks_immutable_depth(std::stoull(Config::getBlocksImmutableDepth())),
+      tip_max_age(std::stoul(Config::getTipMaxAgeMs())),
+      export_batch_heights(std::stoull(Config::getExportBatchHeights())),
+      admission_shed(Metrics::instance().counter("zcash_api_shed_requests_total", "Requests rejected with 503 before running.", "reason=\"admission\"")),
+      limiter_shed(Metrics::instance().counter("zcash_api_shed_requests_total", "Requests rejected with 503 before running.", "reason=\"adaptive_limit\"")),
+      circuit_shed(Metrics::instance().counter("zcash_api_shed_requests_total", "Requests rejected with 503 before running.", "reason=\"circuit_open\""))
+{
+    // Bulk routes get small dedicated budgets so they can't starve point lookups.
+    const RouteBudget heavyBudget{static_cast<uint32_t>(std::stoul(Config::getAdmissionHeavyConcurrency())),
+                                  static_cast<uint32_t>(std::stoul(Config::getAdmissionHeavyQueueDepth())),
+                                  std::chrono::milliseconds(std::stoul(Config::getAdmissionQueueTimeoutMs()))};
+
+    const std::chrono::milliseconds heavyTimeout(std::stoul(Config::getStatementTimeoutHeavyMs()));
+
+    for (const char *route : {"/blocks/all", "/blocks/range", "/transactions/all", "/transactions/details", "/export/<string>"})
+    {
+        admission.registerRoute(route, heavyBudget);
+        statement_timeouts.emplace(route, heavyTimeout);
+        bulk_routes.emplace(route);
+    }
+}
 
 /**
  * Initialize the API. This method makes a call to also initialize the database
  * and setup routes.
  */
-void ZCashApi::init(crow::App<crow::CORSHandler> &app, const std::string &dbname, const std::string &user, const std::string &password, const std::string &host, std::string port)
+void ZCashApi::init(ZCashApp &app, const std::string &dbname, const std::string &user, const std::string &password, const std::string &host, std::string port)
 {
     if (this->isInitiated)
     {
@@ -21,6 +93,40 @@ void ZCashApi::init(crow::App<crow::CORSHandler> &app, const std::string &dbname
 
     this->isInitiated = true;
     db.connect(dbname, user, password, host, port);
+
+    const std::string snapshotPath = Config::getChainSnapshotPath();
+    if (!snapshotPath.empty())
+    {
+        chainSnapshot = std::make_unique<ChainSnapshot>(snapshotPath, Parser::StringToBool(Config::getChainSnapshotVerify()));
+        headerStore.attach(*chainSnapshot);
+        hashIndex.attach(*chainSnapshot);
+        hashFilter.attach(*chainSnapshot);
+        CROW_LOG_INFO << "Serving blocks below height " << chainSnapshot->height() << " from " << snapshotPath << ".";
+    }
+
+    // The store loads in the background and routes fall back to the database until it covers what they need.
+    if (Parser::StringToBool(Config::getHeaderStoreEnabled()))
+    {
+        tipWatcher.subscribe([this](uint64_t tipHeight)
+                             { headerStore.extend(tipHeight); });
+        headerStore.start();
+    }
+
+    if (Parser::StringToBool(Config::getHashIndexEnabled()))
+    {
+        tipWatcher.subscribe([this](uint64_t tipHeight)
+                             { hashIndex.extend(tipHeight); });
+        hashIndex.start();
+    }
+
+    if (hash_filter_enabled)
+    {
+        tipWatcher.subscribe([this](uint64_t tipHeight)
+                             { hashFilter.extend(tipHeight); });
+        hashFilter.start();
+    }
+
+    tipWatcher.start();
     this->setup_routes(app);
 }
 
@@ -36,6 +142,12 @@ void ZCashApi::hello_route(const crow::request &req, crow::response &res)
  */
 void ZCashApi::fetch_all_blocks_route(const crow::request &req, crow::response &res)
 {
+    if (Encoding::wantsNdjson(req))
+    {
+        this->export_ndjson(req, res, &Database::exportBlocks);
+        return;
+    }
+
     try
     {
         std::optional<json> result = db.fetchAllBlocks();
@@ -47,7 +159,7 @@ void ZCashApi::fetch_all_blocks_route(const crow::request &req, crow::response &
         }
 
         res.code = 200;
-        res.write(result.value().dump());
+        this->write_response(req, res, result.value());
     }
     catch (const std::exception &e)
     {
@@ -62,6 +174,12 @@ void ZCashApi::fetch_all_blocks_route(const crow::request &req, crow::response &
  */
 void ZCashApi::fetch_all_transactions_route(const crow::request &req, crow::response &res)
 {
+    if (Encoding::wantsNdjson(req))
+    {
+        this->export_ndjson(req, res, &Database::exportTransactions);
+        return;
+    }
+
     try
     {
         std::optional<json> result = db.fetchAllTransactions();
@@ -73,7 +191,7 @@ void ZCashApi::fetch_all_transactions_route(const crow::request &req, crow::resp
         }
 
         res.code = 200;
-        res.write(result.value().dump());
+        this->write_response(req, res, result.value());
     }
     catch (std::exception &e)
     {
@@ -104,7 +222,7 @@ void ZCashApi::fetch_paginated_blocks_route(const crow::request &req, crow::resp
         }
 
         res.code = 200;
-        res.write(result.value().dump());
+        this->write_response(req, res, result.value());
     }
     catch (std::exception &e)
     {
@@ -135,7 +253,7 @@ void ZCashApi::fetch_paginated_transactions_route(const crow::request &req, crow
         }
 
         res.code = 200;
-        res.write(result.value().dump());
+        this->write_response(req, res, result.value());
     }
     catch (std::exception &e)
     {
@@ -151,17 +269,27 @@ void ZCashApi::fetch_block_by_hash(const crow::request &req, crow::response &res
 {
     try
     {
-        std::optional<json> result = db.fetchBlockByHash(block_hash);
+        bool missing = false;
+        std::optional<HashIndexEntry> located = this->locate_hash(block_hash, HashFilter::Kind::Block, missing);
+        if (missing || (located.has_value() && !located->isBlock()))
+        {
+            res.write(json({}));
+            res.code = 404;
+            return;
+        }
+
+        std::optional<json> result = db.fetchBlockByHash(block_hash, located.has_value() ? std::optional<uint64_t>(located->height) : std::nullopt);
 
         if (!result.has_value())
         {
+            this->hash_absent(block_hash, HashFilter::Kind::Block);
             res.write(json({}));
             res.code = 400;
             return;
         }
 
         res.code = 200;
-        res.write(result.value().dump());
+        this->write_response(req, res, result.value());
     }
     catch (std::exception &e)
     {
@@ -177,10 +305,27 @@ void ZCashApi::fetch_transaction_by_hash(const crow::request &req, crow::respons
 {
     try
     {
-        std::optional<json> result = db.fetchTransactionByHash(transaction_hash);
+        bool missing = false;
+        std::optional<HashIndexEntry> located = this->locate_hash(transaction_hash, HashFilter::Kind::Transaction, missing);
+        if (missing || (located.has_value() && located->isBlock()))
+        {
+            res.write(json({}));
+            res.code = 404;
+            return;
+        }
+
+        const std::optional<uint64_t> height = located.has_value() ? std::optional<uint64_t>(located->height) : std::nullopt;
+        if (req.url_params.get("expand"))
+        {
+            this->fetch_expanded_transaction(req, res, transaction_hash, height);
+            return;
+        }
+
+        std::optional<json> result = db.fetchTransactionByHash(transaction_hash, height);
 
         if (!result.has_value())
         {
+            this->hash_absent(transaction_hash, HashFilter::Kind::Transaction);
             res.write(json({}));
             res.code = 400;
             return;
@@ -188,7 +333,7 @@ void ZCashApi::fetch_transaction_by_hash(const crow::request &req, crow::respons
 
         json transaction = result.value();
         res.code = 200;
-        res.write(result.value().dump());
+        this->write_response(req, res, result.value());
     }
     catch (std::exception &e)
     {
@@ -200,6 +345,45 @@ void ZCashApi::fetch_transaction_by_hash(const crow::request &req, crow::respons
     }
 }
 
+void ZCashApi::fetch_expanded_transaction(const crow::request &req, crow::response &res, const std::string &transaction_hash, std::optional<uint64_t> height)
+{
+    bool inputs = false;
+    bool outputs = false;
+    std::stringstream expand(req.url_params.get("expand"));
+    std::string part;
+    while (std::getline(expand, part, ','))
+    {
+        if (part == "inputs")
+        {
+            inputs = true;
+        }
+        else if (part == "outputs")
+        {
+            outputs = true;
+        }
+        else if (!part.empty())
+        {
+            json errorResponse;
+            this->db.createJsonErrorResponse(errorResponse, std::invalid_argument("Unknown expansion " + part + ", expected inputs and/or outputs."));
+            res.write(errorResponse.dump());
+            res.code = 400;
+            return;
+        }
+    }
+
+    std::optional<json> result = db.fetchExpandedTransactionByHash(transaction_hash, height, inputs, outputs);
+    if (!result.has_value())
+    {
+        this->hash_absent(transaction_hash, HashFilter::Kind::Transaction);
+        res.write(json({}));
+        res.code = 404;
+        return;
+    }
+
+    res.code = 200;
+    this->write_response(req, res, result.value());
+}
+
 void ZCashApi::fetch_transparent_outputs_related_to_transaction_hash(const crow::request &req, crow::response &res, const std::string &transaction_hash)
 {
     try
@@ -214,7 +398,7 @@ void ZCashApi::fetch_transparent_outputs_related_to_transaction_hash(const crow:
         }
 
         res.code = 200;
-        res.write(result.value().dump());
+        this->write_response(req, res, result.value());
     }
     catch (std::exception &e)
     {
@@ -226,6 +410,51 @@ void ZCashApi::fetch_transparent_outputs_related_to_transaction_hash(const crow:
     }
 }
 
+void ZCashApi::fetch_address_route(const crow::request &req, crow::response &res, const std::string &address)
+{
+    uint64_t limit = 0;
+    try
+    {
+        if (classifySearchTerm(address) != SearchTerm::TransparentAddress)
+        {
+            throw std::invalid_argument("Expected a transparent address.");
+        }
+        limit = std::min<uint64_t>(req.url_params.get("limit") ? std::stoull(req.url_params.get("limit")) : 50, 1000);
+    }
+    catch (const std::exception &e)
+    {
+        json errorResponse;
+        this->db.createJsonErrorResponse(errorResponse, e);
+        res.write(errorResponse.dump());
+        res.code = 400;
+        return;
+    }
+
+    try
+    {
+        json jsonResponse;
+        jsonResponse["address"] = address;
+        jsonResponse["outputs"] = this->db.fetchTransparentOutputsForAddress(address, limit);
+        if (jsonResponse["outputs"].empty())
+        {
+            res.write(json({}));
+            res.code = 404;
+            return;
+        }
+
+        res.code = 200;
+        this->write_response(req, res, jsonResponse);
+    }
+    catch (const std::exception &e)
+    {
+        CROW_LOG_CRITICAL << e.what();
+        json errorResponse;
+        this->db.createJsonErrorResponse(errorResponse, e);
+        res.write(errorResponse.dump());
+        res.code = 500;
+    }
+}
+
 void ZCashApi::fetch_transparent_inputs_related_to_transaction_hash(const crow::request &req, crow::response &res, const std::string &transaction_hash)
 {
     try
@@ -240,7 +469,7 @@ void ZCashApi::fetch_transparent_inputs_related_to_transaction_hash(const crow::
         }
 
         res.code = 200;
-        res.write(result.value().dump());
+        this->write_response(req, res, result.value());
     }
     catch (std::exception &e)
     {
@@ -257,6 +486,14 @@ void ZCashApi::fetch_transactions_details_from_ids(const crow::request &req, cro
     try
     {
         std::vector<std::string> transaction_ids = json::parse(req.body);
+        for (std::string &transaction_id : transaction_ids)
+        {
+            if (!this->accept_hash(transaction_id, res))
+            {
+                return;
+            }
+        }
+
         std::optional<json> result = db.fetchTransactionsDetailsFromIds(transaction_ids);
 
         if (transaction_ids.empty())
@@ -272,7 +509,7 @@ void ZCashApi::fetch_transactions_details_from_ids(const crow::request &req, cro
         }
 
         res.code = 200;
-        res.write(result.value().dump());
+        this->write_response(req, res, result.value());
     }
     catch (std::exception &e)
     {
@@ -297,7 +534,7 @@ void ZCashApi::fetch_peer_info(const crow::request &req, crow::response &res)
             return;
         }
 
-        res.write(result.value().dump());
+        this->write_response(req, res, result.value());
         res.code = 200;
     }
     catch (const std::exception &e)
@@ -322,7 +559,7 @@ void ZCashApi::fetch_blockchain_info(const crow::request &req, crow::response &r
             return;
         }
 
-        res.write(result.value().dump());
+        this->write_response(req, res, result.value());
         res.code = 200;
     }
     catch (const std::exception &e)
@@ -348,7 +585,7 @@ void ZCashApi::fetch_total_block_count(const crow::request &req, crow::response
             return;
         }
 
-        res.write(result.value().dump());
+        this->write_response(req, res, result.value());
         res.code = 200;
     }
     catch (const std::exception &e)
@@ -375,7 +612,7 @@ void ZCashApi::fetch_total_transaction_count(const crow::request &req, crow::res
             return;
         }
 
-        res.write(json(result.value()).dump());
+        this->write_response(req, res, json(result.value()));
         res.code = 200;
     }
     catch (const std::exception &e)
@@ -425,7 +662,7 @@ void ZCashApi::fetch_total_transaction_counts_in_period(const crow::request &req
             return;
         }
 
-        res.write(result.value().dump());
+        this->write_response(req, res, result.value());
         res.code = 200;
     }
     catch (const std::exception &e)
@@ -438,32 +675,513 @@ void ZCashApi::fetch_total_transaction_counts_in_period(const crow::request &req
     }
 }
 
-void ZCashApi::direct_search(const crow::request &req, crow::response &res)
+namespace {
+
+/**
+ * Describes a block header for the height, range and time lookup routes.
+ */
+json headerToJson(const BlockHeader &header)
+{
+    json jsonHeader;
+    jsonHeader["hash"] = bytesToHex(header.hash.data(), header.hash.size());
+    jsonHeader["height"] = header.height;
+    jsonHeader["timestamp"] = header.timestamp;
+    jsonHeader["size"] = header.size;
+    jsonHeader["txCount"] = header.tx_count;
+    jsonHeader["difficulty"] = header.difficulty;
+    return jsonHeader;
+}
+
+}
+
+void ZCashApi::fetch_block_by_height(const crow::request &req, crow::response &res, uint64_t height)
 {
     try
     {
-        const std::string searchPattern = req.url_params.get("pattern");
+        const std::vector<BlockHeader> headers = this->block_headers(height, 1);
 
-        std::optional<json> searchOptVal = this->db.directSearch(searchPattern);
-        if (!searchOptVal.has_value())
+        if (headers.empty())
         {
+            res.write(json({}));
             res.code = 404;
             return;
         }
 
         res.code = 200;
-        res.write(searchOptVal.value());
+        this->set_block_cache_headers(res, height, true);
+        this->write_response(req, res, headerToJson(headers.front()));
+    }
+    catch (const std::exception &e)
+    {
+        CROW_LOG_CRITICAL << e.what();
+        json errorResponse;
+        this->db.createJsonErrorResponse(errorResponse, e);
+        res.write(errorResponse.dump());
+        res.code = 500;
+    }
+}
+
+void ZCashApi::fetch_blocks_range_route(const crow::request &req, crow::response &res)
+{
+    uint64_t fromHeight = 0;
+    uint64_t toHeight = 0;
+    try
+    {
+        if (!req.url_params.get("from") || !req.url_params.get("to"))
+        {
+            throw std::invalid_argument("Both from and to heights are required.");
+        }
+
+        fromHeight = std::stoull(req.url_params.get("from"));
+        toHeight = std::stoull(req.url_params.get("to"));
+        const uint64_t maxSpan = blocks_range_max_span;
+        if (toHeight < fromHeight || toHeight - fromHeight >= maxSpan)
+        {
+            throw std::invalid_argument("The range must not end before it starts or span more than " + std::to_string(maxSpan) + " heights.");
+        }
+    }
+    catch (const std::exception &e)
+    {
+        json errorResponse;
+        this->db.createJsonErrorResponse(errorResponse, e);
+        res.write(errorResponse.dump());
+        res.code = 400;
+        return;
+    }
+
+    try
+    {
+        json jsonResponse;
+        jsonResponse["from"] = fromHeight;
+        jsonResponse["to"] = toHeight;
+        jsonResponse["data"] = this->db.fetchBlocksInRange(fromHeight, toHeight);
+
+        // A range missing heights the database hasn't caught up on yet must not be cached as final.
+        const bool complete = jsonResponse["data"].size() == toHeight - fromHeight + 1;
+
+        res.code = 200;
+        this->set_block_cache_headers(res, toHeight, complete);
+        this->write_response(req, res, jsonResponse);
+    }
+    catch (const std::exception &e)
+    {
+        CROW_LOG_CRITICAL << e.what();
+        json errorResponse;
+        this->db.createJsonErrorResponse(errorResponse, e);
+        res.write(errorResponse.dump());
+        res.code = 500;
+    }
+}
+
+void ZCashApi::set_block_cache_headers(crow::response &res, uint64_t highestHeight, bool complete) const
+{
+    const std::optional<uint64_t> tip = tipWatcher.tipHeight();
+    const uint64_t immutableDepth = blocks_immutable_depth;
+
+    if (complete && tip.has_value() && tip.value() >= immutableDepth && highestHeight <= tip.value() - immutableDepth)
+    {
+        res.set_header("Cache-Control", "public, max-age=31536000, immutable");
+    }
+    else
+    {
+        // Blocks near the tip may still be reorged and heights above it aren't mined yet.
+        res.set_header("Cache-Control", "no-cache");
+    }
+}
+
+void ZCashApi::fetch_block_headers_route(const crow::request &req, crow::response &res)
+{
+    uint64_t fromHeight = 0;
+    uint64_t limit = 0;
+    try
+    {
+        fromHeight = req.url_params.get("from_height") ? std::stoull(req.url_params.get("from_height")) : 0;
+        limit = std::min<uint64_t>(req.url_params.get("limit") ? std::stoull(req.url_params.get("limit")) : 50, 1000);
+    }
+    catch (const std::exception &e)
+    {
+        json errorResponse;
+        this->db.createJsonErrorResponse(errorResponse, e);
+        res.write(errorResponse.dump());
+        res.code = 400;
+        return;
+    }
+
+    try
+    {
+        json jsonResponse;
+        jsonResponse["data"] = json::array();
+        for (const BlockHeader &header : this->block_headers(fromHeight, limit))
+        {
+            jsonResponse["data"].push_back(headerToJson(header));
+        }
+
+        res.code = 200;
+        this->write_response(req, res, jsonResponse);
+    }
+    catch (const std::exception &e)
+    {
+        CROW_LOG_CRITICAL << e.what();
+        json errorResponse;
+        this->db.createJsonErrorResponse(errorResponse, e);
+        res.write(errorResponse.dump());
+        res.code = 500;
+    }
+}
+
+void ZCashApi::fetch_block_at_time(const crow::request &req, crow::response &res, uint64_t timestamp)
+{
+    try
+    {
+        std::optional<uint64_t> height = headerStore.heightAt(timestamp);
+        if (!height.has_value())
+        {
+            height = db.fetchBlockHeightAtTime(timestamp);
+        }
+
+        std::vector<BlockHeader> headers = height.has_value() ? this->block_headers(height.value(), 1) : std::vector<BlockHeader>{};
+        if (headers.empty())
+        {
+            res.write(json({}));
+            res.code = 404;
+            return;
+        }
+
+        res.code = 200;
+        this->write_response(req, res, headerToJson(headers.front()));
+    }
+    catch (const std::exception &e)
+    {
+        CROW_LOG_CRITICAL << e.what();
+        json errorResponse;
+        this->db.createJsonErrorResponse(errorResponse, e);
+        res.write(errorResponse.dump());
+        res.code = 500;
+    }
+}
+
+void ZCashApi::direct_search(const crow::request &req, crow::response &res)
+{
+    // `pattern` is what /search took before it resolved heights and addresses too.
+    const char *query = req.url_params.get("q") ? req.url_params.get("q") : req.url_params.get("pattern");
+    std::string term = query ? query : "";
+    term.erase(0, term.find_first_not_of(" \t"));
+    term.erase(term.find_last_not_of(" \t") + 1);
+
+    try
+    {
+        json jsonResponse;
+        jsonResponse["query"] = term;
+
+        switch (classifySearchTerm(term))
+        {
+        case SearchTerm::Height:
+        {
+            const std::vector<BlockHeader> headers = this->block_headers(std::stoull(term), 1);
+            if (headers.empty())
+            {
+                res.write(json({}));
+                res.code = 404;
+                return;
+            }
+
+            const std::string hash = bytesToHex(headers.front().hash.data(), headers.front().hash.size());
+            jsonResponse["type"] = "block";
+            jsonResponse["hash"] = hash;
+            jsonResponse["height"] = headers.front().height;
+            jsonResponse["redirect"] = "/block/" + hash;
+            break;
+        }
+
+        case SearchTerm::Hash:
+        {
+            normalizeSHA256Hash(term);
+            bool missing = false;
+            std::optional<HashIndexEntry> located = this->locate_hash(term, HashFilter::Kind::Any, missing);
+
+            bool isBlock = false;
+            if (located.has_value())
+            {
+                isBlock = located->isBlock();
+                jsonResponse["height"] = located->height;
+            }
+            else
+            {
+                std::optional<json> found = missing ? std::nullopt : this->db.directSearch(term);
+                if (!found.has_value())
+                {
+                    if (!missing)
+                    {
+                        this->hash_absent(term, HashFilter::Kind::Any);
+                    }
+                    res.write(json({}));
+                    res.code = 404;
+                    return;
+                }
+                isBlock = json::parse(found.value().get<std::string>())["source_table"] == "blocks";
+            }
+
+            jsonResponse["type"] = isBlock ? "block" : "transaction";
+            jsonResponse["hash"] = term;
+            jsonResponse["source_table"] = isBlock ? "blocks" : "transactions";
+            jsonResponse["identifier"] = term;
+            jsonResponse["redirect"] = (isBlock ? "/block/" : "/transaction/") + term;
+            break;
+        }
+
+        case SearchTerm::TransparentAddress:
+            if (!this->db.transparentAddressExists(term))
+            {
+                res.write(json({}));
+                res.code = 404;
+                return;
+            }
+
+            jsonResponse["type"] = "address";
+            jsonResponse["address"] = term;
+            jsonResponse["redirect"] = "/address/" + term;
+            break;
+
+        case SearchTerm::Unknown:
+        {
+            json errorResponse;
+            this->db.createJsonErrorResponse(errorResponse, std::invalid_argument("Expected a height, a 64 digit hash or a transparent address."));
+            res.write(errorResponse.dump());
+            res.code = 400;
+            return;
+        }
+        }
+
+        res.code = 200;
+        this->write_response(req, res, jsonResponse);
+    }
+    catch (const std::exception &e)
+    {
+        CROW_LOG_CRITICAL << e.what();
+        json errorResponse;
+        this->db.createJsonErrorResponse(errorResponse, e);
+        res.write(errorResponse.dump());
+        res.code = 500;
+    }
+}
+
+namespace {
+
+/**
+ * Hex digits a prefix needs before hashes are suggested for it. Shorter prefixes match too many hashes to be useful.
+ */
+constexpr size_t suggest_min_hash_digits = 4;
+
+}
+
+void ZCashApi::search_suggest_route(const crow::request &req, crow::response &res)
+{
+    const char *prefixParam = req.url_params.get("prefix");
+    size_t limit = 0;
+    try
+    {
+        if (prefixParam == nullptr || *prefixParam == '\0')
+        {
+            throw std::invalid_argument("Missing prefix.");
+        }
+        limit = std::min<size_t>(req.url_params.get("limit") ? std::stoul(req.url_params.get("limit")) : 10, 50);
+    }
+    catch (const std::exception &e)
+    {
+        json errorResponse;
+        this->db.createJsonErrorResponse(errorResponse, e);
+        res.write(errorResponse.dump());
+        res.code = 400;
+        return;
+    }
+
+    const std::string prefix = prefixParam;
+    json jsonResponse;
+    jsonResponse["data"] = json::array();
+
+    // Heights starting with the digits: the number itself, then each longer number in ascending order.
+    const std::optional<uint64_t> tip = tipWatcher.tipHeight();
+    const bool digitsOnly = std::all_of(prefix.begin(), prefix.end(), [](char c)
+                                        { return c >= '0' && c <= '9'; });
+    if (tip.has_value() && digitsOnly && prefix.size() <= 19 && (prefix.size() == 1 || prefix[0] != '0'))
+    {
+        for (uint64_t first = std::stoull(prefix), span = 1; first <= tip.value() && jsonResponse["data"].size() < limit; first *= 10, span *= 10)
+        {
+            for (uint64_t height = first; height < first + span && height <= tip.value() && jsonResponse["data"].size() < limit; ++height)
+            {
+                jsonResponse["data"].push_back({{"type", "height"}, {"height", height}});
+            }
+            if (first == 0 || first > UINT64_MAX / 10)
+            {
+                break;
+            }
+        }
+    }
+
+    std::array<uint8_t, ZCASH_SHA256_HASH_BYTES> key;
+    if (prefix.size() >= suggest_min_hash_digits && decodeSHA256HashPrefix(prefix, key))
+    {
+        for (const HashIndexEntry &entry : hashIndex.findPrefix(key, prefix.size(), limit - jsonResponse["data"].size()))
+        {
+            jsonResponse["data"].push_back({{"type", entry.isBlock() ? "block" : "transaction"},
+                                            {"hash", bytesToHex(entry.hash.data(), entry.hash.size())},
+                                            {"height", entry.height}});
+        }
+    }
+
+    res.code = 200;
+    this->write_response(req, res, jsonResponse);
+}
+
+void ZCashApi::export_csv(const crow::request &req, crow::response &res, const std::string &file_name)
+{
+    const std::string suffix = ".csv";
+    const std::string table = file_name.size() > suffix.size() && file_name.compare(file_name.size() - suffix.size(), suffix.size(), suffix) == 0
+                                  ? file_name.substr(0, file_name.size() - suffix.size())
+                                  : "";
+
+    if (std::find(Database::csv_export_tables.begin(), Database::csv_export_tables.end(), table) == Database::csv_export_tables.end())
+    {
+        json jsonResponse;
+        jsonResponse["error"] = "Unknown export " + file_name + ".";
+        res.write(jsonResponse.dump());
+        res.code = 404;
+        return;
+    }
+
+    std::optional<uint64_t> fromHeight;
+    std::optional<uint64_t> toHeight;
+    try
+    {
+        if (req.url_params.get("from_height"))
+        {
+            fromHeight = std::stoull(req.url_params.get("from_height"));
+        }
+        if (req.url_params.get("to_height"))
+        {
+            toHeight = std::stoull(req.url_params.get("to_height"));
+        }
+    }
+    catch (const std::exception &e)
+    {
+        json errorResponse;
+        this->db.createJsonErrorResponse(errorResponse, e);
+        res.write(errorResponse.dump());
+        res.code = 400;
+        return;
+    }
+
+    try
+    {
+        res.set_header("Content-Type", "text/csv");
+        res.set_header("Content-Disposition", "attachment; filename=\"" + file_name + "\"");
+        res.code = 200;
+
+        // Shared, as Crow copies the body source around.
+        std::shared_ptr<CsvCopyCursor> cursor = this->db.copyTableToCsv(table, fromHeight, toHeight);
+        res.body_source = [cursor](std::string &part)
+        { return cursor->next(part, 64 * 1024); };
     }
     catch (const std::exception &e)
     {
         CROW_LOG_CRITICAL << e.what();
         json errorResponse;
         this->db.createJsonErrorResponse(errorResponse, e);
+        res.body.clear();
+        res.set_header("Content-Type", "application/json");
+        res.headers.erase("Content-Disposition");
         res.write(errorResponse.dump());
         res.code = 500;
     }
 }
 
+void ZCashApi::metrics_route(const crow::request &, crow::response &res)
+{
+    res.set_header("Content-Type", "text/plain; version=0.0.4");
+    res.write(Metrics::instance().render());
+    res.code = 200;
+}
+
+void ZCashApi::healthz_route(const crow::request &, crow::response &res)
+{
+    res.code = 200;
+    res.write(json({{"status", "ok"}}).dump());
+}
+
+void ZCashApi::readyz_route(const crow::request &, crow::response &res)
+{
+    const PoolStats pool = db.poolStats();
+    const bool tipFresh = tipWatcher.isFresh(tip_max_age);
+    const std::optional<std::chrono::milliseconds> tipAge = tipWatcher.age();
+    const bool circuitOpen = db.circuitState() == CircuitState::Open;
+    const bool ready = pool.healthy > 0 && tipFresh && !circuitOpen;
+
+    json jsonResponse;
+    jsonResponse["status"] = ready ? "ready" : "not ready";
+    jsonResponse["healthyConnections"] = pool.healthy;
+    jsonResponse["tipFresh"] = tipFresh;
+    jsonResponse["tipAgeMs"] = tipAge.has_value() ? json(tipAge->count()) : json(nullptr);
+    jsonResponse["circuitOpen"] = circuitOpen;
+
+    res.code = ready ? 200 : 503;
+    res.write(jsonResponse.dump());
+}
+
+namespace {
+
+/**
+ * Describes a connection pool's state for the pool introspection route.
+ */
+json poolStatsToJson(const PoolStats &pool)
+{
+    json jsonResponse;
+    jsonResponse["size"] = pool.size;
+    jsonResponse["minSize"] = pool.min_size;
+    jsonResponse["maxSize"] = pool.max_size;
+    jsonResponse["idle"] = pool.idle;
+    jsonResponse["inUse"] = pool.in_use;
+    jsonResponse["waiters"] = pool.waiters;
+    jsonResponse["healthy"] = pool.healthy;
+    jsonResponse["opening"] = pool.opening;
+    jsonResponse["reconnecting"] = pool.reconnecting;
+    jsonResponse["growing"] = pool.growing;
+    jsonResponse["checkouts"] = pool.checkouts;
+    jsonResponse["checkoutTimeouts"] = pool.checkout_timeouts;
+    jsonResponse["reconnects"] = pool.reconnects;
+    jsonResponse["validationFailures"] = pool.validation_failures;
+    jsonResponse["grown"] = pool.grown;
+    jsonResponse["reaped"] = pool.reaped;
+    jsonResponse["retired"] = pool.retired;
+    jsonResponse["averageCheckoutWaitMs"] = pool.average_checkout_wait_ms;
+    jsonResponse["averageHoldMs"] = pool.average_hold_ms;
+    return jsonResponse;
+}
+
+}
+
+void ZCashApi::debug_pool_route(const crow::request &, crow::response &res)
+{
+    json jsonResponse = poolStatsToJson(db.poolStats());
+
+    const CircuitState circuit = db.circuitState();
+    jsonResponse["circuit"] = circuit == CircuitState::Closed ? "closed" : circuit == CircuitState::Open ? "open" : "half_open";
+
+    jsonResponse["replicas"] = json::array();
+    for (const ReplicaStats &replica : db.replicaStats())
+    {
+        json replicaJson;
+        replicaJson["name"] = replica.name;
+        replicaJson["outstanding"] = replica.outstanding;
+        replicaJson["ejected"] = replica.ejected;
+        replicaJson["lagBlocks"] = replica.lag.has_value() ? json(replica.lag.value()) : json(nullptr);
+        replicaJson["pool"] = poolStatsToJson(replica.pool);
+        jsonResponse["replicas"].push_back(replicaJson);
+    }
+
+    res.code = 200;
+    res.write(jsonResponse.dump());
+}
+
 // Private
 
 /**
@@ -475,12 +1193,243 @@ void ZCashApi::set_common_headers(crow::response &res)
     res.set_header("Access-Control-Allow-Methods", "GET, POST, OPTIONS");
     res.set_header("Access-Control-Allow-Headers", "Content-Type, Accept");
     res.set_header("Access-Control-Allow-Origin", Config::getAccessControlOrigin());
+    res.set_header("Vary", "Accept");
+}
+
+/**
+ * Runs a route handler once the admission controller grants it a slot, or sheds the request with a 503.
+ */
+void ZCashApi::dispatch(const std::string &route, crow::response &res, const std::function<void()> &handler)
+{
+    auto shed = [this, &res]()
+    {
+        json jsonResponse;
+        jsonResponse["error"] = "Server is overloaded, retry later.";
+        res.set_header("Retry-After", std::to_string(admission.retryAfter().count()));
+        res.write(jsonResponse.dump());
+        res.code = 503;
+    };
+
+    std::optional<AdmissionController::Ticket> ticket = admission.admit(route);
+    if (!ticket.has_value())
+    {
+        admission_shed.increment();
+        shed();
+        return;
+    }
+
+    // Taken once admitted, so time spent queued for the route doesn't hold a slot of the global limit.
+    if (!limiter.tryAcquire())
+    {
+        limiter_shed.increment();
+        shed();
+        return;
+    }
+
+    ConnectionUsage &usage = Database::threadConnectionUsage();
+    usage = ConnectionUsage{};
+
+    auto timeout = statement_timeouts.find(route);
+
+    // is_alive() polls the socket, so the watchdog sees a client hang up while its query is still running.
+    QueryContext context(timeout != statement_timeouts.end() ? timeout->second : default_statement_timeout, [&res]
+                         { return res.is_alive(); });
+
+    RequestTrace::markDispatched();
+    handler();
+    RequestTrace::markHandled();
+
+    // The handler failed fast on the primary's open circuit, tell the client when to come back rather than report a 500.
+    if (usage.circuit_open && res.code >= 500)
+    {
+        const auto retryAfter = std::chrono::duration_cast<std::chrono::seconds>(db.circuitRetryAfter() + std::chrono::milliseconds(999));
+
+        json jsonResponse;
+        jsonResponse["error"] = "Database is unavailable, retry later.";
+        res.body.clear();
+        res.set_header("Content-Type", "application/json");
+        res.set_header("Retry-After", std::to_string(std::max<int64_t>(retryAfter.count(), 1)));
+        res.write(jsonResponse.dump());
+        res.code = 503;
+        circuit_shed.increment();
+    }
+
+    // A streamed body is read after the handler returns, it keeps the route's admission slot until the stream ends.
+    if (res.body_source)
+    {
+        auto lease = std::make_shared<AdmissionController::Ticket>(std::move(ticket.value()));
+        res.body_source = [lease, source = std::move(res.body_source)](std::string &part)
+        { return source(part); };
+    }
+
+    // Streams hold their connections after the handler returns, so like bulk routes they have no meaningful sample.
+    const bool sampled = usage.checkouts > 0 && !res.body_source && bulk_routes.count(route) == 0;
+
+    ticket.reset();
+    limiter.release(sampled ? std::optional<LimiterSample>(LimiterSample{usage.held, usage.pool_wait}) : std::nullopt);
+}
+
+/**
+ * Serializes a response body in the encoding negotiated from the request's Accept header.
+ */
+void ZCashApi::write_response(const crow::request &req, crow::response &res, const json &body)
+{
+    const ResponseEncoding encoding = Encoding::negotiate(req);
+    res.set_header("Content-Type", Encoding::contentType(encoding));
+
+    TraceScope scope(TracePhase::Serialize);
+    res.write(Encoding::encode(body, encoding));
+}
+
+/**
+ * Serves block headers from the header store when it covers the whole range, so lookups skip the database.
+ */
+std::vector<BlockHeader> ZCashApi::block_headers(uint64_t fromHeight, uint64_t count)
+{
+    if (std::optional<std::vector<BlockHeader>> stored = headerStore.range(fromHeight, count))
+    {
+        return stored.value();
+    }
+
+    std::vector<BlockHeader> headers;
+    if (count > 0 && fromHeight <= std::numeric_limits<uint64_t>::max() - count)
+    {
+        db.fetchBlockHeaders(fromHeight, fromHeight + count, headers);
+    }
+    return headers;
+}
+
+namespace {
+
+/**
+ * Decodes a hash from a request, or returns std::nullopt if it isn't a 64 character hex hash.
+ */
+std::optional<std::array<uint8_t, ZCASH_SHA256_HASH_BYTES>> hashKey(const std::string &hash)
+{
+    std::array<uint8_t, ZCASH_SHA256_HASH_BYTES> key;
+    if (!decodeSHA256Hash(hash, key))
+    {
+        return std::nullopt;
+    }
+    return key;
+}
+
+}
+
+/**
+ * Resolves a hash through the hash filter, then the hash index. Only a fully caught up filter or index can prove
+ * a hash doesn't exist.
+ */
+std::optional<HashIndexEntry> ZCashApi::locate_hash(const std::string &hash, HashFilter::Kind kind, bool &missing) const
+{
+    missing = false;
+
+    const std::optional<std::array<uint8_t, ZCASH_SHA256_HASH_BYTES>> key = hashKey(hash);
+    if (!key.has_value())
+    {
+        return std::nullopt;
+    }
+
+    if (hash_filter_enabled && hashFilter.caughtUp() && !hashFilter.mayContain(key.value(), kind))
+    {
+        missing = true;
+        return std::nullopt;
+    }
+
+    std::optional<HashIndexEntry> located = hashIndex.find(key.value());
+    missing = !located.has_value() && hashIndex.caughtUp();
+    if (missing && hash_filter_enabled)
+    {
+        hashFilter.recordAbsent(key.value(), kind);
+    }
+    return located;
+}
+
+bool ZCashApi::accept_hash(std::string &hash, crow::response &res)
+{
+    if (normalizeSHA256Hash(hash))
+    {
+        return true;
+    }
+
+    json errorResponse;
+    this->db.createJsonErrorResponse(errorResponse, std::invalid_argument("Invalid hash " + hash.substr(0, ZCASH_SHA256_HASH_LENGTH) + ", expected 64 hex digits."));
+    res.write(errorResponse.dump());
+    res.code = 400;
+    return false;
+}
+
+void ZCashApi::hash_absent(const std::string &hash, HashFilter::Kind kind) const
+{
+    if (!hash_filter_enabled)
+    {
+        return;
+    }
+
+    if (const std::optional<std::array<uint8_t, ZCASH_SHA256_HASH_BYTES>> key = hashKey(hash))
+    {
+        hashFilter.recordAbsent(key.value(), kind);
+    }
+}
+
+/**
+ * Streams an export as NDJSON. The cursor is opened here, so a bad start fails with a JSON error, and the connection
+ * then pulls one height batch at a time, fetching the next only once the previous has been written to the socket.
+ */
+void ZCashApi::export_ndjson(const crow::request &req, crow::response &res, std::unique_ptr<ExportCursor> (Database::*exporter)(uint64_t, uint64_t))
+{
+    uint64_t fromHeight = 0;
+
+    try
+    {
+        fromHeight = req.url_params.get("from_height") ? std::stoull(req.url_params.get("from_height")) : 0;
+    }
+    catch (const std::exception &e)
+    {
+        json errorResponse;
+        this->db.createJsonErrorResponse(errorResponse, e);
+        res.write(errorResponse.dump());
+        res.code = 400;
+        return;
+    }
+
+    try
+    {
+        // Shared, as Crow copies the body source around.
+        std::shared_ptr<ExportCursor> cursor = (this->db.*exporter)(fromHeight, export_batch_heights);
+        std::shared_ptr<std::vector<json>> batch = std::make_shared<std::vector<json>>();
+
+        res.set_header("Content-Type", "application/x-ndjson");
+        res.code = 200;
+        res.body_source = [cursor, batch](std::string &part)
+        {
+            if (!cursor->next(*batch))
+            {
+                return false;
+            }
+
+            for (const json &record : *batch)
+            {
+                part += record.dump();
+                part += '\n';
+            }
+            return true;
+        };
+    }
+    catch (const std::exception &e)
+    {
+        CROW_LOG_CRITICAL << e.what();
+        json errorResponse;
+        this->db.createJsonErrorResponse(errorResponse, e);
+        res.write(errorResponse.dump());
+        res.code = 500;
+    }
 }
 
 /**
  * Sets up API routes.
  */
-void ZCashApi::setup_routes(crow::App<crow::CORSHandler> &app)
+void ZCashApi::setup_routes(ZCashApp &app)
 {
     /**
      * @brief Health check or welcome route.
@@ -492,6 +1441,37 @@ void ZCashApi::setup_routes(crow::App<crow::CORSHandler> &app)
     this->hello_route(req, res);
     res.end(); });
 
+    /**
+     * @brief Process metrics in the Prometheus text format.
+     * Responds to GET requests without passing through admission control so it stays available under load.
+     */
+    CROW_ROUTE(app, "/metrics").methods(crow::HTTPMethod::GET)([this](const crow::request &req, crow::response &res)
+                                                               {
+    this->metrics_route(req, res);
+    res.end(); });
+
+    /**
+     * @brief Liveness, readiness and pool introspection probes.
+     * Respond to GET requests from in-memory state only, so they never wait for a pooled connection.
+     */
+    CROW_ROUTE(app, "/healthz").methods(crow::HTTPMethod::GET)([this](const crow::request &req, crow::response &res)
+                                                               {
+    this->set_common_headers(res);
+    this->healthz_route(req, res);
+    res.end(); });
+
+    CROW_ROUTE(app, "/readyz").methods(crow::HTTPMethod::GET)([this](const crow::request &req, crow::response &res)
+                                                              {
+    this->set_common_headers(res);
+    this->readyz_route(req, res);
+    res.end(); });
+
+    CROW_ROUTE(app, "/debug/pool").methods(crow::HTTPMethod::GET)([this](const crow::request &req, crow::response &res)
+                                                                  {
+    this->set_common_headers(res);
+    this->debug_pool_route(req, res);
+    res.end(); });
+
     /**
      * @brief Pre-flight request handling for the blocks/all endpoint.
      * Responds to OPTIONS requests, typically for CORS preflight checks.
@@ -508,7 +1488,12 @@ void ZCashApi::setup_routes(crow::App<crow::CORSHandler> &app)
     CROW_ROUTE(app, "/block/<string>").methods(crow::HTTPMethod::GET)([this](const crow::request &req, crow::response &res, const std::string &block_hash)
                                                                       {
     this->set_common_headers(res);
-    this->fetch_block_by_hash(req, res, block_hash);
+    std::string hash = block_hash;
+    if (this->accept_hash(hash, res))
+    {
+        this->dispatch("/block/<string>", res, [&]
+                       { this->fetch_block_by_hash(req, res, hash); });
+    }
     res.end(); });
 
     /**
@@ -518,7 +1503,12 @@ void ZCashApi::setup_routes(crow::App<crow::CORSHandler> &app)
     CROW_ROUTE(app, "/transaction/<string>").methods(crow::HTTPMethod::GET)([this](const crow::request &req, crow::response &res, const std::string &transaction_hash)
                                                                             {
     this->set_common_headers(res);
-    this->fetch_transaction_by_hash(req, res, transaction_hash);
+    std::string hash = transaction_hash;
+    if (this->accept_hash(hash, res))
+    {
+        this->dispatch("/transaction/<string>", res, [&]
+                       { this->fetch_transaction_by_hash(req, res, hash); });
+    }
     res.end(); });
 
     /**
@@ -528,7 +1518,8 @@ void ZCashApi::setup_routes(crow::App<crow::CORSHandler> &app)
     CROW_ROUTE(app, "/blocks/all").methods(crow::HTTPMethod::GET)([this](const crow::request &req, crow::response &res)
                                                                   {
     this->set_common_headers(res);
-    this->fetch_all_blocks_route(req, res);
+    this->dispatch("/blocks/all", res, [&]
+                   { this->fetch_all_blocks_route(req, res); });
     res.end(); });
 
     /**
@@ -538,7 +1529,8 @@ void ZCashApi::setup_routes(crow::App<crow::CORSHandler> &app)
     CROW_ROUTE(app, "/transactions/all").methods(crow::HTTPMethod::GET)([this](const crow::request &req, crow::response &res)
                                                                         {
     this->set_common_headers(res);
-    this->fetch_all_transactions_route(req, res);
+    this->dispatch("/transactions/all", res, [&]
+                   { this->fetch_all_transactions_route(req, res); });
     res.end(); });
 
     /**
@@ -548,7 +1540,8 @@ void ZCashApi::setup_routes(crow::App<crow::CORSHandler> &app)
     CROW_ROUTE(app, "/blocks").methods(crow::HTTPMethod::GET)([this](const crow::request &req, crow::response &res)
                                                               {
     this->set_common_headers(res);
-    this->fetch_paginated_blocks_route(req, res);
+    this->dispatch("/blocks", res, [&]
+                   { this->fetch_paginated_blocks_route(req, res); });
     res.end(); });
 
     /**
@@ -558,7 +1551,8 @@ void ZCashApi::setup_routes(crow::App<crow::CORSHandler> &app)
     CROW_ROUTE(app, "/transactions").methods(crow::HTTPMethod::GET)([this](const crow::request &req, crow::response &res)
                                                                     {
     this->set_common_headers(res);
-    this->fetch_paginated_transactions_route(req, res);
+    this->dispatch("/transactions", res, [&]
+                   { this->fetch_paginated_transactions_route(req, res); });
     res.end(); });
 
     /**
@@ -568,7 +1562,23 @@ void ZCashApi::setup_routes(crow::App<crow::CORSHandler> &app)
     CROW_ROUTE(app, "/transaction/outputs/<string>").methods(crow::HTTPMethod::GET)([this](const crow::request &req, crow::response &res, const std::string &transaction_hash)
                                                                                     {
     this->set_common_headers(res);
-    this->fetch_transparent_outputs_related_to_transaction_hash(req, res, transaction_hash);
+    std::string hash = transaction_hash;
+    if (this->accept_hash(hash, res))
+    {
+        this->dispatch("/transaction/outputs/<string>", res, [&]
+                       { this->fetch_transparent_outputs_related_to_transaction_hash(req, res, hash); });
+    }
+    res.end(); });
+
+    /**
+     * @brief Fetches the transparent outputs paid to an address.
+     * Responds to GET requests with the newest outputs first; /search redirects addresses here.
+     */
+    CROW_ROUTE(app, "/address/<string>").methods(crow::HTTPMethod::GET)([this](const crow::request &req, crow::response &res, const std::string &address)
+                                                                       {
+    this->set_common_headers(res);
+    this->dispatch("/address/<string>", res, [&]
+                   { this->fetch_address_route(req, res, address); });
     res.end(); });
 
     /**
@@ -578,7 +1588,12 @@ void ZCashApi::setup_routes(crow::App<crow::CORSHandler> &app)
     CROW_ROUTE(app, "/transaction/inputs/<string>").methods(crow::HTTPMethod::GET)([this](const crow::request &req, crow::response &res, const std::string &transaction_hash)
                                                                                    {
     this->set_common_headers(res);
-    this->fetch_transparent_inputs_related_to_transaction_hash(req, res, transaction_hash);
+    std::string hash = transaction_hash;
+    if (this->accept_hash(hash, res))
+    {
+        this->dispatch("/transaction/inputs/<string>", res, [&]
+                       { this->fetch_transparent_inputs_related_to_transaction_hash(req, res, hash); });
+    }
     res.end(); });
 
     /**
@@ -588,7 +1603,8 @@ void ZCashApi::setup_routes(crow::App<crow::CORSHandler> &app)
     CROW_ROUTE(app, "/transactions/details").methods(crow::HTTPMethod::POST)([this](const crow::request &req, crow::response &res)
                                                                              {
     this->set_common_headers(res);
-    this->fetch_transactions_details_from_ids(req, res);
+    this->dispatch("/transactions/details", res, [&]
+                   { this->fetch_transactions_details_from_ids(req, res); });
     res.end(); });
 
     /**
@@ -598,7 +1614,8 @@ void ZCashApi::setup_routes(crow::App<crow::CORSHandler> &app)
     CROW_ROUTE(app, "/peers/details").methods(crow::HTTPMethod::POST)([this](const crow::request &req, crow::response &res)
                                                                       {
     this->set_common_headers(res);
-    this->fetch_peer_info(req, res);
+    this->dispatch("/peers/details", res, [&]
+                   { this->fetch_peer_info(req, res); });
     res.end(); });
 
     /**
@@ -608,7 +1625,8 @@ void ZCashApi::setup_routes(crow::App<crow::CORSHandler> &app)
     CROW_ROUTE(app, "/chain").methods(crow::HTTPMethod::POST)([this](const crow::request &req, crow::response &res)
                                                               {
     this->set_common_headers(res);
-    this->fetch_blockchain_info(req, res);
+    this->dispatch("/chain", res, [&]
+                   { this->fetch_blockchain_info(req, res); });
     res.end(); });
 
     /**
@@ -618,7 +1636,8 @@ void ZCashApi::setup_routes(crow::App<crow::CORSHandler> &app)
     CROW_ROUTE(app, "/transactions/total").methods(crow::HTTPMethod::GET)([this](const crow::request &req, crow::response &res)
                                                                           {
     this->set_common_headers(res);
-    this->fetch_total_transaction_count(req, res);
+    this->dispatch("/transactions/total", res, [&]
+                   { this->fetch_total_transaction_count(req, res); });
     res.end(); });
 
     /**
@@ -628,7 +1647,8 @@ void ZCashApi::setup_routes(crow::App<crow::CORSHandler> &app)
     CROW_ROUTE(app, "/blocks/total").methods(crow::HTTPMethod::GET)([this](const crow::request &req, crow::response &res)
                                                                     {
     this->set_common_headers(res);
-    this->fetch_total_block_count(req, res);
+    this->dispatch("/blocks/total", res, [&]
+                   { this->fetch_total_block_count(req, res); });
     res.end(); });
 
     /**
@@ -638,17 +1658,73 @@ void ZCashApi::setup_routes(crow::App<crow::CORSHandler> &app)
     CROW_ROUTE(app, "/metrics/transactions").methods(crow::HTTPMethod::GET)([this](const crow::request &req, crow::response &res)
                                                                             {
     this->set_common_headers(res);
-    this->fetch_total_transaction_counts_in_period(req, res);
+    this->dispatch("/metrics/transactions", res, [&]
+                   { this->fetch_total_transaction_counts_in_period(req, res); });
     res.end(); });
 
     /**
-     * @brief Direct search functionality across blockchain data.
-     * Responds to POST requests with search results based on query parameters.
+     * @brief Resolves a height, hash or address typed into a search box in one request.
+     * Responds to GET and POST requests with the kind of result and where to find it.
      */
-    CROW_ROUTE(app, "/search").methods(crow::HTTPMethod::POST)([this](const crow::request &req, crow::response &res)
-                                                               {
+    CROW_ROUTE(app, "/search").methods(crow::HTTPMethod::GET, crow::HTTPMethod::POST)([this](const crow::request &req, crow::response &res)
+                                                                                       {
+    this->set_common_headers(res);
+    this->dispatch("/search", res, [&]
+                   { this->direct_search(req, res); });
+    res.end(); });
+
+    /**
+     * @brief Search suggestions for a partial height or hash.
+     * Responds to GET requests from the hash index alone, so it never waits for a pooled connection.
+     */
+    CROW_ROUTE(app, "/search/suggest").methods(crow::HTTPMethod::GET)([this](const crow::request &req, crow::response &res)
+                                                                      {
+    this->set_common_headers(res);
+    this->search_suggest_route(req, res);
+    res.end(); });
+
+    /**
+     * @brief Block headers by height, by height range and by time.
+     * Respond to GET requests from the in-memory header store once it has loaded the heights asked for, and from the
+     * database until then.
+     */
+    CROW_ROUTE(app, "/block/height/<uint>").methods(crow::HTTPMethod::GET)([this](const crow::request &req, crow::response &res, uint64_t height)
+                                                                         {
+    this->set_common_headers(res);
+    this->dispatch("/block/height/<uint>", res, [&]
+                   { this->fetch_block_by_height(req, res, height); });
+    res.end(); });
+
+    CROW_ROUTE(app, "/blocks/headers").methods(crow::HTTPMethod::GET)([this](const crow::request &req, crow::response &res)
+                                                                      {
+    this->set_common_headers(res);
+    this->dispatch("/blocks/headers", res, [&]
+                   { this->fetch_block_headers_route(req, res); });
+    res.end(); });
+
+    CROW_ROUTE(app, "/blocks/range").methods(crow::HTTPMethod::GET)([this](const crow::request &req, crow::response &res)
+                                                                    {
+    this->set_common_headers(res);
+    this->dispatch("/blocks/range", res, [&]
+                   { this->fetch_blocks_range_route(req, res); });
+    res.end(); });
+
+    CROW_ROUTE(app, "/block/time/<uint>").methods(crow::HTTPMethod::GET)([this](const crow::request &req, crow::response &res, uint64_t timestamp)
+                                                                       {
+    this->set_common_headers(res);
+    this->dispatch("/block/time/<uint>", res, [&]
+                   { this->fetch_block_at_time(req, res, timestamp); });
+    res.end(); });
+
+    /**
+     * @brief Bulk CSV export of blocks, transactions, transparent inputs or transparent outputs.
+     * Responds to GET requests with the table contents produced by COPY ... TO STDOUT.
+     */
+    CROW_ROUTE(app, "/export/<string>").methods(crow::HTTPMethod::GET)([this](const crow::request &req, crow::response &res, const std::string &file_name)
+                                                                       {
     this->set_common_headers(res);
-    this->direct_search(req, res);
+    this->dispatch("/export/<string>", res, [&]
+                   { this->export_csv(req, res, file_name); });
     res.end(); });
 }
 
@@ -1,10 +1,27 @@
 #include "../include/crow_all.h"
 #include "db.hpp"
+#include "admission.hpp"
+#include "adaptive_limiter.hpp"
+#include "rate_limiter.hpp"
+#include "trace.hpp"
+#include "tip_watcher.hpp"
+#include "block_header_store.hpp"
+#include "chain_snapshot.hpp"
+#include "hash_filter.hpp"
 #include "config.h"
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
+#include <chrono>
 #include "nlohmann/json.hpp"
 
 using json = nlohmann::json;
 
+/**
+ * @brief Crow application type serving the API, with request tracing, CORS and per client rate limiting middleware.
+ */
+using ZCashApp = crow::App<RequestTracer, crow::CORSHandler, RateLimiter>;
+
 class ZCashApi
 {
 public:
@@ -28,7 +45,7 @@ public:
      * @param host Database host.
      * @param port Database port.
      */
-    void init(crow::App<crow::CORSHandler> &app, const std::string &dbname, const std::string &user, const std::string &password, const std::string &host, std::string port);
+    void init(ZCashApp &app, const std::string &dbname, const std::string &user, const std::string &password, const std::string &host, std::string port);
 
     /**
      * @brief Handle the "hello" route, responding with a simple greeting.
@@ -89,6 +106,15 @@ public:
      */
     void fetch_transparent_outputs_related_to_transaction_hash(const crow::request &req, crow::response &res, const std::string &transaction_hash);
 
+    /**
+     * @brief Handle the route for fetching the transparent outputs paid to an address.
+     * Accepts a `limit` query parameter, default 50 and at most 1000.
+     * @param req Crow request object.
+     * @param res Crow response object.
+     * @param address Transparent address to fetch outputs for.
+     */
+    void fetch_address_route(const crow::request &req, crow::response &res, const std::string &address);
+
     /**
      * @brief Handle the route for fetching transparent inputs related to a transaction hash.
      * @param req Crow request object.
@@ -139,7 +165,97 @@ public:
      */
     void fetch_total_transaction_counts_in_period(const crow::request &req, crow::response &res);
 
+
+    /**
+     * @brief Handle the route for fetching a block's header by its height.
+     * Served from the header store, or from the database while the store doesn't cover the height.
+     * @param req Crow request object.
+     * @param res Crow response object.
+     * @param height Height of the block to fetch.
+     */
+    void fetch_block_by_height(const crow::request &req, crow::response &res, uint64_t height);
+
+    /**
+     * @brief Handle the route for fetching a page of block headers in ascending height order.
+     * Accepts `from_height` (default 0) and `limit` (default 50, at most 1000) query parameters.
+     * @param req Crow request object.
+     * @param res Crow response object.
+     */
+    void fetch_block_headers_route(const crow::request &req, crow::response &res);
+
+    /**
+     * @brief Handle the route for fetching the blocks in a range of heights.
+     * Accepts `from` and `to` query parameters, both inclusive and at most BLOCKS_RANGE_MAX_SPAN heights apart.
+     * Pages deep enough not to be reorged are marked immutable for caches.
+     * @param req Crow request object.
+     * @param res Crow response object.
+     */
+    void fetch_blocks_range_route(const crow::request &req, crow::response &res);
+
+    /**
+     * @brief Handle the route for fetching the header of the chain's tip at a point in time.
+     * @param req Crow request object.
+     * @param res Crow response object.
+     * @param timestamp Seconds since the Unix epoch.
+     */
+    void fetch_block_at_time(const crow::request &req, crow::response &res, uint64_t timestamp);
+
+    /**
+     * @brief Handle the search route, resolving a search term to the block, transaction or address it names.
+     * Accepts a `q` query parameter, or `pattern` for older clients: a height, a block hash or txid, or a transparent
+     * address. The term is classified locally and resolved from the header store and hash index, querying the database
+     * only if they can't tell.
+     * @param req Crow request object.
+     * @param res Crow response object.
+     */
     void direct_search(const crow::request &req, crow::response &res);
+
+    /**
+     * @brief Handle the route suggesting heights, block hashes and txids starting with a prefix, for search as you type.
+     * Accepts `prefix` and `limit` (default 10, at most 50) query parameters. Hashes are suggested for prefixes of
+     * at least 4 hex digits.
+     * @param req Crow request object.
+     * @param res Crow response object.
+     */
+    void search_suggest_route(const crow::request &req, crow::response &res);
+
+    /**
+     * @brief Handle the route exposing process metrics in the Prometheus text format.
+     * @param req Crow request object.
+     * @param res Crow response object.
+     */
+    void metrics_route(const crow::request &req, crow::response &res);
+
+    /**
+     * @brief Handle the liveness probe route. Succeeds whenever the process can serve HTTP.
+     * @param req Crow request object.
+     * @param res Crow response object.
+     */
+    void healthz_route(const crow::request &req, crow::response &res);
+
+    /**
+     * @brief Handle the readiness probe route.
+     * Succeeds when the pool has at least one healthy connection and the tip watcher polled recently.
+     * @param req Crow request object.
+     * @param res Crow response object.
+     */
+    void readyz_route(const crow::request &req, crow::response &res);
+
+    /**
+     * @brief Handle the route describing the connection pool's state.
+     * @param req Crow request object.
+     * @param res Crow response object.
+     */
+    void debug_pool_route(const crow::request &req, crow::response &res);
+
+    /**
+     * @brief Handle the route for exporting a table as CSV.
+     * Accepts optional `from_height` and `to_height` query parameters bounding the export.
+     * @param req Crow request object.
+     * @param res Crow response object.
+     * @param file_name Requested file name, e.g. "blocks.csv".
+     */
+    void export_csv(const crow::request &req, crow::response &res, const std::string &file_name);
 private:
     /**
      * @brief Reference to the Database instance for handling Zcash data.
@@ -151,15 +267,187 @@ private:
      */
     bool isInitiated{false};
 
+    /**
+     * @brief Per route concurrency limits applied before handlers run.
+     */
+    AdmissionController admission;
+
+    /**
+     * @brief Global in-flight limit that adapts to observed DB latency and pool wait.
+     */
+    AdaptiveLimiter limiter;
+
+    /**
+     * @brief Background poller tracking the chain tip.
+     */
+    TipWatcher tipWatcher;
+
+    /**
+     * @brief Memory mapped headers and hashes of deep blocks, or nullptr if no snapshot is configured.
+     * Declared before the stores reading from it so it outlives them.
+     */
+    std::unique_ptr<ChainSnapshot> chainSnapshot;
+
+    /**
+     * @brief In-memory block headers, kept up to date with the tip.
+     */
+    BlockHeaderStore headerStore;
+
+    /**
+     * @brief In-memory index locating every block hash and txid, kept up to date with the tip.
+     */
+    HashIndex hashIndex;
+
+    /**
+     * @brief Bloom filters over every block hash and txid, rejecting hashes that don't exist before any lookup.
+     */
+    HashFilter hashFilter;
+
+    /**
+     * @brief Whether hashFilter is loaded and consulted.
+     */
+    bool hash_filter_enabled{false};
+
+    /**
+     * @brief Time a route's queries have to finish, for routes that don't use default_statement_timeout.
+     */
+    std::unordered_map<std::string, std::chrono::milliseconds> statement_timeouts;
+
+    /**
+     * @brief Bulk routes, whose DB latency says nothing about point lookups and is kept out of the limiter's samples.
+     */
+    std::unordered_set<std::string> bulk_routes;
+
+    /**
+     * @brief Time the queries of most routes have to finish.
+     */
+    std::chrono::milliseconds default_statement_timeout;
+
+    /**
+     * @brief Most heights /blocks/range serves in one request.
+     */
+    uint64_t blocks_range_max_span;
+
+    /**
+     * @brief Depth below the tip at which blocks are cached as immutable.
+     */
+    uint64_t blocks_immutable_depth;
+
+    /**
+     * @brief Oldest the tip may be for /readyz to report ready.
+     */
+    std::chrono::milliseconds tip_max_age;
+
+    /**
+     * @brief Heights fetched per query by the NDJSON exports.
+     */
+    uint64_t export_batch_heights;
+
+    /**
+     * @brief Requests shed by the admission controller.
+     */
+    Counter &admission_shed;
+
+    /**
+     * @brief Requests shed by the adaptive limiter.
+     */
+    Counter &limiter_shed;
+
+    /**
+     * @brief Requests failed fast because the primary's circuit breaker was open.
+     */
+    Counter &circuit_shed;
+
     /**
      * @brief Set up the HTTP routes for the ZCashApi.
      * @param app Crow application instance to configure routes.
      */
-    void setup_routes(crow::App<crow::CORSHandler> &app);
+    void setup_routes(ZCashApp &app);
 
     /**
      * @brief Set common HTTP headers for a Crow response.
      * @param res Crow response object to set headers for.
      */
     void set_common_headers(crow::response &res);
+
+    /**
+     * @brief Run a route handler under the route's admission budget.
+     * Responds with 503 and a Retry-After header instead of running the handler when the route's queue is full
+     * or, once admitted, the adaptive limit is reached. The handler's queries are bounded by the route's statement timeout
+     * and cancelled if the client disconnects. A handler that fails because the primary's circuit is open is
+     * answered with 503 and a Retry-After header.
+     * @param route Route name used to select the admission budget.
+     * @param res Crow response object.
+     * @param handler Route handler to run once admitted.
+     */
+    void dispatch(const std::string &route, crow::response &res, const std::function<void()> &handler);
+
+    /**
+     * @brief Write a response body using the encoding negotiated from the request's Accept header.
+     * @param req Crow request object.
+     * @param res Crow response object to write to.
+     * @param body JSON document to serialize.
+     */
+    void write_response(const crow::request &req, crow::response &res, const json &body);
+
+    /**
+     * @brief Write a bulk export as newline delimited JSON, one record per line.
+     * The export starts at the `from_height` query parameter so clients can resume after a dropped connection.
+     * @param req Crow request object.
+     * @param res Crow response object to write to.
+     * @param exporter Database export method producing the records.
+     */
+    void export_ndjson(const crow::request &req, crow::response &res, std::unique_ptr<ExportCursor> (Database::*exporter)(uint64_t, uint64_t));
+
+    /**
+     * @brief Get the headers of a range of blocks from the header store, or from the database if the store doesn't cover it.
+     * @param fromHeight First height.
+     * @param count Number of heights.
+     * @return Headers in ascending height order, missing any heights the database doesn't have.
+     */
+    std::vector<BlockHeader> block_headers(uint64_t fromHeight, uint64_t count);
+
+    /**
+     * @brief Set the caching headers of a response about blocks up to a height. Complete responses only covering blocks
+     * at least BLOCKS_IMMUTABLE_DEPTH below the tip can't change and are cached for a year, others must be revalidated.
+     * @param res Crow response object.
+     * @param highestHeight Highest height the response covers.
+     * @param complete False if blocks the response asked for were missing, so it may still change.
+     */
+    void set_block_cache_headers(crow::response &res, uint64_t highestHeight, bool complete) const;
+
+    /**
+     * @brief Answer a transaction request with an `expand` parameter, a comma separated list of `inputs` and `outputs`,
+     * fetching the transaction and the expanded parts in one query.
+     * @param req Crow request object.
+     * @param res Crow response object.
+     * @param transaction_hash Normalized hash of the transaction.
+     * @param height Height of the transaction's block if the hash index knows it.
+     */
+    void fetch_expanded_transaction(const crow::request &req, crow::response &res, const std::string &transaction_hash, std::optional<uint64_t> height);
+
+    /**
+     * @brief Look a hash from a request up in the hash filter and the hash index.
+     * @param hash Hash as given by the client.
+     * @param kind Kind of hash the route accepts.
+     * @param missing Set to true if the filter or the index proves the hash doesn't exist, false otherwise.
+     * @return Where the hash lives, or std::nullopt if the index can't tell.
+     */
+    std::optional<HashIndexEntry> locate_hash(const std::string &hash, HashFilter::Kind kind, bool &missing) const;
+
+    /**
+     * @brief Validate a hash from a request and lowercase it, answering 400 if it isn't 64 hex digits.
+     * Called before any cache or database work, so malformed hashes never reach either.
+     * @param hash Hash as given by the client, normalized in place.
+     * @param res Crow response object, written if the hash is rejected.
+     * @return True if the hash can be looked up.
+     */
+    bool accept_hash(std::string &hash, crow::response &res);
+
+    /**
+     * @brief Report a hash the database doesn't have, so the hash filter can count its false positives.
+     * @param hash Hash as given by the client.
+     * @param kind Kind of hash the route accepts.
+     */
+    void hash_absent(const std::string &hash, HashFilter::Kind kind) const;
 };
@@ -0,0 +1,84 @@
+#include "db.hpp"
+#include "chain_snapshot.hpp"
+#include "config.h"
+#include "../include/crow_all.h"
+#include <algorithm>
+#include <cstring>
+
+/**
+ * Builds a chain snapshot for zcash-api from the database.
+ *
+ * Usage: zcash-api-snapshot <output file> [height]
+ *
+ * The snapshot covers every block below the given height, by default the tip less CHAIN_SNAPSHOT_CONFIRMATIONS
+ * blocks so it only holds blocks too deep to be reorged. The database is configured like zcash-api's.
+ */
+int main(int argc, char *argv[])
+{
+    if (argc < 2 || argc > 3)
+    {
+        std::cerr << "Usage: " << argv[0] << " <output file> [height]" << std::endl;
+        return 2;
+    }
+
+    try
+    {
+        const std::string output = argv[1];
+        const uint64_t batchHeights = std::stoull(Config::getHeaderStoreLoadBatch());
+
+        Database database;
+        database.connect(Config::getDatabaseName(), Config::getDatabaseUser(), Config::getDatabasePassword(), Config::getDatabaseHost(), Config::getDatabasePort());
+
+        uint64_t height = 0;
+        if (argc == 3)
+        {
+            height = std::stoull(argv[2]);
+        }
+        else
+        {
+            const std::optional<uint64_t> tip = database.fetchTipHeight();
+            const uint64_t confirmations = std::stoull(Config::getChainSnapshotConfirmations());
+            if (!tip.has_value() || tip.value() < confirmations)
+            {
+                throw std::runtime_error("The chain is too short to snapshot.");
+            }
+            height = tip.value() - confirmations;
+        }
+
+        std::vector<BlockHeader> headers;
+        std::vector<HashIndexEntry> entries;
+        std::vector<BlockHeader> headerBatch;
+        std::vector<HashIndexEntry> entryBatch;
+        headers.reserve(height);
+
+        for (uint64_t from = 0; from < height; from += batchHeights)
+        {
+            const uint64_t to = std::min(from + batchHeights, height);
+
+            database.fetchBlockHeaders(from, to, headerBatch);
+            if (headerBatch.size() != to - from)
+            {
+                throw std::runtime_error("Blocks between heights " + std::to_string(from) + " and " + std::to_string(to) + " are missing.");
+            }
+            headers.insert(headers.end(), headerBatch.begin(), headerBatch.end());
+
+            database.fetchHashIndexEntries(from, to, entryBatch);
+            entries.insert(entries.end(), entryBatch.begin(), entryBatch.end());
+
+            CROW_LOG_INFO << "Snapshot read up to height " << to << " of " << height << ".";
+        }
+
+        std::sort(entries.begin(), entries.end(), [](const HashIndexEntry &a, const HashIndexEntry &b)
+                  { return std::memcmp(a.hash.data(), b.hash.data(), a.hash.size()) < 0; });
+
+        ChainSnapshot::write(output, headers, entries);
+        CROW_LOG_INFO << "Wrote " << output << " with " << headers.size() << " blocks and " << entries.size() << " hashes.";
+    }
+    catch (const std::exception &e)
+    {
+        CROW_LOG_CRITICAL << e.what();
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,121 @@
+#include "tip_watcher.hpp"
+#include "db.hpp"
+
+#ifndef TIP_WATCHER_CPP
+#define TIP_WATCHER_CPP
+
+namespace {
+
+int64_t steadyNowMs()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+}
+
+TipWatcher::TipWatcher(Database &database, std::chrono::milliseconds interval_)
+    : db(database), interval(interval_)
+{
+}
+
+TipWatcher::~TipWatcher() noexcept
+{
+    stop();
+}
+
+void TipWatcher::subscribe(TipHandler handler)
+{
+    subscribers.push_back(std::move(handler));
+}
+
+void TipWatcher::start()
+{
+    if (watcher.joinable())
+    {
+        return;
+    }
+
+    watcher = std::thread([this]
+                          {
+        std::unique_lock<std::mutex> lock(stop_mutex);
+        while (!stopping)
+        {
+            lock.unlock();
+            poll();
+            lock.lock();
+            stop_signal.wait_for(lock, interval, [this] { return stopping; });
+        } });
+}
+
+void TipWatcher::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(stop_mutex);
+        stopping = true;
+    }
+    stop_signal.notify_all();
+
+    if (watcher.joinable())
+    {
+        watcher.join();
+    }
+}
+
+std::optional<uint64_t> TipWatcher::tipHeight() const noexcept
+{
+    const int64_t height = tip_height.load(std::memory_order_acquire);
+    if (height < 0)
+    {
+        return std::nullopt;
+    }
+    return static_cast<uint64_t>(height);
+}
+
+bool TipWatcher::isFresh(std::chrono::milliseconds maxAge) const noexcept
+{
+    const auto tipAge = age();
+    return tipAge.has_value() && tipAge.value() <= maxAge;
+}
+
+std::optional<std::chrono::milliseconds> TipWatcher::age() const noexcept
+{
+    const int64_t lastSuccess = last_success_ms.load(std::memory_order_acquire);
+    if (lastSuccess < 0)
+    {
+        return std::nullopt;
+    }
+    return std::chrono::milliseconds(steadyNowMs() - lastSuccess);
+}
+
+void TipWatcher::poll()
+{
+    try
+    {
+        std::optional<uint64_t> height = db.fetchTipHeight();
+        last_success_ms.store(steadyNowMs(), std::memory_order_release);
+
+        if (!height.has_value())
+        {
+            return;
+        }
+
+        db.refreshReplicaLag(height.value());
+
+        const int64_t previous = tip_height.exchange(static_cast<int64_t>(height.value()), std::memory_order_acq_rel);
+        if (previous == static_cast<int64_t>(height.value()))
+        {
+            return;
+        }
+
+        for (const TipHandler &handler : subscribers)
+        {
+            handler(height.value());
+        }
+    }
+    catch (const std::exception &e)
+    {
+        CROW_LOG_ERROR << "Tip poll failed: " << e.what();
+    }
+}
+
+#endif // TIP_WATCHER_CPP
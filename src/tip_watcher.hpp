@@ -0,0 +1,95 @@
+#ifndef TIP_WATCHER_HPP
+#define TIP_WATCHER_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+class Database;
+
+/**
+ * @brief Polls the primary database for the chain tip on a background thread, measures replica lag against it
+ * and notifies subscribers when the tip changes.
+ */
+class TipWatcher
+{
+public:
+    using TipHandler = std::function<void(uint64_t)>;
+
+    /**
+     * @brief Constructor for the TipWatcher class.
+     * @param database Database to poll.
+     * @param interval Time between polls.
+     */
+    TipWatcher(Database &database, std::chrono::milliseconds interval);
+
+    /**
+     * @brief Destructor for the TipWatcher class. Stops polling.
+     */
+    ~TipWatcher() noexcept;
+
+    TipWatcher(const TipWatcher &) = delete;
+    TipWatcher &operator=(const TipWatcher &) = delete;
+
+    /**
+     * @brief Register a callback run on the watcher thread whenever the tip height advances.
+     * Must be called before start().
+     * @param handler Callback receiving the new tip height.
+     */
+    void subscribe(TipHandler handler);
+
+    /**
+     * @brief Start polling.
+     */
+    void start();
+
+    /**
+     * @brief Stop polling and join the watcher thread.
+     */
+    void stop();
+
+    /**
+     * @brief Get the most recently observed tip height.
+     * @return Tip height, or std::nullopt before the first successful poll.
+     */
+    std::optional<uint64_t> tipHeight() const noexcept;
+
+    /**
+     * @brief Check whether the tip was polled successfully recently.
+     * @param maxAge Oldest acceptable successful poll.
+     * @return True if the last successful poll is younger than maxAge.
+     */
+    bool isFresh(std::chrono::milliseconds maxAge) const noexcept;
+
+    /**
+     * @brief Get the time since the last successful poll.
+     * @return Age of the tip, or std::nullopt before the first successful poll.
+     */
+    std::optional<std::chrono::milliseconds> age() const noexcept;
+
+private:
+    Database &db;
+    std::chrono::milliseconds interval;
+    std::vector<TipHandler> subscribers;
+
+    std::atomic<int64_t> tip_height{-1};
+    std::atomic<int64_t> last_success_ms{-1}; ///< steady_clock time of the last successful poll, in milliseconds.
+
+    std::mutex stop_mutex;
+    std::condition_variable stop_signal;
+    bool stopping{false};
+    std::thread watcher;
+
+    /**
+     * @brief Poll the tip once and notify subscribers if it advanced.
+     */
+    void poll();
+};
+
+#endif // TIP_WATCHER_HPP
@@ -0,0 +1,147 @@
+#include "trace.hpp"
+#include "config.h"
+#include "nlohmann/json.hpp"
+
+#ifndef TRACE_CPP
+#define TRACE_CPP
+
+namespace {
+
+double toMilliseconds(RequestTrace::clock::duration duration)
+{
+    return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+const char *phaseName(TracePhase phase)
+{
+    switch (phase)
+    {
+    case TracePhase::Admission:
+        return "admission_ms";
+    case TracePhase::PoolWait:
+        return "pool_wait_ms";
+    case TracePhase::Query:
+        return "query_ms";
+    case TracePhase::RowConversion:
+        return "row_conversion_ms";
+    case TracePhase::Serialize:
+        return "serialize_ms";
+    case TracePhase::Finalize:
+        return "finalize_ms";
+    default:
+        return "unknown_ms";
+    }
+}
+
+}
+
+thread_local RequestTrace *RequestTrace::active = nullptr;
+thread_local RequestTrace *RequestTrace::running = nullptr;
+
+void RequestTrace::record(TracePhase phase, clock::duration duration) noexcept
+{
+    if (active != nullptr)
+    {
+        active->phases[static_cast<size_t>(phase)] += duration;
+    }
+}
+
+void RequestTrace::markDispatched() noexcept
+{
+    if (active != nullptr)
+    {
+        active->dispatched = clock::now();
+        active->phases[static_cast<size_t>(TracePhase::Admission)] = active->dispatched - active->parsed;
+    }
+}
+
+void RequestTrace::markHandled() noexcept
+{
+    if (active != nullptr)
+    {
+        active->handled = clock::now();
+    }
+}
+
+void RequestTrace::recordStatement(const char *name, size_t rows)
+{
+    if (running != nullptr)
+    {
+        running->last_statement = name;
+        running->last_rows = rows;
+        ++running->statement_count;
+    }
+
+    if (active != nullptr)
+    {
+        active->statements.emplace_back(name, rows);
+    }
+}
+
+RequestTracer::RequestTracer()
+    : sample_every(static_cast<uint32_t>(std::stoul(Config::getTraceSampleEvery()))),
+      slow_threshold(std::stoul(Config::getSlowRequestThresholdMs()))
+{
+}
+
+void RequestTracer::before_handle(crow::request & /*req*/, crow::response & /*res*/, context &ctx)
+{
+    thread_local uint32_t requests_seen = 0;
+
+    ctx.trace.parsed = RequestTrace::clock::now();
+    ctx.trace.sampled = sample_every > 0 && ++requests_seen % sample_every == 0;
+    RequestTrace::active = ctx.trace.sampled ? &ctx.trace : nullptr;
+    RequestTrace::running = &ctx.trace;
+}
+
+void RequestTracer::after_handle(crow::request &req, crow::response &res, context &ctx)
+{
+    RequestTrace &trace = ctx.trace;
+    const auto finished = RequestTrace::clock::now();
+    RequestTrace::active = nullptr;
+    RequestTrace::running = nullptr;
+
+    const auto elapsed = finished - trace.parsed;
+    if (elapsed < slow_threshold)
+    {
+        return;
+    }
+
+    nlohmann::json line;
+    line["event"] = "slow_request";
+    line["method"] = crow::method_name(req.method);
+    line["url"] = req.url;
+    line["status"] = res.code;
+    line["total_ms"] = toMilliseconds(elapsed);
+    line["sampled"] = trace.sampled;
+    line["statement_count"] = trace.statement_count;
+    if (trace.last_statement != nullptr)
+    {
+        line["last_statement"] = trace.last_statement;
+        line["last_statement_rows"] = trace.last_rows;
+    }
+
+    if (trace.sampled)
+    {
+        if (trace.handled != RequestTrace::clock::time_point{})
+        {
+            trace.phases[static_cast<size_t>(TracePhase::Finalize)] = finished - trace.handled;
+        }
+
+        for (size_t i = 0; i < static_cast<size_t>(TracePhase::Count); ++i)
+        {
+            line[phaseName(static_cast<TracePhase>(i))] = toMilliseconds(trace.phases[i]);
+        }
+
+        nlohmann::json statements = nlohmann::json::array();
+        for (const auto &[name, rows] : trace.statements)
+        {
+            statements.push_back({{"statement", name}, {"rows", rows}});
+        }
+        line["statements"] = statements;
+    }
+
+    CROW_LOG_WARNING << line.dump();
+}
+
+#endif // TRACE_CPP
@@ -0,0 +1,141 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "../include/crow_all.h"
+
+/**
+ * @brief Phases of a request whose time is recorded by a sampled trace.
+ */
+enum class TracePhase
+{
+    Admission,     ///< Request parsed until the route handler starts, mostly admission queueing.
+    PoolWait,      ///< Waiting for a pooled connection.
+    Query,         ///< Executing statements.
+    RowConversion, ///< Converting result rows while the connection is held.
+    Serialize,     ///< Serializing the response body.
+    Finalize,      ///< Handler return until the after-handle middleware runs. The socket write is not included.
+    Count
+};
+
+/**
+ * @brief Per request trace context.
+ *
+ * Every request records when it was parsed and the name and row count of its last statement, so slow
+ * requests are always noticed along with what they were running. Phase timings and the full list of
+ * statements are only captured for sampled requests; for the rest each phase recording call is a
+ * single thread local null check.
+ */
+class RequestTrace
+{
+public:
+    using clock = std::chrono::steady_clock;
+
+    /**
+     * @brief Get the sampled trace of the request running on this thread.
+     * @return The trace, or nullptr if the current request is not sampled.
+     */
+    static RequestTrace *current() noexcept { return active; }
+
+    /**
+     * @brief Add time to a phase of the current request, if it is sampled.
+     * @param phase Phase to add to.
+     * @param duration Time spent.
+     */
+    static void record(TracePhase phase, clock::duration duration) noexcept;
+
+    /**
+     * @brief Record that the current request's handler started running, if it is sampled.
+     */
+    static void markDispatched() noexcept;
+
+    /**
+     * @brief Record that the current request's handler returned, if it is sampled.
+     */
+    static void markHandled() noexcept;
+
+    /**
+     * @brief Record a statement executed by the current request. Every request keeps its last statement,
+     * sampled ones keep them all.
+     * @param name Statement name.
+     * @param rows Number of rows returned.
+     */
+    static void recordStatement(const char *name, size_t rows);
+
+    /**
+     * @brief Get the time recorded for a phase so far.
+     * @param phase Phase to read.
+     * @return Accumulated time.
+     */
+    clock::duration total(TracePhase phase) const noexcept { return phases[static_cast<size_t>(phase)]; }
+
+private:
+    friend struct RequestTracer;
+
+    static thread_local RequestTrace *active;
+    static thread_local RequestTrace *running;    ///< Trace of the request running on this thread, sampled or not.
+
+    clock::time_point parsed;
+    clock::time_point dispatched;
+    clock::time_point handled;
+    bool sampled{false};
+    const char *last_statement{nullptr};
+    size_t last_rows{0};
+    uint32_t statement_count{0};
+    std::array<clock::duration, static_cast<size_t>(TracePhase::Count)> phases{};
+    std::vector<std::pair<const char *, size_t>> statements;
+};
+
+/**
+ * @brief RAII helper adding the lifetime of the scope to a phase of the current sampled trace.
+ */
+class TraceScope
+{
+public:
+    explicit TraceScope(TracePhase phase_) noexcept
+        : phase(phase_), started(RequestTrace::current() ? RequestTrace::clock::now() : RequestTrace::clock::time_point{}) {}
+    ~TraceScope() noexcept
+    {
+        if (started != RequestTrace::clock::time_point{})
+        {
+            RequestTrace::record(phase, RequestTrace::clock::now() - started);
+        }
+    }
+    TraceScope(const TraceScope &) = delete;
+    TraceScope &operator=(const TraceScope &) = delete;
+
+private:
+    TracePhase phase;
+    RequestTrace::clock::time_point started;
+};
+
+/**
+ * @brief Crow middleware opening a trace per request and logging requests slower than the configured threshold.
+ * Must be the first middleware so its accept timestamp covers the others.
+ */
+struct RequestTracer
+{
+    struct context
+    {
+        RequestTrace trace;
+    };
+
+    /**
+     * @brief Constructor for the RequestTracer middleware, configured from Config.
+     */
+    RequestTracer();
+
+    void before_handle(crow::request &req, crow::response &res, context &ctx);
+
+    void after_handle(crow::request &req, crow::response &res, context &ctx);
+
+private:
+    uint32_t sample_every;
+    std::chrono::milliseconds slow_threshold;
+};
+
+#endif // TRACE_HPP